@@ -0,0 +1,150 @@
+#version 430
+#include "assets/shaders/deformation.glsl"
+#include "assets/shaders/sdf.glsl"
+#include "assets/shaders/shading.glsl"
+
+in vec4 gl_FragCoord;
+
+layout(location=0) out vec4 o_color;
+out float gl_FragDepth;
+
+// shades the pixels of a G_BUFFER trace pass (see deform_frag.glsl), so that the normal and the 
+// lighting are evaluated once per visible pixel instead of once per hitting cage fragment
+
+// permutation defines (see ShaderPermutations):
+// BILATERAL_UPSAMPLE - the g-buffer has 1 / u_upsampleDivisor of the resolution, the hits of the 4 nearest 
+// texels are blended by their bilinear weights and how close they are to the hit nearest the camera
+uniform mat4 u_invVP;
+uniform vec3 u_cameraPos;
+uniform vec2 u_screenSize;
+
+// undeformed hit point with w = 1 for hits, and the depth of the hit. with FRONT_CAGE_ONLY the depth
+// buffer holds the front cage depth and w is the depth of the hit instead
+uniform sampler2D u_gBufferHits;
+uniform sampler2D u_gBufferDepth;
+
+uniform float u_upsampleDivisor;
+// distance at which a hit stops being blended with the nearest one, relative to its distance from the camera
+uniform float u_upsampleTolerance;
+
+vec3 UnprojectDepth(const vec2 pixelUV, const float depth)
+{
+	vec4 worldPos = u_invVP * vec4(vec3(pixelUV, depth) * 2. - 1., 1.);
+	return worldPos.xyz / worldPos.w;
+}
+
+float HitDepth(const vec4 hit, const ivec2 texel)
+{
+#ifdef FRONT_CAGE_ONLY
+	return hit.w;
+#else
+	return texelFetch(u_gBufferDepth, texel, 0).r;
+#endif
+}
+
+#ifdef BILATERAL_UPSAMPLE
+bool UpsampleHit(out vec3 undefHitPoint, out float depth)
+{
+	// returns false if less than half of the bilinear footprint is covered by hits
+	ivec2 lowResSize = textureSize(u_gBufferHits, 0);
+	vec2 lowResCoord = gl_FragCoord.xy / u_upsampleDivisor - 0.5;
+	ivec2 baseTexel = ivec2(floor(lowResCoord));
+	vec2 t = lowResCoord - vec2(baseTexel);
+	
+	vec4 hits[4];
+	float depths[4];
+	vec3 defPoints[4];
+	float bilinearWeights[4];
+	int closest = -1;
+	float coverage = 0.;
+	
+	for(int i=0; i<4; i++)
+	{
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 texel = clamp(baseTexel + offset, ivec2(0), lowResSize - 1);
+		vec2 axisWeights = mix(1. - t, t, vec2(offset));
+		
+		hits[i] = texelFetch(u_gBufferHits, texel, 0);
+		depths[i] = HitDepth(hits[i], texel);
+		defPoints[i] = UnprojectDepth((vec2(texel) + 0.5) / vec2(lowResSize), depths[i]);
+		bilinearWeights[i] = axisWeights.x * axisWeights.y;
+		
+		if(hits[i].w == 0.)
+		{
+			continue;
+		}
+		
+		coverage += bilinearWeights[i];
+		
+		if(closest == -1 || depths[i] < depths[closest])
+		{
+			closest = i;
+		}
+	}
+	
+	if(coverage < 0.5)
+	{
+		return false;
+	}
+	
+	// hits on another surface, or on another part of the same one, get close to no weight
+	float tolerance = u_upsampleTolerance * distance(defPoints[closest], u_cameraPos);
+	float invSquaredTolerance = 1. / (tolerance * tolerance);
+	vec3 hitSum = vec3(0.);
+	float depthSum = 0.;
+	float weightSum = 0.;
+	
+	for(int i=0; i<4; i++)
+	{
+		if(hits[i].w == 0.)
+		{
+			continue;
+		}
+		
+		float defDistance = distance(defPoints[i], defPoints[closest]);
+		float undefDistance = distance(hits[i].xyz, hits[closest].xyz);
+		float similarity = exp(-(defDistance * defDistance + undefDistance * undefDistance) * invSquaredTolerance);
+		// the small bias keeps the closest hit when it is at the edge of the footprint
+		float weight = (bilinearWeights[i] + 0.0001) * similarity;
+		
+		hitSum += hits[i].xyz * weight;
+		depthSum += depths[i] * weight;
+		weightSum += weight;
+	}
+	
+	undefHitPoint = hitSum / weightSum;
+	depth = depthSum / weightSum;
+	return true;
+}
+#endif
+
+void main()
+{
+#ifdef BILATERAL_UPSAMPLE
+	vec3 undefHitPoint;
+	float depth;
+	
+	if(!UpsampleHit(undefHitPoint, depth))
+	{
+		discard;
+	}
+#else
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	vec4 hitPoint = texelFetch(u_gBufferHits, pixel, 0);
+	
+	if(hitPoint.w == 0.)
+	{
+		discard;
+	}
+	
+	vec3 undefHitPoint = hitPoint.xyz;
+	float depth = HitDepth(hitPoint, pixel);
+#endif
+	
+	// the deformed ray direction through the pixel center
+	vec2 pixelUV = gl_FragCoord.xy / u_screenSize;
+	vec3 defDirection = normalize(UnprojectDepth(pixelUV, 0.) - u_cameraPos);
+	
+	o_color = vec4(Shade(undefHitPoint, defDirection, lightDirection), 1.);
+	gl_FragDepth = depth;
+}
\ No newline at end of file
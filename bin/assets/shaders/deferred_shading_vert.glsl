@@ -0,0 +1,8 @@
+#version 430
+
+void main()
+{
+	// one triangle covering the screen, no vertex buffer needed
+	vec2 position = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+	gl_Position = vec4(position * 2. - 1., 0., 1.);
+}
\ No newline at end of file
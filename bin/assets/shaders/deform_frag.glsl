@@ -1,17 +1,47 @@
 #version 430
 #include "assets/shaders/deformation.glsl"
 #include "assets/shaders/sdf.glsl"
+#include "assets/shaders/shading.glsl"
 
 layout(location=0) in vec3 i_undeformedPos;
 
 in vec4 gl_FragCoord;
 
-out vec4 o_color;
+layout(location=0) out vec4 o_color;
+#if defined(TEMPORAL_WARM_START) || defined(G_BUFFER)
+// undeformed hit point, w is 1 for hits or the depth of the hit with FRONT_CAGE_ONLY
+layout(location=1) out vec4 o_hitPoint;
+#endif
+#ifdef TEMPORAL_WARM_START
+// undeformed cage point of the fragment that traced the hit, w is 1 for hits
+layout(location=2) out vec4 o_cagePoint;
+#endif
+#ifdef CONSERVATIVE_DEPTH
+// the hit is never in front of the cage, which keeps early depth testing against earlier hits
+layout(depth_greater) out float gl_FragDepth;
+#else
 out float gl_FragDepth;
+#endif
+#ifdef FRONT_CAGE_ONLY
+// the depth pre-pass wrote the front cage depth, only the fragments matching it are traced
+layout(early_fragment_tests) in;
+#endif
 
-// debug settings
-uniform int u_renderMode;// 0 = sphere trace, 1 = mesh
-uniform int u_jointIndex;// used to color based on weight (if not -1)
+// permutation defines (see ShaderPermutations):
+// RENDER_MODE_MESH - draw the cage instead of sphere tracing
+// JOINT_WEIGHT_COLOR - color based on the weight of joint u_jointIndex
+// USE_DEFORMATION_FIELD - sample the baked inverse Jacobian where possible
+// ADAPTIVE_ODE_STEP - adapt the ODE step size to the error estimate, see u_odeTolerance
+// COUNT_STEPS - count the tracing steps and traced pixels in StepCounters
+// CONE_PREPASS - write the cone seed of a low resolution pixel instead of tracing, see ConeTrace
+// CONE_SEEDED_START - start tracing from the cone seed in u_coneSeeds if it is ahead of the cage
+// TEMPORAL_WARM_START - start tracing a bit in front of the previous frame's hit in u_previousHits
+// CAGE_DEPTH_PREPASS - only rasterize the cage depth
+// FRONT_CAGE_ONLY - trace the fragments passing the early depth test against the cage depth pre-pass, 
+// the depth buffer keeps the cage depth and the hit depth is written to o_hitPoint.w instead
+// CONSERVATIVE_DEPTH - keep early depth testing by only moving the depth away from the camera
+// G_BUFFER - only write the hit point and depth, deferred_shading_frag.glsl shades the visible ones
+// BROYDEN_UPDATES - keep a running inverse Jacobian along the ray instead of evaluating it for every direction
 
 uniform mat4 u_VP;
 uniform mat4 u_invVP;
@@ -20,26 +50,87 @@ uniform float u_pixelRadius;
 uniform vec2 u_screenSize;
 uniform float u_maxDistanceFromSurface;
 uniform float u_maxRadius;
+// max position error per ODE step in undeformed space
+uniform float u_odeTolerance;
 
-mat3 DeformationJacobian(const vec3 undefPoint)
-{	
-	// calculate the gradients in the x-, y-, and z-planes using
-	// the forward differences and construct the Jacobian matrix
-	const vec2 diff = vec2(0.0001, 0.);// dx = dy = dz = 0.0001
-	const float scale = 10000.;// = 1 / 0.0001
+// undeformed point and distance from the camera per low resolution pixel (see ConeTrace)
+uniform sampler2D u_coneSeeds;
+
+// the previous frame's o_hitPoint and o_cagePoint, how far in front of the hit to start, and how far
+// the cage point may be from this fragment's for the hit to count as being on the same surface
+uniform sampler2D u_previousHits;
+uniform sampler2D u_previousCagePoints;
+uniform float u_temporalBackOff;
+uniform float u_temporalCageTolerance;
+
+// Broyden updates of the running inverse Jacobian before it is evaluated again, and the max relative 
+// error of its prediction of a step for it to be updated instead of evaluated
+uniform int u_broydenMaxSteps;
+uniform float u_broydenTolerance;
+
+#ifdef COUNT_STEPS
+layout(std430, binding = 7) buffer StepCounters
+{
+	uint totalSteps;
+	uint tracedPixels;
+};
+#endif
+
+// sphere tracing and ODE steps taken by this fragment
+int stepCount = 0;
+
+#ifdef BROYDEN_UPDATES
+// the running inverse Jacobian, where it was last evaluated or updated and the updates since it was evaluated
+mat3 broydenInvJacobian = mat3(1.);
+vec3 broydenUndefPoint = vec3(0.);
+vec3 broydenDefPoint = vec3(0.);
+int broydenUpdates = -1;
+
+mat3 BroydenInverseJacobian(const vec3 undefPoint)
+{
+	vec3 defPoint = Deform(undefPoint);
 	
-	vec3 centerDeformation = Deform(undefPoint);
-	mat3 jacobian = mat3(0.);
-	jacobian[0] = (Deform(undefPoint + diff.xyy) - centerDeformation) * scale;
-	jacobian[1] = (Deform(undefPoint + diff.yxy) - centerDeformation) * scale;
-	jacobian[2] = (Deform(undefPoint + diff.yyx) - centerDeformation) * scale;
+	if(broydenUpdates >= 0 && broydenUpdates < u_broydenMaxSteps)
+	{
+		vec3 undefStep = undefPoint - broydenUndefPoint;
+		vec3 defStep = defPoint - broydenDefPoint;
+		
+		if(undefStep == vec3(0.))
+		{
+			return broydenInvJacobian;
+		}
+		
+		// the "good" Broyden update in Sherman-Morrison form, H += (s - H y) (s^T H) / (s^T H y),
+		// makes the inverse map the deformed step y back to the undeformed step s
+		vec3 predictedStep = broydenInvJacobian * defStep;
+		float denominator = dot(undefStep, predictedStep);
+		float predictionError = length(predictedStep - undefStep);
+		
+		if(predictionError <= u_broydenTolerance * length(undefStep) && abs(denominator) > 1e-12)
+		{
+			broydenInvJacobian += outerProduct(undefStep - predictedStep, undefStep * broydenInvJacobian) / denominator;
+			broydenUndefPoint = undefPoint;
+			broydenDefPoint = defPoint;
+			broydenUpdates++;
+			return broydenInvJacobian;
+		}
+	}
 	
-	return jacobian;
+	broydenInvJacobian = InverseDeformationJacobian(undefPoint);
+	broydenUndefPoint = undefPoint;
+	broydenDefPoint = defPoint;
+	broydenUpdates = 0;
+	return broydenInvJacobian;
 }
+#endif
 
 vec3 UndeformedDirection(const vec3 undefPoint, const vec3 defDirection)
 {
-	mat3 invJacobian = inverse(DeformationJacobian(undefPoint));
+#ifdef BROYDEN_UPDATES
+	mat3 invJacobian = BroydenInverseJacobian(undefPoint);
+#else
+	mat3 invJacobian = InverseDeformationJacobian(undefPoint);
+#endif
 	return normalize(invJacobian * defDirection);
 }
 
@@ -87,6 +178,7 @@ vec3 SolveBS23(
 		y2 = y1 + (c29 * h) * k1 + (c13 * h) * k2 + (c49 * h) * k3;
 		k4 = UndeformedDirection(y2, defDirection);
 		
+		stepCount++;
 		newDistTraveled += h;
 		if(newDistTraveled > paddedMaxRadius)
 		{
@@ -102,6 +194,70 @@ vec3 SolveBS23(
 	return y1 + (c724 * h) * k1 + (c14 * h) * k2 + (c13 * h) * k3 + (c18 * h) * k4;
 }
 
+vec3 SolveBS23Adaptive(
+	const vec3 undefPoint, 
+	const vec3 defDirection, 
+	const float maxRadius, 
+	inout float distTraveled,
+	inout float stepSize
+)
+{
+	// Bogacki-Shampine ODE solver that adapts the step size to the difference between its 
+	// 3rd and embedded 2nd order solutions, the step size is kept between calls along the ray
+	
+	const float minStepSize = 0.001;
+	const float c12 = 1. / 2.;
+	const float c34 = 3. / 4.;
+	const float c29 = 2. / 9.;
+	const float c13 = 1. / 3.;
+	const float c49 = 4. / 9.;
+	const float c724 = 7. / 24.;
+	const float c14 = 1. / 4.;
+	const float c18 = 1. / 8.;
+	
+	vec3 y1 = undefPoint;
+	vec3 k1 = UndeformedDirection(undefPoint, defDirection);
+	float newDistTraveled = 0.;
+	float h = stepSize;
+	
+	for(int i=0; i<16; i++)
+	{
+		// the directions are normalized, so the step size bounds the distance moved
+		float remainingRadius = maxRadius - newDistTraveled;
+		if(remainingRadius < minStepSize)
+		{
+			break;
+		}
+		
+		h = min(max(h, minStepSize), remainingRadius);
+		
+		vec3 k2 = UndeformedDirection(y1 + (c12 * h) * k1, defDirection);
+		vec3 k3 = UndeformedDirection(y1 + (c34 * h) * k2, defDirection);
+		vec3 y2 = y1 + (c29 * h) * k1 + (c13 * h) * k2 + (c49 * h) * k3;
+		vec3 k4 = UndeformedDirection(y2, defDirection);
+		vec3 z2 = y1 + (c724 * h) * k1 + (c14 * h) * k2 + (c13 * h) * k3 + (c18 * h) * k4;
+		stepCount++;
+		
+		float error = distance(y2, z2);
+		float scale = error > 0. ? clamp(0.9 * pow(u_odeTolerance / error, 1. / 3.), 0.2, 5.) : 5.;
+		
+		// steps at the min size are taken regardless of the error, so the ray always advances
+		if(error <= u_odeTolerance || h <= minStepSize)
+		{
+			y1 = y2;
+			k1 = k4;
+			newDistTraveled += h;
+			stepSize = h * scale;
+		}
+		
+		h *= scale;
+	}
+	
+	distTraveled += newDistTraveled;
+	
+	return y1;
+}
+
 float OffsetError(const float distTraveled)
 {
 	const float permittedErrorPerLength = 0.001;
@@ -126,6 +282,45 @@ vec3 AdjustTerminationPoint(
 	return undefPoint + undefDirection * offset;
 }
 
+void NlstStep(
+	inout vec3 undefPoint, 
+	const vec3 defDirection, 
+	const float radius, 
+	const float minRadius, 
+	inout float distTraveled, 
+	inout float stepSize
+)
+{
+	if(radius < minRadius * 3.)
+	{
+		// use simple euler integration step when the radius is small
+		undefPoint += UndeformedDirection(undefPoint, defDirection) * radius;
+		distTraveled += radius;
+		stepCount++;
+	}
+	else
+	{
+		// when the distance to the surface is great, utilize a
+		// ODE solver to traverse the deformed path inside the unbounding-sphere
+#ifdef ADAPTIVE_ODE_STEP
+		undefPoint = SolveBS23Adaptive(
+			undefPoint, 
+			defDirection,  
+			radius, 
+			distTraveled,
+			stepSize
+		);
+#else
+		undefPoint = SolveBS23(
+			undefPoint, 
+			defDirection,  
+			radius, 
+			distTraveled
+		);
+#endif
+	}
+}
+
 vec3 NLST(
 	const vec3 undefOrigin, 
 	const vec3 defDirection, 
@@ -143,6 +338,7 @@ vec3 NLST(
 	
 	float distTraveled = distToOrigin;
 	vec3 undefPoint = undefOrigin;
+	float stepSize = 0.01;
 	hit = false;
 	
 	for(int i=0; i<64; i++)
@@ -161,23 +357,7 @@ vec3 NLST(
 			break;
 		}
 		
-		if(radius < minRadius * 3.)
-		{
-			// use simple euler integration step when the radius is small
-			undefPoint += UndeformedDirection(undefPoint, defDirection) * radius;
-			distTraveled += radius;
-		}
-		else
-		{
-			// when the distance to the surface is great, utilize a
-			// ODE solver to traverse the deformed path inside the unbounding-sphere
-			undefPoint = SolveBS23(
-				undefPoint, 
-				defDirection,  
-				radius, 
-				distTraveled
-			);
-		}
+		NlstStep(undefPoint, defDirection, radius, minRadius, distTraveled, stepSize);
 	}
 	
 	if(hit)
@@ -192,66 +372,63 @@ vec3 NLST(
 	return undefPoint;
 }
 
-vec3 WorldSdfGradient(const vec3 undefPoint)
+#ifdef CONE_PREPASS
+vec4 ConeTrace(
+	const vec3 undefOrigin, 
+	const vec3 defDirection, 
+	const float distToOrigin, 
+	const float undefConeRadiusPerLength, 
+	const float maxDist,
+	const float maxRadius
+)
 {
-	const float step = 0.0001;
-    const vec2 diff = vec2(1., -1.);
-    vec3 undefGradient = 
-		diff.xyy * Sdf(undefPoint + diff.xyy * step) + 
-		diff.yyx * Sdf(undefPoint + diff.yyx * step) + 
-		diff.yxy * Sdf(undefPoint + diff.yxy * step) + 
-		diff.xxx * Sdf(undefPoint + diff.xxx * step);
-					
-	mat3 invJacobian = inverse(DeformationJacobian(undefPoint));
-	vec3 defGradient = transpose(invJacobian) * undefGradient;
+	// NLST with the cone of a low resolution pixel, which contains the rays of all full resolution 
+	// pixels inside it. returns the last undeformed point and distance where the whole cone was 
+	// in front of the surface, w is 0 if the cone left the cage or touched the surface right away
 	
-	return normalize(defGradient);
-}
-
-vec3 DeformationColor(const vec3 undefPoint)
-{
-	const float spectrumScale = 2.;
-	float deformAmount = distance(undefPoint, Deform(undefPoint));
-	deformAmount = min(deformAmount / spectrumScale, 1.);
+	float distTraveled = distToOrigin;
+	vec3 undefPoint = undefOrigin;
+	float stepSize = 0.01;
+	vec4 safePoint = vec4(0.);
 	
-	const vec3 blue = vec3(0.2, 0., 1.);
-	const vec3 green = vec3(0., 1., 0.2);
-	const vec3 yellow = vec3(1., 1., 0.);
-	const vec3 red = vec3(1., 0., 0.);
+	for(int i=0; i<64; i++)
+	{
+		float radius = Sdf(undefPoint);
+		float coneRadius = undefConeRadiusPerLength * distTraveled;
+		
+		if(radius < coneRadius)
+		{
+			break;
+		}
+		
+		if(distTraveled > maxDist || radius > maxRadius)
+		{
+			return vec4(0.);
+		}
+		
+		safePoint = vec4(undefPoint, distTraveled);
+		NlstStep(undefPoint, defDirection, radius, coneRadius, distTraveled, stepSize);
+	}
 	
-	vec3 color = mix(blue, green, smoothstep(0., 0.33, deformAmount));
-	color = mix(color, yellow, smoothstep(0.33, 0.66, deformAmount));
-	color = mix(color, red, smoothstep(0.66, 1., deformAmount));
-	return color;
-}
-
-vec3 JointWeightColor(const vec3 undefPoint)
-{
-	float weight = JointWeight(undefPoint, u_jointIndex);
-	return vec3(weight, 0., 0.);
+	return safePoint;
 }
+#endif
 
-vec3 Shade(const vec3 undefHitPoint, const vec3 defDirection, const vec3 lightDir)
+#if defined(CONE_SEEDED_START) || defined(TEMPORAL_WARM_START)
+vec3 SeedStartPoint(const vec3 undefSeedPoint, const vec3 defTargetPoint)
 {
-	vec3 normal = WorldSdfGradient(undefHitPoint);
-	float diff = max(0., dot(normal, -lightDir));
-	float spec = pow(max(0., dot(reflect(defDirection, normal), -lightDir)), 32.);
+	// the seed deforms to a point near this pixel's ray, newton iterations move it
+	// to the undeformed point that deforms onto the target point on the ray
+	vec3 undefPoint = undefSeedPoint;
 	
-	vec3 ambientColor = vec3(0.1, 0.1, 0.2);
-	vec3 lightColor = vec3(1., 0.9, 0.7);
-	vec3 albedo = vec3(0.);
-	
-	if(u_jointIndex != -1)
+	for(int i=0; i<2; i++)
 	{
-		albedo = JointWeightColor(undefHitPoint);
-	}
-	else
-	{
-		albedo = DeformationColor(undefHitPoint);
+		undefPoint += InverseDeformationJacobian(undefPoint) * (defTargetPoint - Deform(undefPoint));
 	}
 	
-	return albedo * (ambientColor + lightColor * (diff + spec));
+	return undefPoint;
 }
+#endif
 
 float DeformedPointToDepth(const vec3 defPoint)
 {
@@ -261,7 +438,9 @@ float DeformedPointToDepth(const vec3 defPoint)
 
 void main()
 {
-	if(u_renderMode == 0)
+#if defined(CAGE_DEPTH_PREPASS)
+	// the rasterized cage depth is all that is written
+#elif !defined(RENDER_MODE_MESH)
 	{	
 		// calculate the ray's origin and direction to the deformed start point
 		vec3 undefOrigin = i_undeformedPos;
@@ -342,31 +521,105 @@ void main()
 		// to prepare the coefficient for use in undeformed space, we scale with the "deformed-to-undeformed volume scale factor" at the origin point,
 		// that way we only have to multiply by distance traveled to get the undeformed cone radius at that point along the ray
 		//float undefPixelRadiusPerLength = pixelRadiusPerLength * determinant(inverse(DeformationJacobian(undefOrigin)));
-		float undefPixelRadiusPerLength = pixelRadiusPerLength * pow(determinant(inverse(DeformationJacobian(undefOrigin))), 0.333);
+		float undefPixelRadiusPerLength = pixelRadiusPerLength * pow(determinant(InverseDeformationJacobian(undefOrigin)), 0.333);
 		
-		bool hit = false;
-		vec3 undefHitPoint = NLST(
+#ifdef CONE_PREPASS
+		// the pixel cone of this low resolution pass covers the full resolution pixels inside it
+		o_color = ConeTrace(
 			undefOrigin, 
 			defDirection, 
 			distToOrigin, 
 			undefPixelRadiusPerLength,
 			maxDist,
+			maxRadius
+		);
+#else
+		vec3 undefStart = undefOrigin;
+		float distToStart = distToOrigin;
+		
+#ifdef TEMPORAL_WARM_START
+		// start a bit in front of where the previous frame hit, if this fragment's cage surface traced
+		// that hit, it deforms to somewhere near this pixel's ray and the start is still in front of the surface.
+		// a hit traced from another cage surface may be behind a surface that moved in front since
+		vec4 previousHit = texture(u_previousHits, gl_FragCoord.xy / u_screenSize);
+		vec4 previousCagePoint = texture(u_previousCagePoints, gl_FragCoord.xy / u_screenSize);
+		
+		if(previousHit.w > 0. && distance(previousCagePoint.xyz, undefOrigin) < u_temporalCageTolerance)
+		{
+			vec3 defPreviousHit = Deform(previousHit.xyz) - u_cameraPos;
+			float distAlongRay = dot(defPreviousHit, defDirection);
+			float distFromRay = length(defPreviousHit - defDirection * distAlongRay);
+			float warmStartDist = distAlongRay - u_temporalBackOff;
+			
+			if(warmStartDist > distToOrigin && distFromRay < pixelRadiusPerLength * distAlongRay * 4.)
+			{
+				vec3 undefWarmStart = SeedStartPoint(previousHit.xyz, u_cameraPos + defDirection * warmStartDist);
+				
+				// disoccluded or moved into the surface, start from the cage
+				if(Sdf(undefWarmStart) > 0.)
+				{
+					undefStart = undefWarmStart;
+					distToStart = warmStartDist;
+				}
+			}
+		}
+#endif
+		
+#ifdef CONE_SEEDED_START
+		// skip the lead-in that the cone pre-pass found to be empty
+		vec4 coneSeed = texture(u_coneSeeds, gl_FragCoord.xy / u_screenSize);
+		
+		if(coneSeed.w > distToStart)
+		{
+			undefStart = SeedStartPoint(coneSeed.xyz, u_cameraPos + defDirection * coneSeed.w);
+			distToStart = coneSeed.w;
+		}
+#endif
+		
+		bool hit = false;
+		vec3 undefHitPoint = NLST(
+			undefStart, 
+			defDirection, 
+			distToStart, 
+			undefPixelRadiusPerLength,
+			maxDist,
 			maxRadius,
 			hit
 		);
 		
+#ifdef COUNT_STEPS
+		atomicAdd(totalSteps, uint(stepCount));
+		atomicAdd(tracedPixels, 1u);
+#endif
+		
 		if(!hit)
 		{
 			discard;
 		}
 		
-		vec3 lightDir = normalize(vec3(-0.8, -1., 0.6));
-		o_color = vec4(Shade(undefHitPoint, defDirection, lightDir), 1.);
+#ifndef G_BUFFER
+		o_color = vec4(Shade(undefHitPoint, defDirection, lightDirection), 1.);
+#endif
+#if defined(CONSERVATIVE_DEPTH)
+		// the termination adjustment can move the hit slightly in front of the cage
+		gl_FragDepth = max(DeformedPointToDepth(Deform(undefHitPoint)), gl_FragCoord.z);
+#elif !defined(FRONT_CAGE_ONLY)
 		gl_FragDepth = DeformedPointToDepth(Deform(undefHitPoint));
+#endif
+#if (defined(TEMPORAL_WARM_START) || defined(G_BUFFER)) && defined(FRONT_CAGE_ONLY)
+		o_hitPoint = vec4(undefHitPoint, DeformedPointToDepth(Deform(undefHitPoint)));
+#elif defined(TEMPORAL_WARM_START) || defined(G_BUFFER)
+		o_hitPoint = vec4(undefHitPoint, 1.);
+#endif
+#ifdef TEMPORAL_WARM_START
+		o_cagePoint = vec4(undefOrigin, 1.);
+#endif
+#endif
 	}
-	else
+#else
 	{
 		o_color = vec4(0.25, 0.25, 0.25, 1.);
 		gl_FragDepth = DeformedPointToDepth(Deform(i_undeformedPos));
 	}
+#endif
 }
\ No newline at end of file
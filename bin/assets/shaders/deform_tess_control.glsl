@@ -1,36 +1,16 @@
 #version 430
 #include "assets/shaders/deformation.glsl"
+#include "assets/shaders/tessellation.glsl"
 
 layout(vertices=3) out;
 
 layout(location=0) in vec3 i_deformedPos[];
 
-float LinearizationError(vec3 undeformedPos, vec3 deformedPos)
+// unique edge ids of each triangle, in the edge order below
+layout(std430, binding=3) readonly buffer TriangleEdges
 {
-	// differance between the interpolated deformed position and the deformed interpolated position
-	return distance(deformedPos, Deform(undeformedPos));
-}
-
-float GetTessellationLevel(float error)
-{
-	if(error > 0.04)
-	{
-		return 5.;
-	}
-	if(error > 0.03)
-	{
-		return 4.;
-	}
-	if(error > 0.02)
-	{
-		return 3.;
-	}
-	if(error > 0.01)
-	{
-		return 2.;
-	}
-	return 1.;
-}
+	uint triangleEdges[];
+};
 
 void main()
 {
@@ -49,6 +29,19 @@ void main()
 	// edge 0: start = 1, end = 2
 	// edge 1: start = 0, end = 2
 	// edge 2: start = 0, end = 1
+	float edgeErrors[3] = float[](
+		0., 0., 0.
+	);
+	
+#ifdef PRECOMPUTED_TESSELLATION
+	// the errors were computed once per unique edge in the pre-pass
+	for(int i=0; i<3; i++)
+	{
+		vec2 tessellation = edgeTessellation[triangleEdges[gl_PrimitiveID * 3 + i]];
+		edgeErrors[i] = tessellation.x;
+		gl_TessLevelOuter[i] = tessellation.y;
+	}
+#else
 	const int edgeStartIndices[3] = int[]
 	(
 		1, 0, 0
@@ -57,45 +50,25 @@ void main()
 	(
 		2, 2, 1
 	);
-	const int edgeSections = 5;
-	const float invEdgeSections = 1. / float(edgeSections);
-	
-	float edgeErrors[3] = float[](
-		0., 0., 0.
-	);
 	
 	for(int i=0; i<3; i++)
 	{
 		int startIndex = edgeStartIndices[i];
 		int endIndex = edgeEndIndices[i];
 		
-		vec3 undefEdgeStart = gl_in[startIndex].gl_Position.xyz;
-		vec3 undefEdgeEnd = gl_in[endIndex].gl_Position.xyz;
-		vec3 undefEdge = undefEdgeEnd - undefEdgeStart;
-		
-		vec3 defEdgeStart = i_deformedPos[startIndex];
-		vec3 defEdgeEnd = i_deformedPos[endIndex];
-		vec3 defEdge = defEdgeEnd - defEdgeStart;
-		
-		for(int j=0; j<=edgeSections; j++)
-		{
-			float edgeScale = float(j) * invEdgeSections;
-			
-			vec3 undefPoint = undefEdgeStart + undefEdge * edgeScale;
-			vec3 defPoint = defEdgeStart + defEdge * edgeScale;
-			
-			edgeErrors[i] += LinearizationError(undefPoint, defPoint);
-		}
-		
-		edgeErrors[i] *= invEdgeSections;
+		edgeErrors[i] = EdgeLinearizationError(
+			gl_in[startIndex].gl_Position.xyz,
+			gl_in[endIndex].gl_Position.xyz,
+			i_deformedPos[startIndex],
+			i_deformedPos[endIndex]
+		);
+		gl_TessLevelOuter[i] = GetTessellationLevel(edgeErrors[i]);
 	}
+#endif
 	
 	// use the average edge error for the center tessellation
 	float averageError = 
 		(edgeErrors[0] + edgeErrors[1] + edgeErrors[2]) / 3.;
 	
-	gl_TessLevelOuter[0] = GetTessellationLevel(edgeErrors[0]);
-	gl_TessLevelOuter[1] = GetTessellationLevel(edgeErrors[1]);
-	gl_TessLevelOuter[2] = GetTessellationLevel(edgeErrors[2]);
 	gl_TessLevelInner[0] = GetTessellationLevel(averageError);
 }
\ No newline at end of file
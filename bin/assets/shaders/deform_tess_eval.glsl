@@ -4,6 +4,8 @@
 layout(triangles, equal_spacing, ccw) in;
 
 layout(location=0) out vec3 o_undeformedPos;
+// the cage depth pre-pass and the trace pass are different programs whose depths are compared with GL_LEQUAL
+invariant gl_Position;
 
 uniform mat4 u_VP;
 
@@ -1,5 +1,6 @@
 #version 430
 #include "assets/shaders/deformation.glsl"
+#include "assets/shaders/tessellation.glsl"
 
 layout(location=0) in vec3 a_position;
 
@@ -7,7 +8,12 @@ layout(location=0) out vec3 o_deformedPos;
 
 void main()
 {
+#ifdef PRECOMPUTED_TESSELLATION
+	// gl_VertexID is the index into the cage vertices since the mesh is drawn with an index buffer
+	o_deformedPos = deformedPositions[gl_VertexID].xyz;
+#else
 	o_deformedPos = Deform(a_position);
+#endif
 	
 	gl_Position = vec4(a_position, 1.);
 }
\ No newline at end of file
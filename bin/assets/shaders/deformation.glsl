@@ -1,5 +1,21 @@
 
 #define MAX_JOINTS 16
+
+// permutation defines (see ShaderPermutations):
+// JOINT_COUNT - the joint count rounded up to a bucket size, gives the joint loops a constant trip count
+// SKINNING_MODE - replaces u_skinningMode with a constant
+#ifdef JOINT_COUNT
+#define JOINT_LOOP_COUNT JOINT_COUNT
+#else
+#define JOINT_LOOP_COUNT MAX_JOINTS
+#endif
+
+#ifdef SKINNING_MODE
+#define CURRENT_SKINNING_MODE SKINNING_MODE
+#else
+#define CURRENT_SKINNING_MODE u_skinningMode
+#endif
+
 struct JointWeightVolume
 {
 	vec3 startPoint;
@@ -8,9 +24,12 @@ struct JointWeightVolume
 	float falloffRate;
 };
 
+uniform int u_skinningMode;// 0 = linear blend, 1 = dual quaternion
 uniform int u_jointCount;
 uniform JointWeightVolume u_jointWeightVolumes[MAX_JOINTS];
 uniform mat4 u_deformationMatrices[MAX_JOINTS];
+uniform vec4 u_dualQuaternions[MAX_JOINTS * 2];// real part at 2 * i, dual part at 2 * i + 1
+uniform float u_jointScales[MAX_JOINTS];
 
 /*vec3 Kelvinlet(vec3 point, vec3 center, vec3 force) 
 {
@@ -33,6 +52,23 @@ float JointWeight(vec3 point, int jointIndex)
 	return 1./(1. + joint.falloffRate * distanceSquared * distanceSquared);
 }
 
+float JointWeightAndGradient(vec3 point, int jointIndex, out vec3 gradient)
+{
+	// same as JointWeight, but also returns the analytic gradient of the weight
+	JointWeightVolume joint = u_jointWeightVolumes[jointIndex];
+	vec3 startToPoint = point - joint.startPoint;
+	float projectionLength = clamp(dot(startToPoint, joint.direction), 0., joint.length);
+	vec3 projectionToPoint = startToPoint - joint.direction * projectionLength;
+	float distanceSquared = dot(projectionToPoint, projectionToPoint);
+	float weight = 1./(1. + joint.falloffRate * distanceSquared * distanceSquared);
+	
+	// d(weight)/d(distanceSquared) = -2 * falloffRate * distanceSquared * weight^2
+	// and the gradient of the squared distance to a line segment is 2 * projectionToPoint
+	gradient = (-4. * joint.falloffRate * distanceSquared * weight * weight) * projectionToPoint;
+	
+	return weight;
+}
+
 vec3 LinearBlend(vec3 point)
 {	
 	if(u_jointCount == 0)
@@ -43,8 +79,13 @@ vec3 LinearBlend(vec3 point)
 	float weightSum = 0.;
 	vec3 result = vec3(0.);
 	
-	for(int i=0; i<u_jointCount; i++)
+	for(int i=0; i<JOINT_LOOP_COUNT; i++)
 	{
+		if(i == u_jointCount)
+		{
+			break;
+		}
+		
 		float weight = JointWeight(point, i);
 		result += weight * vec3(u_deformationMatrices[i] * vec4(point, 1.));
 		weightSum += weight;
@@ -53,7 +94,174 @@ vec3 LinearBlend(vec3 point)
 	return result * (1. / weightSum);
 }
 
+vec4 QuatMul(vec4 q1, vec4 q2)
+{
+	return vec4(
+		q1.w * q2.xyz + q2.w * q1.xyz + cross(q1.xyz, q2.xyz),
+		q1.w * q2.w - dot(q1.xyz, q2.xyz)
+	);
+}
+
+vec3 DualQuaternionTransform(vec4 real, vec4 dual, vec3 point)
+{
+	// the real part does not have to be normalized, since both the rotation and the
+	// translation are divided by its squared length
+	float invLengthSquared = 1. / dot(real, real);
+	vec3 rotated = point + 2. * cross(real.xyz, cross(real.xyz, point) + real.w * point) * invLengthSquared;
+	vec3 translation = 2. * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz)) * invLengthSquared;
+	
+	return rotated + translation;
+}
+
+vec3 DualQuaternionBlend(vec3 point)
+{
+	if(u_jointCount == 0)
+	{
+		return point;
+	}
+	
+	vec4 pivot = u_dualQuaternions[0];
+	vec4 real = vec4(0.);
+	vec4 dual = vec4(0.);
+	float scale = 0.;
+	float weightSum = 0.;
+	
+	for(int i=0; i<JOINT_LOOP_COUNT; i++)
+	{
+		if(i == u_jointCount)
+		{
+			break;
+		}
+		
+		float weight = JointWeight(point, i);
+		vec4 jointReal = u_dualQuaternions[2 * i];
+		
+		// blend along the shortest path by keeping all rotations in the same hemisphere
+		float signedWeight = dot(jointReal, pivot) < 0. ? -weight : weight;
+		
+		real += signedWeight * jointReal;
+		dual += signedWeight * u_dualQuaternions[2 * i + 1];
+		scale += weight * u_jointScales[i];
+		weightSum += weight;
+	}
+	
+	return DualQuaternionTransform(real, dual, point * (scale / weightSum));
+}
+
+mat3 DualQuaternionJacobian(vec3 point)
+{
+	// analytic Jacobian of DualQuaternionBlend, where the weights, and therefore the blended
+	// dual quaternion and scale, vary with the point
+	if(u_jointCount == 0)
+	{
+		return mat3(1.);
+	}
+	
+	vec4 pivot = u_dualQuaternions[0];
+	vec4 real = vec4(0.);
+	vec4 dual = vec4(0.);
+	float scale = 0.;
+	float weightSum = 0.;
+	vec4 realGradient[3] = vec4[](vec4(0.), vec4(0.), vec4(0.));
+	vec4 dualGradient[3] = vec4[](vec4(0.), vec4(0.), vec4(0.));
+	vec3 scaleGradient = vec3(0.);
+	vec3 weightSumGradient = vec3(0.);
+	
+	for(int i=0; i<JOINT_LOOP_COUNT; i++)
+	{
+		if(i == u_jointCount)
+		{
+			break;
+		}
+		
+		vec3 weightGradient = vec3(0.);
+		float weight = JointWeightAndGradient(point, i, weightGradient);
+		vec4 jointReal = u_dualQuaternions[2 * i];
+		vec4 jointDual = u_dualQuaternions[2 * i + 1];
+		float jointSign = dot(jointReal, pivot) < 0. ? -1. : 1.;
+		
+		real += (jointSign * weight) * jointReal;
+		dual += (jointSign * weight) * jointDual;
+		scale += weight * u_jointScales[i];
+		weightSum += weight;
+		
+		for(int k=0; k<3; k++)
+		{
+			realGradient[k] += (jointSign * weightGradient[k]) * jointReal;
+			dualGradient[k] += (jointSign * weightGradient[k]) * jointDual;
+		}
+		scaleGradient += weightGradient * u_jointScales[i];
+		weightSumGradient += weightGradient;
+	}
+	
+	float normalizedScale = scale / weightSum;
+	vec3 normalizedScaleGradient = (scaleGradient - normalizedScale * weightSumGradient) / weightSum;
+	vec3 scaledPoint = point * normalizedScale;
+	
+	float lengthSquared = dot(real, real);
+	vec3 deformedPoint = DualQuaternionTransform(real, dual, scaledPoint);
+	vec3 rotationTerm = cross(real.xyz, scaledPoint) + real.w * scaledPoint;
+	
+	mat3 jacobian = mat3(0.);
+	
+	for(int k=0; k<3; k++)
+	{
+		// derivatives along axis k of all inputs to the (unnormalized) transform
+		vec4 dReal = realGradient[k];
+		vec4 dDual = dualGradient[k];
+		vec3 dPoint = point * normalizedScaleGradient[k];
+		dPoint[k] += normalizedScale;
+		float dLengthSquared = 2. * dot(real, dReal);
+		
+		// product rule applied to
+		// lengthSquared * point + 2 * real.xyz x (real.xyz x point + real.w * point) +
+		// 2 * (real.w * dual.xyz - dual.w * real.xyz + real.xyz x dual.xyz)
+		vec3 dRotationTerm = 
+			cross(dReal.xyz, scaledPoint) + cross(real.xyz, dPoint) + 
+			dReal.w * scaledPoint + real.w * dPoint;
+		vec3 dNumerator = 
+			dLengthSquared * scaledPoint + lengthSquared * dPoint + 
+			2. * (cross(dReal.xyz, rotationTerm) + cross(real.xyz, dRotationTerm)) + 
+			2. * (
+				dReal.w * dual.xyz + real.w * dDual.xyz - 
+				dDual.w * real.xyz - dual.w * dReal.xyz + 
+				cross(dReal.xyz, dual.xyz) + cross(real.xyz, dDual.xyz)
+			);
+		
+		// quotient rule for the division by the squared length
+		jacobian[k] = (dNumerator - deformedPoint * dLengthSquared) / lengthSquared;
+	}
+	
+	return jacobian;
+}
+
 vec3 Deform(vec3 pos)
 {
+	if(CURRENT_SKINNING_MODE == 1)
+	{
+		return DualQuaternionBlend(pos);
+	}
+	
 	return LinearBlend(pos);
+}
+
+mat3 DeformationJacobian(const vec3 undefPoint)
+{	
+	if(CURRENT_SKINNING_MODE == 1)
+	{
+		return DualQuaternionJacobian(undefPoint);
+	}
+	
+	// calculate the gradients in the x-, y-, and z-planes using
+	// the forward differences and construct the Jacobian matrix
+	const vec2 diff = vec2(0.0001, 0.);// dx = dy = dz = 0.0001
+	const float scale = 10000.;// = 1 / 0.0001
+	
+	vec3 centerDeformation = Deform(undefPoint);
+	mat3 jacobian = mat3(0.);
+	jacobian[0] = (Deform(undefPoint + diff.xyy) - centerDeformation) * scale;
+	jacobian[1] = (Deform(undefPoint + diff.yxy) - centerDeformation) * scale;
+	jacobian[2] = (Deform(undefPoint + diff.yyx) - centerDeformation) * scale;
+	
+	return jacobian;
 }
\ No newline at end of file
@@ -0,0 +1,33 @@
+#version 430
+#include "assets/shaders/deformation.glsl"
+
+layout(local_size_x=4, local_size_y=4, local_size_z=4) in;
+
+uniform vec3 u_volumeMin;
+uniform vec3 u_voxelSize;
+uniform int u_voxelCountX;
+uniform int u_voxelCountY;
+uniform int u_voxelCountZ;
+
+// one column of the inverse deformation Jacobian per image
+layout(rgba32f, binding=0) writeonly uniform image3D o_inverseJacobianColumn0;
+layout(rgba32f, binding=1) writeonly uniform image3D o_inverseJacobianColumn1;
+layout(rgba32f, binding=2) writeonly uniform image3D o_inverseJacobianColumn2;
+
+void main() 
+{
+	ivec3 index3d = ivec3(gl_GlobalInvocationID);
+	
+	if(any(greaterThanEqual(index3d, ivec3(u_voxelCountX, u_voxelCountY, u_voxelCountZ))))
+	{
+		return;
+	}
+	
+	// sample at the voxel center to match trilinear texture filtering
+	vec3 voxelPos = u_volumeMin + u_voxelSize * (vec3(index3d) + 0.5);
+	mat3 invJacobian = inverse(DeformationJacobian(voxelPos));
+	
+	imageStore(o_inverseJacobianColumn0, index3d, vec4(invJacobian[0], 0.));
+	imageStore(o_inverseJacobianColumn1, index3d, vec4(invJacobian[1], 0.));
+	imageStore(o_inverseJacobianColumn2, index3d, vec4(invJacobian[2], 0.));
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+// surface normals and shading of undeformed hit points, shared by the tracing 
+// and the deferred shading pass
+uniform int u_jointIndex;
+
+// baked inverse Jacobian (see deformation_field_compute.glsl)
+uniform sampler3D u_inverseJacobianColumns[3];
+uniform vec3 u_deformationFieldMin;
+uniform vec3 u_deformationFieldInvSize;
+
+mat3 InverseDeformationJacobian(const vec3 undefPoint)
+{
+#ifdef USE_DEFORMATION_FIELD
+	// sample the baked field if the point is inside it, otherwise fall back to evaluating the deformation
+	vec3 fieldUVW = (undefPoint - u_deformationFieldMin) * u_deformationFieldInvSize;
+	
+	if(all(greaterThanEqual(fieldUVW, vec3(0.))) && all(lessThanEqual(fieldUVW, vec3(1.))))
+	{
+		return mat3(
+			texture(u_inverseJacobianColumns[0], fieldUVW).xyz,
+			texture(u_inverseJacobianColumns[1], fieldUVW).xyz,
+			texture(u_inverseJacobianColumns[2], fieldUVW).xyz
+		);
+	}
+#endif
+	
+	return inverse(DeformationJacobian(undefPoint));
+}
+
+const vec3 lightDirection = normalize(vec3(-0.8, -1., 0.6));
+
+vec3 WorldSdfGradient(const vec3 undefPoint)
+{
+	const float step = 0.0001;
+    const vec2 diff = vec2(1., -1.);
+    vec3 undefGradient = 
+		diff.xyy * Sdf(undefPoint + diff.xyy * step) + 
+		diff.yyx * Sdf(undefPoint + diff.yyx * step) + 
+		diff.yxy * Sdf(undefPoint + diff.yxy * step) + 
+		diff.xxx * Sdf(undefPoint + diff.xxx * step);
+					
+	mat3 invJacobian = InverseDeformationJacobian(undefPoint);
+	vec3 defGradient = transpose(invJacobian) * undefGradient;
+	
+	return normalize(defGradient);
+}
+
+vec3 DeformationColor(const vec3 undefPoint)
+{
+	const float spectrumScale = 2.;
+	float deformAmount = distance(undefPoint, Deform(undefPoint));
+	deformAmount = min(deformAmount / spectrumScale, 1.);
+	
+	const vec3 blue = vec3(0.2, 0., 1.);
+	const vec3 green = vec3(0., 1., 0.2);
+	const vec3 yellow = vec3(1., 1., 0.);
+	const vec3 red = vec3(1., 0., 0.);
+	
+	vec3 color = mix(blue, green, smoothstep(0., 0.33, deformAmount));
+	color = mix(color, yellow, smoothstep(0.33, 0.66, deformAmount));
+	color = mix(color, red, smoothstep(0.66, 1., deformAmount));
+	return color;
+}
+
+#ifdef JOINT_WEIGHT_COLOR
+vec3 JointWeightColor(const vec3 undefPoint)
+{
+	float weight = JointWeight(undefPoint, u_jointIndex);
+	return vec3(weight, 0., 0.);
+}
+#endif
+
+vec3 Shade(const vec3 undefHitPoint, const vec3 defDirection, const vec3 lightDir)
+{
+	vec3 normal = WorldSdfGradient(undefHitPoint);
+	float diff = max(0., dot(normal, -lightDir));
+	float spec = pow(max(0., dot(reflect(defDirection, normal), -lightDir)), 32.);
+	
+	vec3 ambientColor = vec3(0.1, 0.1, 0.2);
+	vec3 lightColor = vec3(1., 0.9, 0.7);
+#ifdef JOINT_WEIGHT_COLOR
+	vec3 albedo = JointWeightColor(undefHitPoint);
+#else
+	vec3 albedo = DeformationColor(undefHitPoint);
+#endif
+	
+	return albedo * (ambientColor + lightColor * (diff + spec));
+}
\ No newline at end of file
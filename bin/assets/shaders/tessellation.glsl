@@ -0,0 +1,68 @@
+// requires deformation.glsl to be included first
+
+// permutation defines:
+// PRECOMPUTED_TESSELLATION - deformed vertices and per-edge tessellation levels are read from
+// the buffers written by tessellation_prepass_compute.glsl instead of being evaluated per patch
+
+// deformed vertex positions, indexed by vertex id
+layout(std430, binding=1) buffer DeformedPositions
+{
+	vec4 deformedPositions[];
+};
+
+// x = linearization error, y = tessellation level, indexed by edge id
+layout(std430, binding=4) buffer EdgeTessellation
+{
+	vec2 edgeTessellation[];
+};
+
+const int EDGE_SECTIONS = 5;
+
+float LinearizationError(vec3 undeformedPos, vec3 deformedPos)
+{
+	// differance between the interpolated deformed position and the deformed interpolated position
+	return distance(deformedPos, Deform(undeformedPos));
+}
+
+float EdgeLinearizationError(vec3 undefEdgeStart, vec3 undefEdgeEnd, vec3 defEdgeStart, vec3 defEdgeEnd)
+{
+	const float invEdgeSections = 1. / float(EDGE_SECTIONS);
+	
+	vec3 undefEdge = undefEdgeEnd - undefEdgeStart;
+	vec3 defEdge = defEdgeEnd - defEdgeStart;
+	float error = 0.;
+	
+	// the end points are deformed exactly, so only the inner points contribute
+	for(int j=1; j<EDGE_SECTIONS; j++)
+	{
+		float edgeScale = float(j) * invEdgeSections;
+		
+		vec3 undefPoint = undefEdgeStart + undefEdge * edgeScale;
+		vec3 defPoint = defEdgeStart + defEdge * edgeScale;
+		
+		error += LinearizationError(undefPoint, defPoint);
+	}
+	
+	return error * invEdgeSections;
+}
+
+float GetTessellationLevel(float error)
+{
+	if(error > 0.04)
+	{
+		return 5.;
+	}
+	if(error > 0.03)
+	{
+		return 4.;
+	}
+	if(error > 0.02)
+	{
+		return 3.;
+	}
+	if(error > 0.01)
+	{
+		return 2.;
+	}
+	return 1.;
+}
\ No newline at end of file
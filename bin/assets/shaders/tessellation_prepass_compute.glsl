@@ -0,0 +1,71 @@
+#version 430
+#include "assets/shaders/deformation.glsl"
+#include "assets/shaders/tessellation.glsl"
+
+// built twice (see TessellationPrepass):
+// VERTEX_PASS - deforms every cage vertex once
+// otherwise - evaluates the linearization error and tessellation level of every unique edge
+// the results persist across frames, so only the elements influenced by changed joints are updated
+layout(local_size_x=64) in;
+
+uniform int u_elementCount;
+uniform int u_updateAll;// ignore the joint masks, the cached results are invalid
+uniform uint u_changedJointMask;// a bit per joint whose deformation changed since the last update
+
+layout(std430, binding=0) readonly buffer UndeformedPositions
+{
+	vec4 undeformedPositions[];
+};
+
+// vertex indices of each unique edge
+layout(std430, binding=2) readonly buffer Edges
+{
+	uvec2 edges[];
+};
+
+// a bit per joint influencing each vertex and edge, computed when binding the skeleton
+layout(std430, binding=5) readonly buffer VertexJointMasks
+{
+	uint vertexJointMasks[];
+};
+
+layout(std430, binding=6) readonly buffer EdgeJointMasks
+{
+	uint edgeJointMasks[];
+};
+
+void main() 
+{
+	uint index = gl_GlobalInvocationID.x;
+	
+	if(index >= uint(u_elementCount))
+	{
+		return;
+	}
+	
+#ifdef VERTEX_PASS
+	// keep the cached result if none of the influencing joints changed
+	if(u_updateAll == 0 && (vertexJointMasks[index] & u_changedJointMask) == 0u)
+	{
+		return;
+	}
+	
+	deformedPositions[index] = vec4(Deform(undeformedPositions[index].xyz), 1.);
+#else
+	if(u_updateAll == 0 && (edgeJointMasks[index] & u_changedJointMask) == 0u)
+	{
+		return;
+	}
+	
+	uvec2 edge = edges[index];
+	
+	float error = EdgeLinearizationError(
+		undeformedPositions[edge.x].xyz,
+		undeformedPositions[edge.y].xyz,
+		deformedPositions[edge.x].xyz,
+		deformedPositions[edge.y].xyz
+	);
+	
+	edgeTessellation[index] = vec2(error, GetTessellationLevel(error));
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#include "analytic_sdf.h"
+#include <glm.hpp>
+
+namespace Engine
+{
+	// source: https://iquilezles.org/articles/distfunctions/
+	static float SmoothUnion(float d1, float d2, float k)
+	{
+		float h = glm::clamp(0.5f + 0.5f * (d2 - d1) / k, 0.f, 1.f);
+		return glm::mix(d2, d1, h) - k * h * (1.f - h);
+	}
+
+	static float SD_Capsule(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, float radius)
+	{
+		glm::vec3 pa = p - a;
+		glm::vec3 ba = b - a;
+		float h = glm::clamp(glm::dot(pa, ba) / glm::dot(ba, ba), 0.f, 1.f);
+		return glm::length(pa - ba * h) - radius;
+	}
+
+	static Simd::FloatPacket SmoothUnion(const Simd::FloatPacket& d1, const Simd::FloatPacket& d2, float k)
+	{
+		Simd::FloatPacket h = Simd::Clamp(0.5f + 0.5f * (d2 - d1) / k, 0.f, 1.f);
+		return d2 + (d1 - d2) * h - k * h * (1.f - h);
+	}
+
+	static Simd::FloatPacket SD_Capsule(const Simd::Vec3Packet& p, const glm::vec3& a, const glm::vec3& b, float radius)
+	{
+		Simd::Vec3Packet pa = p - Simd::Vec3Packet(a);
+		glm::vec3 ba = b - a;
+		Simd::FloatPacket h = Simd::Clamp(Simd::Dot(pa, ba) * (1.f / glm::dot(ba, ba)), 0.f, 1.f);
+		return Simd::Length(pa - Simd::Vec3Packet(ba) * h) - radius;
+	}
+
+	float AnalyticSdf(const glm::vec3& p)
+	{
+		float torso = SD_Capsule(p, glm::vec3(0.f, -0.5f, 0.f), glm::vec3(0.f, 0.5f, 0.f), 0.25f);
+		glm::vec3 mirroredP(glm::abs(p.x), p.y, p.z);
+		float arms = SD_Capsule(mirroredP, glm::vec3(0.25f, 0.5f, 0.f), glm::vec3(1.f, 0.5f, 0.f), 0.1f);
+		float legs = SD_Capsule(mirroredP, glm::vec3(0.25f, -0.5f, 0.f), glm::vec3(0.4f, -1.4f, 0.f), 0.15f);
+		float head = glm::length(p - glm::vec3(0.f, 1.1f, 0.f)) - 0.2f;
+		float eyes = glm::length(glm::vec3(glm::abs(p.x) - 0.1f, p.y - 1.1f, p.z + 0.2f)) - 0.03f;
+		head = glm::min(head, eyes);
+
+		return SmoothUnion(SmoothUnion(glm::min(torso, head), arms, 0.2f), legs, 0.2f);
+	}
+
+	Simd::FloatPacket AnalyticSdf(const Simd::Vec3Packet& p)
+	{
+		Simd::FloatPacket torso = SD_Capsule(p, glm::vec3(0.f, -0.5f, 0.f), glm::vec3(0.f, 0.5f, 0.f), 0.25f);
+		Simd::Vec3Packet mirroredP(Simd::Abs(p.x), p.y, p.z);
+		Simd::FloatPacket arms = SD_Capsule(mirroredP, glm::vec3(0.25f, 0.5f, 0.f), glm::vec3(1.f, 0.5f, 0.f), 0.1f);
+		Simd::FloatPacket legs = SD_Capsule(mirroredP, glm::vec3(0.25f, -0.5f, 0.f), glm::vec3(0.4f, -1.4f, 0.f), 0.15f);
+		Simd::FloatPacket head = Simd::Length(p - Simd::Vec3Packet(glm::vec3(0.f, 1.1f, 0.f))) - 0.2f;
+		Simd::FloatPacket eyes = Simd::Length(Simd::Vec3Packet(Simd::Abs(p.x) - 0.1f, p.y - 1.1f, p.z + 0.2f)) - 0.03f;
+		head = Simd::Min(head, eyes);
+
+		return SmoothUnion(SmoothUnion(Simd::Min(torso, head), arms, 0.2f), legs, 0.2f);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#pragma once
+#include "simd.h"
+#include <vec3.hpp>
+
+namespace Engine
+{
+	// cpu mirror of Sdf in assets/shaders/sdf.glsl, which the gpu traces, so that cpu renders
+	// trace the exact same surface. has to be kept in sync with the shader
+	float AnalyticSdf(const glm::vec3& point);
+	Simd::FloatPacket AnalyticSdf(const Simd::Vec3Packet& points);
+}
\ No newline at end of file
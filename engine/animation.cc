@@ -1,6 +1,9 @@
 #include "animation.h"
+#include "simd.h"
 #include <gtx/quaternion.hpp>
 #include <cassert>
+#include <cmath>
+#include <atomic>
 
 namespace Engine
 {
@@ -11,55 +14,396 @@ namespace Engine
 	{}
 
 
-	BindPose::BindPose() :
-		p_inverseWorldMatrices(nullptr),
-		p_worldWeightVolumes(nullptr)
+	TransformChannels::TransformChannels() :
+		p_data(nullptr),
+		p_positions{ nullptr, nullptr, nullptr },
+		p_rotations{ nullptr, nullptr, nullptr, nullptr },
+		p_scales(nullptr),
+		ownsData(false)
 	{}
 
-	BindPose::~BindPose()
+	TransformChannels::~TransformChannels()
+	{
+		if (ownsData)
+			delete[] p_data;
+	}
+
+	static size_t PaddedCount(size_t count)
+	{
+		return (count + Simd::Width - 1) / Simd::Width * Simd::Width;
+	}
+
+	// points the streams into the data and fills them with identity transforms
+	static void InitChannels(TransformChannels& channels, size_t paddedCount)
+	{
+		for (size_t i = 0; i < 3; i++)
+			channels.p_positions[i] = channels.p_data + i * paddedCount;
+
+		for (size_t i = 0; i < 4; i++)
+			channels.p_rotations[i] = channels.p_data + (3 + i) * paddedCount;
+
+		channels.p_scales = channels.p_data + 7 * paddedCount;
+
+		for (size_t i = 0; i < paddedCount; i++)
+			channels.Set(i, Transform());
+	}
+
+	size_t TransformChannels::ByteSize(size_t count)
+	{
+		return LinearAllocator::ByteSize<float>(PaddedCount(count) * 8);
+	}
+
+	void TransformChannels::Allocate(size_t count)
+	{
+		assert(p_data == nullptr);
+		size_t paddedCount = PaddedCount(count);
+		p_data = new float[paddedCount * 8]();
+		ownsData = true;
+		InitChannels(*this, paddedCount);
+	}
+
+	void TransformChannels::Allocate(size_t count, LinearAllocator& allocator)
+	{
+		assert(p_data == nullptr);
+		size_t paddedCount = PaddedCount(count);
+		// not zeroed first, the streams are all written with identity transforms
+		p_data = static_cast<float*>(allocator.Allocate(paddedCount * 8 * sizeof(float)));
+		ownsData = false;
+		InitChannels(*this, paddedCount);
+	}
+
+	Transform TransformChannels::Get(size_t index) const
+	{
+		return Transform(
+			glm::vec3(p_positions[0][index], p_positions[1][index], p_positions[2][index]),
+			glm::quat(p_rotations[3][index], p_rotations[0][index], p_rotations[1][index], p_rotations[2][index]),
+			p_scales[index]
+		);
+	}
+
+	void TransformChannels::Set(size_t index, const Transform& transform)
 	{
-		delete[] p_inverseWorldMatrices;
-		delete[] p_worldWeightVolumes;
+		for (glm::length_t i = 0; i < 3; i++)
+			p_positions[i][index] = transform.position[i];
+
+		p_rotations[0][index] = transform.rotation.x;
+		p_rotations[1][index] = transform.rotation.y;
+		p_rotations[2][index] = transform.rotation.z;
+		p_rotations[3][index] = transform.rotation.w;
+		p_scales[index] = transform.scale;
 	}
 
+
+	BindPose::BindPose() :
+		p_inverseWorldMatrices(nullptr),
+		p_worldWeightVolumes(nullptr)
+	{}
+
 	void BindPose::Allocate(size_t jointCount)
 	{
 		assert(p_inverseWorldMatrices == nullptr && p_worldWeightVolumes == nullptr);
-		p_inverseWorldMatrices = new glm::mat4[jointCount]();
-		p_worldWeightVolumes = new JointWeightVolume[jointCount]();
+		allocator.Reserve(
+			LinearAllocator::ByteSize<glm::mat4>(jointCount) +
+			TransformChannels::ByteSize(jointCount) +
+			LinearAllocator::ByteSize<JointWeightVolume>(jointCount)
+		);
+		p_inverseWorldMatrices = allocator.Allocate<glm::mat4>(jointCount);
+		inverseWorldTransforms.Allocate(jointCount, allocator);
+		p_worldWeightVolumes = allocator.Allocate<JointWeightVolume>(jointCount);
 	}
 
 
 	AnimationPose::AnimationPose() :
-		p_deformationMatrices(nullptr)
+		skinningMode(SkinningMode::LinearBlend),
+		p_deformationMatrices(nullptr),
+		p_dualQuaternions(nullptr),
+		p_scales(nullptr),
+		version(0)
 	{}
 
-	AnimationPose::~AnimationPose()
+	void AnimationPose::Allocate(size_t jointCount)
 	{
-		delete[] p_deformationMatrices;
+		assert(p_deformationMatrices == nullptr && p_dualQuaternions == nullptr && p_scales == nullptr);
+		allocator.Reserve(
+			LinearAllocator::ByteSize<glm::mat4>(jointCount) +
+			LinearAllocator::ByteSize<DualQuaternion>(jointCount) +
+			LinearAllocator::ByteSize<float>(jointCount)
+		);
+		p_deformationMatrices = allocator.Allocate<glm::mat4>(jointCount);
+		p_dualQuaternions = allocator.Allocate<DualQuaternion>(jointCount);
+		p_scales = allocator.Allocate<float>(jointCount);
 	}
 
-	void AnimationPose::Allocate(size_t jointCount)
+	void AnimationPose::MarkChanged()
+	{
+		static std::atomic<uint64_t> nextVersion(1);
+		version = nextVersion++;
+	}
+
+	void AnimationPose::SetJointDeformation(
+		size_t jointIndex, 
+		const Transform& animatedWorldTransform, 
+		const BindPose& bindPose
+	)
 	{
-		assert(p_deformationMatrices == nullptr);
-		p_deformationMatrices = new glm::mat4[jointCount]();
+		if (skinningMode == SkinningMode::DualQuaternion)
+		{
+			// compose the transforms directly instead of going through 4x4 matrices
+			Transform deformation = Multiply(animatedWorldTransform, bindPose.inverseWorldTransforms.Get(jointIndex));
+			p_dualQuaternions[jointIndex] = DualQuaternion(deformation);
+			p_scales[jointIndex] = deformation.scale;
+		}
+		else
+		{
+			p_deformationMatrices[jointIndex] = 
+				animatedWorldTransform.Matrix() * 
+				bindPose.p_inverseWorldMatrices[jointIndex];
+		}
 	}
 
 
+	PoseTarget::PoseTarget(AnimationPose& animationPose) :
+		skinningMode(animationPose.skinningMode),
+		p_deformationMatrices(animationPose.p_deformationMatrices),
+		p_dualQuaternions(animationPose.p_dualQuaternions),
+		p_scales(animationPose.p_scales)
+	{}
+
+	PoseTarget::PoseTarget(
+		SkinningMode _skinningMode,
+		glm::mat4* _p_deformationMatrices,
+		DualQuaternion* _p_dualQuaternions,
+		float* _p_scales
+	) :
+		skinningMode(_skinningMode),
+		p_deformationMatrices(_p_deformationMatrices),
+		p_dualQuaternions(_p_dualQuaternions),
+		p_scales(_p_scales)
+	{}
+
+
 	Keyframe::Keyframe() :
-		timestamp(0.f),
-		p_transformBuffer(nullptr)
+		timestamp(0.f)
 	{}
 
-	Keyframe::~Keyframe()
+	void Keyframe::Allocate(size_t jointCount)
 	{
-		delete[] p_transformBuffer;
+		transforms.Allocate(jointCount);
 	}
 
-	void Keyframe::Allocate(size_t jointCount)
+	void Keyframe::Allocate(size_t jointCount, LinearAllocator& allocator)
+	{
+		transforms.Allocate(jointCount, allocator);
+	}
+
+	// one joint per lane, the rotation is a quaternion
+	struct TransformPacket
 	{
-		assert(p_transformBuffer == nullptr);
-		p_transformBuffer = new Transform[jointCount]();
+		Simd::Vec3Packet position;
+		Simd::Vec3Packet rotationXyz;
+		Simd::FloatPacket rotationW;
+		Simd::FloatPacket scale;
+	};
+
+	TransformPacket LoadTransforms(const TransformChannels& channels, size_t startIndex)
+	{
+		using namespace Simd;
+
+		TransformPacket transforms;
+		transforms.position = Vec3Packet(
+			FloatPacket::Load(channels.p_positions[0] + startIndex),
+			FloatPacket::Load(channels.p_positions[1] + startIndex),
+			FloatPacket::Load(channels.p_positions[2] + startIndex)
+		);
+		transforms.rotationXyz = Vec3Packet(
+			FloatPacket::Load(channels.p_rotations[0] + startIndex),
+			FloatPacket::Load(channels.p_rotations[1] + startIndex),
+			FloatPacket::Load(channels.p_rotations[2] + startIndex)
+		);
+		transforms.rotationW = FloatPacket::Load(channels.p_rotations[3] + startIndex);
+		transforms.scale = FloatPacket::Load(channels.p_scales + startIndex);
+		return transforms;
+	}
+
+	void StoreTransforms(const TransformPacket& transforms, TransformChannels& channels, size_t startIndex)
+	{
+		transforms.position.x.Store(channels.p_positions[0] + startIndex);
+		transforms.position.y.Store(channels.p_positions[1] + startIndex);
+		transforms.position.z.Store(channels.p_positions[2] + startIndex);
+		transforms.rotationXyz.x.Store(channels.p_rotations[0] + startIndex);
+		transforms.rotationXyz.y.Store(channels.p_rotations[1] + startIndex);
+		transforms.rotationXyz.z.Store(channels.p_rotations[2] + startIndex);
+		transforms.rotationW.Store(channels.p_rotations[3] + startIndex);
+		transforms.scale.Store(channels.p_scales + startIndex);
+	}
+
+	// interpolates along the shortest arc, nlerp instead of slerp since the poses are close
+	TransformPacket Nlerp(const TransformPacket& left, const TransformPacket& right, const Simd::FloatPacket& alphas)
+	{
+		using namespace Simd;
+
+		const FloatPacket zero(0.f);
+		const FloatPacket one(1.f);
+
+		MaskPacket flip = zero > Dot(left.rotationXyz, right.rotationXyz) + left.rotationW * right.rotationW;
+		Vec3Packet rightXyz = Select(flip, right.rotationXyz * -one, right.rotationXyz);
+		FloatPacket rightW = Select(flip, -right.rotationW, right.rotationW);
+		Vec3Packet qXyz = left.rotationXyz + (rightXyz - left.rotationXyz) * alphas;
+		FloatPacket qW = left.rotationW + (rightW - left.rotationW) * alphas;
+		FloatPacket invLength = one / Sqrt(Dot(qXyz, qXyz) + qW * qW);
+
+		TransformPacket result;
+		result.rotationXyz = qXyz * invLength;
+		result.rotationW = qW * invLength;
+		result.position = left.position + (right.position - left.position) * alphas;
+		result.scale = left.scale + (right.scale - left.scale) * alphas;
+		return result;
+	}
+
+	// deformation = animated * inverse bind, same as Multiply, written as the 
+	// representation of the skinning mode for the lanes that are joints
+	void WriteDeformations(
+		const TransformPacket& animated,
+		const TransformPacket& bind,
+		size_t startIndex,
+		size_t jointCount,
+		const PoseTarget& poseTarget
+	)
+	{
+		using namespace Simd;
+
+		const FloatPacket two(2.f);
+		const FloatPacket half(0.5f);
+
+		const Vec3Packet& qXyz = animated.rotationXyz;
+		const FloatPacket& qW = animated.rotationW;
+		Vec3Packet scaledBindPosition = bind.position * animated.scale;
+		Vec3Packet t = Cross(qXyz, scaledBindPosition) * two;
+		Vec3Packet position = animated.position + scaledBindPosition + t * qW + Cross(qXyz, t);
+		Vec3Packet rotationXyz = bind.rotationXyz * qW + qXyz * bind.rotationW + Cross(qXyz, bind.rotationXyz);
+		FloatPacket rotationW = qW * bind.rotationW - Dot(qXyz, bind.rotationXyz);
+		FloatPacket scale = animated.scale * bind.scale;
+
+		size_t laneCount = glm::min(jointCount - startIndex, Width);
+
+		if (poseTarget.skinningMode == SkinningMode::DualQuaternion)
+		{
+			// dual = 0.5 * (0, position) * rotation
+			Vec3Packet dualXyz = (position * rotationW + Cross(position, rotationXyz)) * half;
+			FloatPacket dualW = -Dot(position, rotationXyz) * half;
+
+			// stored once and scattered per lane, like the matrix columns below
+			float components[9][Width];
+			rotationXyz.x.Store(components[0]);
+			rotationXyz.y.Store(components[1]);
+			rotationXyz.z.Store(components[2]);
+			rotationW.Store(components[3]);
+			dualXyz.x.Store(components[4]);
+			dualXyz.y.Store(components[5]);
+			dualXyz.z.Store(components[6]);
+			dualW.Store(components[7]);
+			scale.Store(components[8]);
+
+			for (size_t lane = 0; lane < laneCount; lane++)
+			{
+				DualQuaternion& dualQuaternion = poseTarget.p_dualQuaternions[startIndex + lane];
+				dualQuaternion.real = glm::quat(components[3][lane], components[0][lane], components[1][lane], components[2][lane]);
+				dualQuaternion.dual = glm::quat(components[7][lane], components[4][lane], components[5][lane], components[6][lane]);
+				poseTarget.p_scales[startIndex + lane] = components[8][lane];
+			}
+		}
+		else
+		{
+			// the 3x4 affine part of the matrix, same as Transform::Matrix
+			FloatPacket x = rotationXyz.x, y = rotationXyz.y, z = rotationXyz.z, w = rotationW;
+			FloatPacket scale2 = scale * two;
+			FloatPacket xx = x * x * scale2, yy = y * y * scale2, zz = z * z * scale2;
+			FloatPacket xy = x * y * scale2, xz = x * z * scale2, yz = y * z * scale2;
+			FloatPacket wx = w * x * scale2, wy = w * y * scale2, wz = w * z * scale2;
+
+			float columns[12][Width];
+			(scale - yy - zz).Store(columns[0]);
+			(xy + wz).Store(columns[1]);
+			(xz - wy).Store(columns[2]);
+			(xy - wz).Store(columns[3]);
+			(scale - xx - zz).Store(columns[4]);
+			(yz + wx).Store(columns[5]);
+			(xz + wy).Store(columns[6]);
+			(yz - wx).Store(columns[7]);
+			(scale - xx - yy).Store(columns[8]);
+			position.x.Store(columns[9]);
+			position.y.Store(columns[10]);
+			position.z.Store(columns[11]);
+
+			for (size_t lane = 0; lane < laneCount; lane++)
+			{
+				glm::mat4& matrix = poseTarget.p_deformationMatrices[startIndex + lane];
+
+				for (glm::length_t i = 0; i < 4; i++)
+					matrix[i] = glm::vec4(columns[i * 3][lane], columns[i * 3 + 1][lane], columns[i * 3 + 2][lane], i == 3 ? 1.f : 0.f);
+			}
+		}
+	}
+
+	void SamplePose(
+		const Keyframe& leftKeyframe,
+		const Keyframe& rightKeyframe,
+		float alpha,
+		size_t jointCount,
+		const BindPose& bindPose,
+		const PoseTarget& poseTarget
+	)
+	{
+		const Simd::FloatPacket alphas(alpha);
+
+		for (size_t startIndex = 0; startIndex < jointCount; startIndex += Simd::Width)
+		{
+			TransformPacket left = LoadTransforms(leftKeyframe.transforms, startIndex);
+			TransformPacket right = LoadTransforms(rightKeyframe.transforms, startIndex);
+			TransformPacket bind = LoadTransforms(bindPose.inverseWorldTransforms, startIndex);
+			WriteDeformations(Nlerp(left, right, alphas), bind, startIndex, jointCount, poseTarget);
+		}
+	}
+
+	void BlendPose(
+		const Keyframe& leftKeyframe,
+		const Keyframe& rightKeyframe,
+		float alpha,
+		float weight,
+		size_t jointCount,
+		TransformChannels& inoutTransforms
+	)
+	{
+		const Simd::FloatPacket alphas(alpha);
+		const Simd::FloatPacket weights(weight);
+
+		for (size_t startIndex = 0; startIndex < jointCount; startIndex += Simd::Width)
+		{
+			TransformPacket left = LoadTransforms(leftKeyframe.transforms, startIndex);
+			TransformPacket right = LoadTransforms(rightKeyframe.transforms, startIndex);
+			TransformPacket sampled = Nlerp(left, right, alphas);
+
+			// a full weight does not read the transforms, so they do not have to be initialized
+			if (weight < 1.f)
+				sampled = Nlerp(LoadTransforms(inoutTransforms, startIndex), sampled, weights);
+
+			StoreTransforms(sampled, inoutTransforms, startIndex);
+		}
+	}
+
+	void WritePose(
+		const TransformChannels& worldTransforms,
+		size_t jointCount,
+		const BindPose& bindPose,
+		const PoseTarget& poseTarget
+	)
+	{
+		for (size_t startIndex = 0; startIndex < jointCount; startIndex += Simd::Width)
+		{
+			TransformPacket animated = LoadTransforms(worldTransforms, startIndex);
+			TransformPacket bind = LoadTransforms(bindPose.inverseWorldTransforms, startIndex);
+			WriteDeformations(animated, bind, startIndex, jointCount, poseTarget);
+		}
 	}
 
 	Animation::Animation() :
@@ -69,14 +413,87 @@ namespace Engine
 
 	Animation::~Animation()
 	{
-		delete[] p_keyframes;
+		// the allocator frees the memory but does not destroy the keyframes
+		for (size_t i = 0; i < keyframeCount; i++)
+			p_keyframes[i].~Keyframe();
 	}
 
-	void Animation::Allocate(size_t _keyframeCount)
+	void Animation::Allocate(size_t _keyframeCount, size_t jointCount)
 	{
 		assert(p_keyframes == nullptr);
 		keyframeCount = _keyframeCount;
-		p_keyframes = new Keyframe[keyframeCount]();
+		allocator.Reserve(
+			LinearAllocator::ByteSize<Keyframe>(keyframeCount) +
+			TransformChannels::ByteSize(jointCount) * keyframeCount
+		);
+		p_keyframes = allocator.Allocate<Keyframe>(keyframeCount);
+
+		for (size_t i = 0; i < keyframeCount; i++)
+			p_keyframes[i].Allocate(jointCount, allocator);
+	}
+
+	size_t Animation::FindKeyframe(float normalizedTime, size_t cursor) const
+	{
+		assert(keyframeCount >= 2);
+		size_t lastIndex = keyframeCount - 2;
+
+		// forward playback mostly stays in the same interval or moves to the next one
+		for (size_t i = cursor; i <= glm::min(cursor + 1, lastIndex); i++)
+		{
+			if (p_keyframes[i].timestamp <= normalizedTime && (i == lastIndex || normalizedTime < p_keyframes[i + 1].timestamp))
+				return i;
+		}
+
+		// first keyframe after the time among the ones that can end an interval
+		size_t first = 1;
+		size_t last = lastIndex + 1;
+
+		while (first < last)
+		{
+			size_t middle = (first + last) / 2;
+
+			if (p_keyframes[middle].timestamp > normalizedTime)
+				last = middle;
+			else
+				first = middle + 1;
+		}
+
+		return first - 1;
+	}
+
+	float Animation::FindInterval(float normalizedTime, size_t& inoutCursor) const
+	{
+		inoutCursor = FindKeyframe(normalizedTime, inoutCursor);
+		const Keyframe& leftKeyframe = p_keyframes[inoutCursor];
+		const Keyframe& rightKeyframe = p_keyframes[inoutCursor + 1];
+		float alpha = (normalizedTime - leftKeyframe.timestamp) /
+			(rightKeyframe.timestamp - leftKeyframe.timestamp);
+
+		return glm::clamp(alpha, 0.f, 1.f);
+	}
+
+	void Animation::SampleAt(
+		float normalizedTime,
+		size_t jointCount,
+		const BindPose& bindPose,
+		const PoseTarget& poseTarget,
+		size_t& inoutCursor
+	) const
+	{
+		float alpha = FindInterval(normalizedTime, inoutCursor);
+		SamplePose(p_keyframes[inoutCursor], p_keyframes[inoutCursor + 1], alpha, jointCount, bindPose, poseTarget);
+	}
+
+	void Animation::BlendAt(
+		float normalizedTime,
+		size_t jointCount,
+		float weight,
+		TransformChannels& inoutTransforms,
+		size_t& inoutCursor
+	) const
+	{
+		float alpha = FindInterval(normalizedTime, inoutCursor);
+		BlendPose(p_keyframes[inoutCursor], p_keyframes[inoutCursor + 1], alpha, weight, jointCount, inoutTransforms);
 	}
 
 
@@ -95,46 +512,31 @@ namespace Engine
 		loop = _loop;
 	}
 
+	void AnimationPlayer::Seek(float time)
+	{
+		if (loop)
+		{
+			currentTime = std::fmod(time, duration);
+
+			if (currentTime < 0.f)
+				currentTime += duration;
+		}
+		else
+			currentTime = glm::clamp(time, 0.f, duration);
+	}
+
 	void AnimationPlayer::Update(
 		float deltaTime,
 		size_t jointCount,
 		const BindPose& bindPose,
 		const Animation& animation,
-		AnimationPose& animationPose
+		const PoseTarget& poseTarget
 	)
 	{
-		Keyframe& leftKeyframe = animation.p_keyframes[currentKeyframeIndex];
-		Keyframe& rightKeyframe = animation.p_keyframes[currentKeyframeIndex + 1];
-		float normalizedTime = currentTime / duration;
-		float alpha = (normalizedTime - leftKeyframe.timestamp) / 
-			(rightKeyframe.timestamp - leftKeyframe.timestamp);
-
-		for (size_t i = 0; i < jointCount; i++)
-		{
-			animationPose.p_deformationMatrices[i] =
-				Lerp(leftKeyframe.p_transformBuffer[i], rightKeyframe.p_transformBuffer[i], alpha).Matrix() *
-				bindPose.p_inverseWorldMatrices[i];
-		}
+		animation.SampleAt(currentTime / duration, jointCount, bindPose, poseTarget, currentKeyframeIndex);
 
-		currentTime += deltaTime;
-		if (currentTime / duration > rightKeyframe.timestamp)
-		{
-			currentKeyframeIndex++;
-
-			if (currentKeyframeIndex + 1 == animation.keyframeCount)
-			{
-				if (loop)
-				{
-					currentKeyframeIndex = 0;
-					currentTime = 0.f;
-				}
-				else
-				{
-					currentKeyframeIndex--;
-					currentTime = duration;
-				}
-			}
-		}
+		// the next sample finds its keyframe from the time, however many keyframes a long frame skips
+		Seek(currentTime + deltaTime);
 	}
 
 	bool AnimationPlayer::IsDone() const
@@ -143,116 +545,148 @@ namespace Engine
 	}
 
 
-	Joint::Joint() :
-		p_parent(nullptr),
-		childCount(0),
-		p_children(nullptr),
-		eulerAngles(0.f)
+	Skeleton::Skeleton() :
+		parentIndices(1, -1),
+		localTransforms(1),
+		eulerAngles(1, glm::vec3(0.f))
 	{}
 
-	Joint::~Joint()
+	size_t Skeleton::JointCount() const
 	{
-		delete[] p_children;
+		return parentIndices.size();
 	}
 
-	void Joint::Allocate(size_t _childrenCount)
+	size_t Skeleton::SubtreeEnd(size_t jointIndex) const
 	{
-		childCount = _childrenCount;
-
-		if(childCount > 0)
-			p_children = new Joint[childCount]();
-	}
+		// in pre-order the subtree ends at the first joint whose parent comes before the joint
+		size_t end = jointIndex + 1;
 
+		while (end < parentIndices.size() && parentIndices[end] >= (int)jointIndex)
+			end++;
 
-	Skeleton::Skeleton() :
-		jointCount(1)
-	{}
+		return end;
+	}
 
-	void CopyJoints(const Joint& startJoint, Joint& jointCopy)
+	size_t Skeleton::ChildCount(size_t jointIndex) const
 	{
-		jointCopy.localTransform = startJoint.localTransform;
-		jointCopy.Allocate(startJoint.childCount);
-		
-		for (size_t i = 0; i < startJoint.childCount; i++)
+		size_t childCount = 0;
+		size_t end = SubtreeEnd(jointIndex);
+
+		for (size_t i = jointIndex + 1; i < end; i++)
 		{
-			jointCopy.p_children[i].p_parent = &jointCopy;
-			CopyJoints(startJoint.p_children[i], jointCopy.p_children[i]);
+			if (parentIndices[i] == (int)jointIndex)
+				childCount++;
 		}
-	}
 
-	void Skeleton::MakeCopy(Skeleton& copySkeleton) const
-	{
-		copySkeleton.jointCount = jointCount;
-		CopyJoints(root, copySkeleton.root);
+		return childCount;
 	}
 
+	size_t Skeleton::ChildIndex(size_t jointIndex, size_t childNumber) const
+	{
+		size_t end = SubtreeEnd(jointIndex);
 
-	BuildingJoint::BuildingJoint(BuildingSkeleton* _p_skeleton, BuildingJoint* _p_parent) :
-		p_skeleton(_p_skeleton),
-		p_parent(_p_parent),
-		eulerAngles(0.f)
-	{}
+		for (size_t i = jointIndex + 1; i < end; i++)
+		{
+			if (parentIndices[i] == (int)jointIndex && childNumber-- == 0)
+				return i;
+		}
 
-	BuildingJoint::~BuildingJoint()
-	{
-		for (BuildingJoint* p_child : children)
-			delete p_child;
+		assert(false);
+		return jointIndex;
 	}
 
-	void BuildingJoint::AddChild()
+	void Skeleton::CalcWorldTransforms(std::vector<Transform>& outWorldTransforms) const
 	{
-		children.push_back(new BuildingJoint(p_skeleton, this));
-		p_skeleton->jointCount++;
+		outWorldTransforms.resize(parentIndices.size());
+
+		for (size_t i = 0; i < parentIndices.size(); i++)
+		{
+			if (parentIndices[i] == -1)
+				outWorldTransforms[i] = localTransforms[i];
+			else
+				outWorldTransforms[i] = Multiply(outWorldTransforms[parentIndices[i]], localTransforms[i]);
+		}
 	}
 
-	void BuildingJoint::RemoveChild(size_t index)
+	void Skeleton::CalcWorldMatrices(std::vector<glm::mat4>& outWorldMatrices) const
 	{
-		delete children[index];
-		children.erase(children.begin() + index);
-		p_skeleton->jointCount--;
+		outWorldMatrices.resize(parentIndices.size());
+
+		for (size_t i = 0; i < parentIndices.size(); i++)
+		{
+			if (parentIndices[i] == -1)
+				outWorldMatrices[i] = localTransforms[i].Matrix();
+			else
+				outWorldMatrices[i] = outWorldMatrices[parentIndices[i]] * localTransforms[i].Matrix();
+		}
 	}
 
 
 	BuildingSkeleton::BuildingSkeleton() :
-		jointCount(1),
-		root(this, nullptr)
+		weightVolumes(1)
 	{}
 
-	void BuildJoints(const BuildingJoint& startBuildingJoint, Joint* p_parent, Joint& joint)
+	size_t BuildingSkeleton::AddChild(size_t parentIndex)
 	{
-		joint.p_parent = p_parent;
-		joint.localTransform = startBuildingJoint.localTransform;
-		joint.Allocate(startBuildingJoint.children.size());
+		size_t childIndex = skeleton.SubtreeEnd(parentIndex);
+
+		// the joints after the insertion move one step
+		for (int& parent : skeleton.parentIndices)
+		{
+			if (parent >= (int)childIndex)
+				parent++;
+		}
+
+		skeleton.parentIndices.insert(skeleton.parentIndices.begin() + childIndex, (int)parentIndex);
+		skeleton.localTransforms.insert(skeleton.localTransforms.begin() + childIndex, Transform());
+		skeleton.eulerAngles.insert(skeleton.eulerAngles.begin() + childIndex, glm::vec3(0.f));
+		weightVolumes.insert(weightVolumes.begin() + childIndex, JointWeightVolume());
 
-		for (size_t i = 0; i < startBuildingJoint.children.size(); i++)
-			BuildJoints(*startBuildingJoint.children[i], &joint, joint.p_children[i]);
+		return childIndex;
 	}
 
-	void BuildBindPoses(
-		const BuildingJoint& startBuildingJoint,
-		const glm::mat4& parentWorldTransform,
-		BindPose& bindPose,
-		size_t& inoutIndex)
+	void BuildingSkeleton::RemoveJoint(size_t jointIndex)
 	{
-		glm::mat4 worldTransform = parentWorldTransform * startBuildingJoint.localTransform.Matrix();
-		bindPose.p_inverseWorldMatrices[inoutIndex] = glm::inverse(worldTransform);
-		JointWeightVolume& weightVolume = bindPose.p_worldWeightVolumes[inoutIndex];
-		weightVolume.startPoint = glm::vec3(worldTransform * glm::vec4(startBuildingJoint.weightVolume.startPoint, 1.f));
-		weightVolume.startToEnd = glm::vec3(parentWorldTransform * glm::vec4(startBuildingJoint.weightVolume.startToEnd, 0.f));
-		weightVolume.falloffRate = startBuildingJoint.weightVolume.falloffRate;
+		assert(jointIndex > 0);
+		size_t end = skeleton.SubtreeEnd(jointIndex);
+		int removedCount = (int)(end - jointIndex);
 
-		for (size_t i = 0; i < startBuildingJoint.children.size(); i++)
-			BuildBindPoses(*startBuildingJoint.children[i], worldTransform, bindPose, ++inoutIndex);
+		skeleton.parentIndices.erase(skeleton.parentIndices.begin() + jointIndex, skeleton.parentIndices.begin() + end);
+		skeleton.localTransforms.erase(skeleton.localTransforms.begin() + jointIndex, skeleton.localTransforms.begin() + end);
+		skeleton.eulerAngles.erase(skeleton.eulerAngles.begin() + jointIndex, skeleton.eulerAngles.begin() + end);
+		weightVolumes.erase(weightVolumes.begin() + jointIndex, weightVolumes.begin() + end);
+
+		for (int& parent : skeleton.parentIndices)
+		{
+			if (parent >= (int)end)
+				parent -= removedCount;
+		}
 	}
 
-	void BuildingSkeleton::BuildSkeletonAndBindPose(Skeleton& skeleton, BindPose& bindPose) const
+	void BuildingSkeleton::BuildSkeletonAndBindPose(Skeleton& outSkeleton, BindPose& bindPose) const
 	{
-		skeleton.jointCount = jointCount;
-		BuildJoints(root, nullptr, skeleton.root);
+		outSkeleton = skeleton;
+
+		size_t jointCount = skeleton.JointCount();
+		std::vector<glm::mat4> worldMatrices;
+		std::vector<Transform> worldTransforms;
+		skeleton.CalcWorldMatrices(worldMatrices);
+		skeleton.CalcWorldTransforms(worldTransforms);
 
 		bindPose.Allocate(jointCount);
-		size_t index = 0;
-		BuildBindPoses(root, glm::mat4(1.f), bindPose, index);
+
+		for (size_t i = 0; i < jointCount; i++)
+		{
+			int parentIndex = skeleton.parentIndices[i];
+			glm::mat4 parentWorldMatrix = parentIndex == -1 ? glm::mat4(1.f) : worldMatrices[parentIndex];
+
+			bindPose.p_inverseWorldMatrices[i] = glm::inverse(worldMatrices[i]);
+			bindPose.inverseWorldTransforms.Set(i, Inverse(worldTransforms[i]));
+			JointWeightVolume& weightVolume = bindPose.p_worldWeightVolumes[i];
+			weightVolume.startPoint = glm::vec3(worldMatrices[i] * glm::vec4(weightVolumes[i].startPoint, 1.f));
+			weightVolume.startToEnd = glm::vec3(parentWorldMatrix * glm::vec4(weightVolumes[i].startToEnd, 0.f));
+			weightVolume.falloffRate = weightVolumes[i].falloffRate;
+		}
 	}
 
 
@@ -275,17 +709,8 @@ namespace Engine
 		keyframes.push_back(new BuildingKeyframe(0.f));
 		keyframes.push_back(new BuildingKeyframe(1.f));
 
-		skeleton.MakeCopy(keyframes[0]->skeleton);
-		skeleton.MakeCopy(keyframes[1]->skeleton);
-	}
-
-	void InterpolateJoints(const Joint& startLeftJoint, const Joint& startRightJoint, Joint& joint, float alpha)
-	{
-		joint.localTransform = Lerp(startLeftJoint.localTransform, startRightJoint.localTransform, alpha);
-		joint.eulerAngles = glm::eulerAngles(joint.localTransform.rotation);
-
-		for (size_t i = 0; i < joint.childCount; i++)
-			InterpolateJoints(joint.p_children[i], startLeftJoint.p_children[i], startRightJoint.p_children[i], alpha);
+		keyframes[0]->skeleton = skeleton;
+		keyframes[1]->skeleton = skeleton;
 	}
 
 	void BuildingAnimation::AddKeyframe(float timestamp, size_t& outIndex)
@@ -306,18 +731,18 @@ namespace Engine
 			{
 				// interpolate new skeleton between surrounding poses
 				BuildingKeyframe* p_newKeyframe = new BuildingKeyframe(timestamp);
-				keyframes[i - 1]->skeleton.MakeCopy(p_newKeyframe->skeleton);
+				const Skeleton& leftSkeleton = keyframes[i - 1]->skeleton;
+				const Skeleton& rightSkeleton = keyframes[i]->skeleton;
+				Skeleton& skeleton = p_newKeyframe->skeleton;
+				skeleton = leftSkeleton;
 				float alpha = (timestamp - keyframes[i - 1]->timestamp) /
 					(keyframes[i]->timestamp - keyframes[i - 1]->timestamp);
 
-				InterpolateJoints(
-					keyframes[i - 1]->skeleton.root,
-					keyframes[i]->skeleton.root,
-					p_newKeyframe->skeleton.root,
-					alpha
-				);
-
-				//GetSkeletonPose(timestamp, p_newKeyframe->skeleton);
+				for (size_t j = 0; j < skeleton.JointCount(); j++)
+				{
+					skeleton.localTransforms[j] = Lerp(leftSkeleton.localTransforms[j], rightSkeleton.localTransforms[j], alpha);
+					skeleton.eulerAngles[j] = glm::eulerAngles(skeleton.localTransforms[j].rotation);
+				}
 
 				keyframes.insert(keyframes.begin() + i, p_newKeyframe);
 				outIndex = i;
@@ -335,40 +760,6 @@ namespace Engine
 		keyframes.erase(keyframes.begin() + index);
 	}
 
-	void InterpolateAnimationPoses(
-		const Joint& startLeftJoint, 
-		const Joint& startRightJoint, 
-		const Transform& leftParentTransform,
-		const Transform& rightParentTransform,
-		const BindPose& bindPose, 
-		AnimationPose& animationPose,
-		size_t& inoutIndex,
-		float alpha)
-	{
-		Transform leftWorldTransform = Multiply(leftParentTransform, startLeftJoint.localTransform);
-		Transform rightWorldTransform = Multiply(rightParentTransform, startRightJoint.localTransform);
-
-		animationPose.p_deformationMatrices[inoutIndex] = Lerp(
-			leftWorldTransform,
-			rightWorldTransform,
-			alpha
-		).Matrix() * bindPose.p_inverseWorldMatrices[inoutIndex];
-
-		for (size_t i = 0; i < startLeftJoint.childCount; i++)
-		{
-			InterpolateAnimationPoses(
-				startLeftJoint.p_children[i],
-				startRightJoint.p_children[i],
-				leftWorldTransform,
-				rightWorldTransform,
-				bindPose,
-				animationPose,
-				++inoutIndex,
-				alpha
-			);
-		}
-	}
-
 	void BuildingAnimation::GetAnimationPose(
 		float time, 
 		const BindPose& bindPose, 
@@ -379,46 +770,34 @@ namespace Engine
 		{
 			if (keyframes[i]->timestamp >= time)
 			{
-				size_t index = 0;
 				float alpha = (time - keyframes[i - 1]->timestamp) /
 					(keyframes[i]->timestamp - keyframes[i - 1]->timestamp);
 
-				InterpolateAnimationPoses(
-					keyframes[i - 1]->skeleton.root,
-					keyframes[i]->skeleton.root,
-					Transform(),
-					Transform(),
-					bindPose,
-					animationPose,
-					index,
-					alpha	
-				);
-				break;
-			}
-		}
-	}
+				std::vector<Transform> leftWorldTransforms;
+				std::vector<Transform> rightWorldTransforms;
+				keyframes[i - 1]->skeleton.CalcWorldTransforms(leftWorldTransforms);
+				keyframes[i]->skeleton.CalcWorldTransforms(rightWorldTransforms);
 
-	void BuildKeyframe(const Joint& startJoint, const Transform& parentWorldTransform, Keyframe& keyframe, size_t& inoutKeyframeIndex)
-	{
-		Transform worldTransform = Multiply(parentWorldTransform, startJoint.localTransform);
-		keyframe.p_transformBuffer[inoutKeyframeIndex] = worldTransform;
+				for (size_t j = 0; j < leftWorldTransforms.size(); j++)
+					animationPose.SetJointDeformation(j, Lerp(leftWorldTransforms[j], rightWorldTransforms[j], alpha), bindPose);
 
-		for (size_t i = 0; i < startJoint.childCount; i++)
-		{
-			BuildKeyframe(startJoint.p_children[i], worldTransform, keyframe, ++inoutKeyframeIndex);
+				break;
+			}
 		}
 	}
 
 	void BuildingAnimation::BuildAnimation(Animation& animation) const
 	{
-		animation.Allocate(keyframes.size());
+		animation.Allocate(keyframes.size(), keyframes[0]->skeleton.JointCount());
+		std::vector<Transform> worldTransforms;
 
 		for (size_t i = 0; i < keyframes.size(); i++)
 		{
+			keyframes[i]->skeleton.CalcWorldTransforms(worldTransforms);
 			animation.p_keyframes[i].timestamp = keyframes[i]->timestamp;
-			animation.p_keyframes[i].Allocate(keyframes[i]->skeleton.jointCount);
-			size_t index = 0;
-			BuildKeyframe(keyframes[i]->skeleton.root, Transform(), animation.p_keyframes[i], index);
+
+			for (size_t j = 0; j < worldTransforms.size(); j++)
+				animation.p_keyframes[i].transforms.Set(j, worldTransforms[j]);
 		}
 	}
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
 #include "transform.h"
+#include "linear_allocator.h"
 #include <vector>
+#include <cstdint>
 
 namespace Engine
 {
@@ -14,57 +16,165 @@ namespace Engine
 		JointWeightVolume();
 	};
 
+	// transforms stored as structure of arrays, one float stream per component, so that 
+	// a packet of joints is read with one load per component. the streams are padded with 
+	// identity transforms to a multiple of the simd width
+	struct TransformChannels
+	{
+		float* p_data;// all streams in one allocation
+		float* p_positions[3];
+		float* p_rotations[4];// x, y, z, w
+		float* p_scales;
+		bool ownsData;// false when the streams live in an allocator
+
+		TransformChannels();
+		~TransformChannels();
+
+		static size_t ByteSize(size_t count);
+		void Allocate(size_t count);
+		void Allocate(size_t count, LinearAllocator& allocator);
+		Transform Get(size_t index) const;
+		void Set(size_t index, const Transform& transform);
+	};
+
 	// derived data generated when posing the skeleton in a bind pose
 	struct BindPose
 	{
+		LinearAllocator allocator;// all the arrays below in one block
 		glm::mat4* p_inverseWorldMatrices;
+		TransformChannels inverseWorldTransforms;// same as the matrices, used when sampling poses
 		JointWeightVolume* p_worldWeightVolumes;
 
 		BindPose();
-		~BindPose();
 
 		void Allocate(size_t jointCount);
 	};
 
+	enum class SkinningMode
+	{
+		LinearBlend,
+		DualQuaternion
+	};
+
 	// derived data generated when interpolating between keyframes in an animation
 	struct AnimationPose
 	{
+		// decides which of the deformation representations below are written
+		SkinningMode skinningMode;
+		LinearAllocator allocator;// all the arrays below in one block
 		glm::mat4* p_deformationMatrices;// = jointAnimatedWorldMatrix * jointBindInverseWorldMatrix
+		DualQuaternion* p_dualQuaternions;// rigid part of jointAnimatedWorldTransform * jointBindInverseWorldTransform
+		float* p_scales;// uniform scale part of jointAnimatedWorldTransform * jointBindInverseWorldTransform
+		// unique over all poses and changed by whoever rewrites the pose, so that consumers 
+		// can skip work for a pose they have already seen. 0 before the first write
+		uint64_t version;
 
 		AnimationPose();
-		~AnimationPose();
 
 		void Allocate(size_t jointCount);
+		void MarkChanged();
+		void SetJointDeformation(size_t jointIndex, const Transform& animatedWorldTransform, const BindPose& bindPose);
+	};
+
+	// where a sampled pose is written, the arrays of an AnimationPose or 
+	// the range of one pose in buffers shared by many poses
+	struct PoseTarget
+	{
+		SkinningMode skinningMode;
+		glm::mat4* p_deformationMatrices;
+		DualQuaternion* p_dualQuaternions;
+		float* p_scales;
+
+		PoseTarget(AnimationPose& animationPose);
+		PoseTarget(
+			SkinningMode _skinningMode,
+			glm::mat4* _p_deformationMatrices,
+			DualQuaternion* _p_dualQuaternions,
+			float* _p_scales
+		);
 	};
 
 	// collection of joint world transforms describing an animation pose
 	struct Keyframe
 	{
 		float timestamp;
-		Transform* p_transformBuffer;
+		TransformChannels transforms;
 
 		Keyframe();
-		~Keyframe();
 
 		void Allocate(size_t jointCount);
+		void Allocate(size_t jointCount, LinearAllocator& allocator);
 	};
 
+	// interpolates the joints between two keyframes (nlerp for the rotations) and writes their 
+	// deformations, a packet of joints at a time
+	void SamplePose(
+		const Keyframe& leftKeyframe,
+		const Keyframe& rightKeyframe,
+		float alpha,
+		size_t jointCount,
+		const BindPose& bindPose,
+		const PoseTarget& poseTarget
+	);
+	// interpolates the joint world transforms between two keyframes like SamplePose and blends them 
+	// over the transforms by the weight, a weight of 1 replaces them. used for layering clips, so 
+	// that the deformations are only written once for the blended result
+	void BlendPose(
+		const Keyframe& leftKeyframe,
+		const Keyframe& rightKeyframe,
+		float alpha,
+		float weight,
+		size_t jointCount,
+		TransformChannels& inoutTransforms
+	);
+	// writes the deformations of joint world transforms
+	void WritePose(
+		const TransformChannels& worldTransforms,
+		size_t jointCount,
+		const BindPose& bindPose,
+		const PoseTarget& poseTarget
+	);
+
 	// collection of keyframes used for interpolating an animation pose over time
 	struct Animation
 	{
+		LinearAllocator allocator;// the keyframes and their transforms back to back in one block
 		size_t keyframeCount;
 		Keyframe* p_keyframes;
 
 		Animation();
 		~Animation();
 
-		void Allocate(size_t _keyframeCount);
+		// allocates the keyframes with their transforms
+		void Allocate(size_t _keyframeCount, size_t jointCount);
+		// index of the keyframe starting the interval containing the time, checks the interval 
+		// of the cursor and the one after it before falling back to a binary search
+		size_t FindKeyframe(float normalizedTime, size_t cursor) const;
+		// moves the cursor to the interval containing the time and returns the alpha within it
+		float FindInterval(float normalizedTime, size_t& inoutCursor) const;
+		// samples the pose at any time without player state, so it can be driven by an external 
+		// clock from any thread. the cursor is the keyframe index of the previous sample
+		void SampleAt(
+			float normalizedTime,
+			size_t jointCount,
+			const BindPose& bindPose,
+			const PoseTarget& poseTarget,
+			size_t& inoutCursor
+		) const;
+		// same as SampleAt but blends the world transforms with BlendPose
+		void BlendAt(
+			float normalizedTime,
+			size_t jointCount,
+			float weight,
+			TransformChannels& inoutTransforms,
+			size_t& inoutCursor
+		) const;
 	};
 
 	// manages animation duration, looping, keyframe selection and interpolation
 	struct AnimationPlayer
 	{
-		size_t currentKeyframeIndex;
+		size_t currentKeyframeIndex;// cursor of the last sample
 		float currentTime;
 		float duration;
 		bool loop;
@@ -72,70 +182,51 @@ namespace Engine
 		AnimationPlayer();
 
 		void Start(float _duration, bool _loop);
+		// jumps to a time, wrapped when looping and clamped otherwise
+		void Seek(float time);
 		void Update(
 			float deltaTime,
 			size_t jointCount, 
 			const BindPose& bindPose, 
 			const Animation& animation, 
-			AnimationPose& animationPose
+			const PoseTarget& poseTarget
 		);
 		bool IsDone() const;
 	};
 
-	// streamlined representation of joint used when generating keyframes
-	struct Joint
-	{
-		Joint* p_parent;
-		size_t childCount;
-		Joint* p_children;
-		Transform localTransform;
-		glm::vec3 eulerAngles;
-
-		Joint();
-		~Joint();
-
-		void Allocate(size_t _childrenCount);
-	};
-
-	// streamlined representation of skeleton used when generating keyframes
+	// skeleton stored flat with the joints in pre-order, so that a parent always comes before its 
+	// children and the subtree of a joint is the contiguous range starting at it
 	struct Skeleton
 	{
-		size_t jointCount;
-		Joint root;
+		std::vector<int> parentIndices;// -1 for the root
+		std::vector<Transform> localTransforms;
+		std::vector<glm::vec3> eulerAngles;
 
+		// starts with the root joint
 		Skeleton();
 
-		void MakeCopy(Skeleton& copySkeleton) const;
+		size_t JointCount() const;
+		size_t SubtreeEnd(size_t jointIndex) const;
+		size_t ChildCount(size_t jointIndex) const;
+		size_t ChildIndex(size_t jointIndex, size_t childNumber) const;
+		// forward kinematics in a single loop, every parent is done before its children
+		void CalcWorldTransforms(std::vector<Transform>& outWorldTransforms) const;
+		void CalcWorldMatrices(std::vector<glm::mat4>& outWorldMatrices) const;
 	};
 
-	struct BuildingSkeleton;
-
-	// joint representation used when building a skeleton and a bind pose
-	struct BuildingJoint
-	{
-		BuildingSkeleton* p_skeleton;
-		BuildingJoint* p_parent;
-		std::vector<BuildingJoint*> children;
-		Transform localTransform;
-		glm::vec3 eulerAngles;
-		JointWeightVolume weightVolume;
-
-		BuildingJoint(BuildingSkeleton* _p_skeleton, BuildingJoint* _p_parent);
-		~BuildingJoint();
-
-		void AddChild();
-		void RemoveChild(size_t index);
-	};
-
-	// used for building a streamlined skeleton and a bind pose
+	// used for building a skeleton and a bind pose
 	struct BuildingSkeleton
 	{
-		size_t jointCount;
-		BuildingJoint root;
+		Skeleton skeleton;
+		std::vector<JointWeightVolume> weightVolumes;// local to the joints
 
 		BuildingSkeleton();
 
-		void BuildSkeletonAndBindPose(Skeleton& skeleton, BindPose& bindPose) const;
+		// inserts the child after the subtree of the parent, which keeps the pre-order, and returns its index
+		size_t AddChild(size_t parentIndex);
+		// removes the joint with its subtree
+		void RemoveJoint(size_t jointIndex);
+		void BuildSkeletonAndBindPose(Skeleton& outSkeleton, BindPose& bindPose) const;
 	};
 	
 	// stores skeleton pose used when building keyframes
@@ -0,0 +1,143 @@
+#include "animation_layers.h"
+#include <cassert>
+
+namespace Engine
+{
+	AnimationLayerStack::AnimationLayerStack() :
+		jointCount(0),
+		activeLayerCount(0)
+	{}
+
+	void AnimationLayerStack::Init(size_t _jointCount)
+	{
+		jointCount = _jointCount;
+		blendedTransforms.Allocate(jointCount);
+	}
+
+	size_t AnimationLayerStack::AddLayer(
+		const Animation& animation,
+		float duration,
+		bool loop,
+		float startTime,
+		float weight
+	)
+	{
+		Layer layer;
+		layer.p_animation = &animation;
+		layer.player.Start(duration, loop);
+		layer.player.Seek(startTime);
+		layer.weight = weight;
+		layer.targetWeight = weight;
+		layer.fadeRate = 0.f;
+		layer.replacesLayersBelow = false;
+		layers.push_back(layer);
+
+		return layers.size() - 1;
+	}
+
+	void AnimationLayerStack::FadeLayer(size_t layerIndex, float weight, float fadeDuration)
+	{
+		Layer& layer = layers[layerIndex];
+		layer.targetWeight = weight;
+
+		if (fadeDuration > 0.f)
+			layer.fadeRate = glm::abs(weight - layer.weight) / fadeDuration;
+		else
+			layer.weight = weight;
+	}
+
+	void AnimationLayerStack::CrossFade(const Animation& animation, float duration, bool loop, float fadeDuration)
+	{
+		size_t layerIndex = AddLayer(animation, duration, loop, 0.f, 0.f);
+		FadeLayer(layerIndex, 1.f, fadeDuration);
+		layers[layerIndex].replacesLayersBelow = true;
+	}
+
+	void AnimationLayerStack::Clear()
+	{
+		layers.clear();
+		activeLayerCount = 0;
+	}
+
+	void AnimationLayerStack::Evaluate(const BindPose& bindPose, const PoseTarget& poseTarget)
+	{
+		assert(blendedTransforms.p_data != nullptr);
+
+		// the layers below the top one of full weight are covered
+		size_t firstLayer = 0;
+
+		for (size_t i = 0; i < layers.size(); i++)
+		{
+			if (layers[i].weight >= 1.f)
+				firstLayer = i;
+		}
+
+		activeLayerCount = 0;
+
+		for (size_t i = firstLayer; i < layers.size(); i++)
+		{
+			Layer& layer = layers[i];
+
+			if (layer.weight <= 0.f)
+				continue;
+
+			float weight = activeLayerCount == 0 ? 1.f : layer.weight;
+			AnimationPlayer& player = layer.player;
+			layer.p_animation->BlendAt(player.currentTime / player.duration, jointCount, weight, blendedTransforms, player.currentKeyframeIndex);
+			activeLayerCount++;
+		}
+
+		if (activeLayerCount > 0)
+			WritePose(blendedTransforms, jointCount, bindPose, poseTarget);
+	}
+
+	bool AnimationLayerStack::Advance(float deltaTime)
+	{
+		bool changed = false;
+
+		for (Layer& layer : layers)
+		{
+			float previousTime = layer.player.currentTime;
+			float previousWeight = layer.weight;
+			layer.player.Seek(layer.player.currentTime + deltaTime);
+
+			float maxStep = layer.fadeRate * deltaTime;
+			layer.weight += glm::clamp(layer.targetWeight - layer.weight, -maxStep, maxStep);
+			changed |= layer.player.currentTime != previousTime || layer.weight != previousWeight;
+		}
+
+		// a finished cross fade removes the layers it replaced
+		for (size_t i = layers.size(); i-- > 1;)
+		{
+			if (layers[i].replacesLayersBelow && layers[i].weight >= 1.f)
+			{
+				layers[i].replacesLayersBelow = false;
+				layers.erase(layers.begin(), layers.begin() + i);
+				break;
+			}
+		}
+
+		return changed;
+	}
+
+	void AnimationLayerStack::Update(float deltaTime, const BindPose& bindPose, const PoseTarget& poseTarget)
+	{
+		Evaluate(bindPose, poseTarget);
+		Advance(deltaTime);
+	}
+
+	size_t AnimationLayerStack::JointCount() const
+	{
+		return jointCount;
+	}
+
+	size_t AnimationLayerStack::LayerCount() const
+	{
+		return layers.size();
+	}
+
+	size_t AnimationLayerStack::ActiveLayerCount() const
+	{
+		return activeLayerCount;
+	}
+}
\ No newline at end of file
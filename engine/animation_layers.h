@@ -0,0 +1,52 @@
+#pragma once
+#include "animation.h"
+#include <vector>
+
+namespace Engine
+{
+	// clips of one skeleton played on top of each other. every layer blends its joint world transforms 
+	// over the layers below by its weight and the deformations are written once for the result. the 
+	// blend buffer is allocated once for the joint count, so updates do not allocate
+	class AnimationLayerStack final
+	{
+	private:
+		struct Layer
+		{
+			const Animation* p_animation;
+			AnimationPlayer player;
+			float weight;
+			float targetWeight;
+			float fadeRate;// weight change per second
+			bool replacesLayersBelow;// set by cross fades, the layers below are removed once it is fully in
+		};
+
+		size_t jointCount;
+		std::vector<Layer> layers;// bottom first
+		TransformChannels blendedTransforms;
+		size_t activeLayerCount;
+
+	public:
+		AnimationLayerStack();
+
+		void Init(size_t _jointCount);
+		// the clip has to be of the same skeleton and outlive the layer
+		size_t AddLayer(const Animation& animation, float duration, bool loop, float startTime, float weight);
+		// moves the weight of the layer linearly towards the target, instantly for a duration of 0
+		void FadeLayer(size_t layerIndex, float weight, float fadeDuration);
+		// plays the clip on a new top layer faded in over the duration, which shifts 
+		// the layer indices when the layers below it are removed
+		void CrossFade(const Animation& animation, float duration, bool loop, float fadeDuration);
+		void Clear();
+		// layers below one of full weight and layers of zero weight are not sampled, 
+		// the lowest sampled layer is used at full weight
+		void Evaluate(const BindPose& bindPose, const PoseTarget& poseTarget);
+		// moves the players and weights, returns false if nothing changed so the pose can be kept
+		bool Advance(float deltaTime);
+		void Update(float deltaTime, const BindPose& bindPose, const PoseTarget& poseTarget);
+
+		size_t JointCount() const;
+		size_t LayerCount() const;
+		// layers sampled by the last update
+		size_t ActiveLayerCount() const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include "animation_system.h"
+
+namespace Engine
+{
+	// an instance takes around a microsecond, so the pool's queues get batches of them
+	const size_t InstancesPerTask = 16;
+
+	AnimationSystem::AnimationSystem(ThreadPool& _threadPool) :
+		threadPool(_threadPool),
+		skinningMode(SkinningMode::LinearBlend)
+	{}
+
+	size_t AnimationSystem::AddInstance(
+		const Animation& animation,
+		const BindPose& bindPose,
+		size_t jointCount,
+		float duration,
+		bool loop,
+		float startTime
+	)
+	{
+		Instance instance;
+		instance.p_animation = &animation;
+		instance.p_bindPose = &bindPose;
+		instance.jointCount = jointCount;
+		instance.bakedPoses = nullptr;
+		instance.firstJoint = deformationMatrices.size();
+		instance.player.Start(duration, loop);
+		instance.player.Seek(startTime);
+		instances.push_back(instance);
+
+		deformationMatrices.resize(instance.firstJoint + jointCount, glm::mat4(1.f));
+		dualQuaternions.resize(instance.firstJoint + jointCount);
+		scales.resize(instance.firstJoint + jointCount, 1.f);
+
+		return instances.size() - 1;
+	}
+
+	size_t AnimationSystem::AddBakedInstance(
+		const std::shared_ptr<const BakedPoseCache>& bakedPoses,
+		size_t jointCount,
+		float duration,
+		bool loop,
+		float startTime
+	)
+	{
+		Instance instance;
+		instance.p_animation = nullptr;
+		instance.p_bindPose = nullptr;
+		instance.jointCount = jointCount;
+		instance.firstJoint = deformationMatrices.size();
+		instance.player.Start(duration, loop);
+		instance.player.Seek(startTime);
+		instance.bakedPoses = bakedPoses;
+		instances.push_back(instance);
+
+		deformationMatrices.resize(instance.firstJoint + jointCount, glm::mat4(1.f));
+		dualQuaternions.resize(instance.firstJoint + jointCount);
+		scales.resize(instance.firstJoint + jointCount, 1.f);
+
+		return instances.size() - 1;
+	}
+
+	void AnimationSystem::Clear()
+	{
+		instances.clear();
+		deformationMatrices.clear();
+		dualQuaternions.clear();
+		scales.clear();
+	}
+
+	void AnimationSystem::SetSkinningMode(SkinningMode _skinningMode)
+	{
+		skinningMode = _skinningMode;
+	}
+
+	void AnimationSystem::Update(float deltaTime)
+	{
+		size_t taskCount = (instances.size() + InstancesPerTask - 1) / InstancesPerTask;
+
+		threadPool.ParallelFor(taskCount, [&](size_t taskIndex, size_t)
+		{
+			size_t endIndex = glm::min((taskIndex + 1) * InstancesPerTask, instances.size());
+
+			for (size_t i = taskIndex * InstancesPerTask; i < endIndex; i++)
+			{
+				Instance& instance = instances[i];
+				PoseTarget poseTarget(
+					skinningMode,
+					&deformationMatrices[instance.firstJoint],
+					&dualQuaternions[instance.firstJoint],
+					&scales[instance.firstJoint]
+				);
+
+				if (instance.bakedPoses != nullptr)
+				{
+					AnimationPlayer& player = instance.player;
+					instance.bakedPoses->SampleAt(player.currentTime / player.duration, poseTarget);
+					player.Seek(player.currentTime + deltaTime);
+				}
+				else
+					instance.player.Update(deltaTime, instance.jointCount, *instance.p_bindPose, *instance.p_animation, poseTarget);
+			}
+		});
+	}
+
+	size_t AnimationSystem::InstanceCount() const
+	{
+		return instances.size();
+	}
+
+	size_t AnimationSystem::JointCount() const
+	{
+		return deformationMatrices.size();
+	}
+
+	size_t AnimationSystem::FirstJoint(size_t instanceIndex) const
+	{
+		return instances[instanceIndex].firstJoint;
+	}
+
+	AnimationPlayer& AnimationSystem::Player(size_t instanceIndex)
+	{
+		return instances[instanceIndex].player;
+	}
+
+	const glm::mat4* AnimationSystem::DeformationMatrices() const
+	{
+		return deformationMatrices.data();
+	}
+
+	const DualQuaternion* AnimationSystem::DualQuaternions() const
+	{
+		return dualQuaternions.data();
+	}
+
+	const float* AnimationSystem::Scales() const
+	{
+		return scales.data();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+#include "animation.h"
+#include "baked_pose_cache.h"
+#include "thread_pool.h"
+#include <vector>
+#include <memory>
+
+namespace Engine
+{
+	// owns the players of many animation instances and updates them in parallel, writing the poses 
+	// of all instances into shared contiguous buffers that can be uploaded to the gpu at once
+	class AnimationSystem final
+	{
+	private:
+		struct Instance
+		{
+			const Animation* p_animation;
+			const BindPose* p_bindPose;
+			size_t jointCount;
+			size_t firstJoint;// offset of the pose in the shared buffers
+			AnimationPlayer player;
+			std::shared_ptr<const BakedPoseCache> bakedPoses;// played instead of the animation when set
+		};
+
+		ThreadPool& threadPool;
+		SkinningMode skinningMode;
+		std::vector<Instance> instances;
+		std::vector<glm::mat4> deformationMatrices;
+		std::vector<DualQuaternion> dualQuaternions;
+		std::vector<float> scales;
+
+	public:
+		AnimationSystem(ThreadPool& _threadPool);
+
+		// the animation and bind pose have to outlive the instance, returns the index of the instance
+		size_t AddInstance(
+			const Animation& animation,
+			const BindPose& bindPose,
+			size_t jointCount,
+			float duration,
+			bool loop,
+			float startTime
+		);
+		// plays the baked poses, which have to use the skinning mode of the system
+		size_t AddBakedInstance(
+			const std::shared_ptr<const BakedPoseCache>& bakedPoses,
+			size_t jointCount,
+			float duration,
+			bool loop,
+			float startTime
+		);
+		void Clear();
+		void SetSkinningMode(SkinningMode _skinningMode);
+		// samples every instance at its current time and advances it, batches of instances 
+		// are spread over the threads of the pool
+		void Update(float deltaTime);
+
+		size_t InstanceCount() const;
+		size_t JointCount() const;// of all instances
+		size_t FirstJoint(size_t instanceIndex) const;
+		AnimationPlayer& Player(size_t instanceIndex);
+		// the joints of instance i start at FirstJoint(i), only the buffers of the skinning mode are written
+		const glm::mat4* DeformationMatrices() const;
+		const DualQuaternion* DualQuaternions() const;
+		const float* Scales() const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "baked_pose_cache.h"
+#include "simd.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace Engine
+{
+	BakedPoseCache::BakedPoseCache() :
+		skinningMode(SkinningMode::LinearBlend),
+		interpolate(true),
+		jointCount(0),
+		poseCount(0)
+	{}
+
+	void BakedPoseCache::Bake(
+		const Animation& animation,
+		size_t _jointCount,
+		const BindPose& bindPose,
+		SkinningMode _skinningMode,
+		size_t _poseCount,
+		bool _interpolate
+	)
+	{
+		assert(_poseCount >= 2);
+		skinningMode = _skinningMode;
+		interpolate = _interpolate;
+		jointCount = _jointCount;
+		poseCount = _poseCount;
+
+		deformationMatrices.clear();
+		dualQuaternions.clear();
+		scales.clear();
+
+		if (skinningMode == SkinningMode::DualQuaternion)
+		{
+			dualQuaternions.resize(poseCount * jointCount);
+			scales.resize(poseCount * jointCount);
+		}
+		else
+			deformationMatrices.resize(poseCount * jointCount);
+
+		size_t cursor = 0;
+
+		for (size_t i = 0; i < poseCount; i++)
+		{
+			size_t first = i * jointCount;
+			PoseTarget poseTarget(
+				skinningMode,
+				deformationMatrices.empty() ? nullptr : &deformationMatrices[first],
+				dualQuaternions.empty() ? nullptr : &dualQuaternions[first],
+				scales.empty() ? nullptr : &scales[first]
+			);
+
+			animation.SampleAt((float)i / (float)(poseCount - 1), jointCount, bindPose, poseTarget, cursor);
+		}
+	}
+
+	void BakedPoseCache::SampleAt(float normalizedTime, const PoseTarget& poseTarget) const
+	{
+		assert(poseTarget.skinningMode == skinningMode && poseCount >= 2);
+
+		float posePosition = glm::clamp(normalizedTime, 0.f, 1.f) * (float)(poseCount - 1);
+
+		if (!interpolate)
+		{
+			size_t first = (size_t)(posePosition + 0.5f) * jointCount;
+
+			if (skinningMode == SkinningMode::DualQuaternion)
+			{
+				std::copy(&dualQuaternions[first], &dualQuaternions[first] + jointCount, poseTarget.p_dualQuaternions);
+				std::copy(&scales[first], &scales[first] + jointCount, poseTarget.p_scales);
+			}
+			else
+				std::copy(&deformationMatrices[first], &deformationMatrices[first] + jointCount, poseTarget.p_deformationMatrices);
+
+			return;
+		}
+
+		size_t pose = glm::min((size_t)posePosition, poseCount - 2);
+		float alpha = posePosition - (float)pose;
+		size_t first = pose * jointCount;
+		size_t second = first + jointCount;
+
+		if (skinningMode == SkinningMode::DualQuaternion)
+		{
+			for (size_t i = 0; i < jointCount; i++)
+			{
+				const DualQuaternion& q1 = dualQuaternions[first + i];
+				const DualQuaternion& q2 = dualQuaternions[second + i];
+
+				// blend along the shortest arc and renormalize, like dual quaternion skinning does
+				float q2Weight = std::copysign(alpha, glm::dot(q1.real, q2.real));
+				glm::quat real = q1.real * (1.f - alpha) + q2.real * q2Weight;
+				glm::quat dual = q1.dual * (1.f - alpha) + q2.dual * q2Weight;
+				float invLength = 1.f / glm::length(real);
+
+				DualQuaternion& target = poseTarget.p_dualQuaternions[i];
+				target.real = real * invLength;
+				target.dual = dual * invLength;
+				poseTarget.p_scales[i] = glm::mix(scales[first + i], scales[second + i], alpha);
+			}
+		}
+		else
+		{
+			// the blend of two close affine matrices, not exactly rigid but within the error of the bake rate.
+			// the poses are contiguous, and a matrix is a whole number of packets, so the blend is one flat loop
+			const float* p_first = &deformationMatrices[first][0][0];
+			const float* p_second = &deformationMatrices[second][0][0];
+			float* p_target = &poseTarget.p_deformationMatrices[0][0][0];
+			Simd::FloatPacket alphaPacket(alpha);
+
+			for (size_t i = 0; i < jointCount * 16; i += Simd::Width)
+			{
+				Simd::FloatPacket firstPacket = Simd::FloatPacket::Load(p_first + i);
+				Simd::FloatPacket secondPacket = Simd::FloatPacket::Load(p_second + i);
+				(firstPacket + (secondPacket - firstPacket) * alphaPacket).Store(p_target + i);
+			}
+		}
+	}
+
+	SkinningMode BakedPoseCache::GetSkinningMode() const
+	{
+		return skinningMode;
+	}
+
+	size_t BakedPoseCache::PoseCount() const
+	{
+		return poseCount;
+	}
+
+	size_t BakedPoseCache::ByteSize() const
+	{
+		return
+			sizeof(BakedPoseCache) +
+			deformationMatrices.size() * sizeof(glm::mat4) +
+			dualQuaternions.size() * sizeof(DualQuaternion) +
+			scales.size() * sizeof(float);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+#include "animation.h"
+#include <vector>
+
+namespace Engine
+{
+	// final deformations of an animation sampled at a fixed rate into one table, so that playback only 
+	// blends the two baked poses around the time or copies the nearest one. it is immutable after baking 
+	// and can be shared between every instance of the clip
+	class BakedPoseCache final
+	{
+	private:
+		SkinningMode skinningMode;
+		bool interpolate;
+		size_t jointCount;
+		size_t poseCount;
+		// pose i is the range [i * jointCount, (i + 1) * jointCount), only the arrays of the skinning mode are used
+		std::vector<glm::mat4> deformationMatrices;
+		std::vector<DualQuaternion> dualQuaternions;
+		std::vector<float> scales;
+
+	public:
+		BakedPoseCache();
+
+		// the poses are evenly spaced over the animation, the first at its start and the last at its end
+		void Bake(
+			const Animation& animation,
+			size_t _jointCount,
+			const BindPose& bindPose,
+			SkinningMode _skinningMode,
+			size_t _poseCount,
+			bool _interpolate
+		);
+		// the target has to use the skinning mode of the bake
+		void SampleAt(float normalizedTime, const PoseTarget& poseTarget) const;
+
+		SkinningMode GetSkinningMode() const;
+		size_t PoseCount() const;
+		size_t ByteSize() const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,267 @@
+#include "cage_bvh.h"
+#include <glm.hpp>
+#include <algorithm>
+#include <cfloat>
+
+namespace Engine
+{
+	// triangles per leaf before it is split
+	const uint32_t MaxLeafTriangles = 4;
+	// nodes and vertices per parallel task of a refit
+	const size_t RefitChunkSize = 256;
+
+	CageBvh::CageBvh()
+	{}
+
+	void CageBvh::Build(const std::vector<glm::vec3>& _undeformedPositions, const std::vector<GLuint>& _indices)
+	{
+		undeformedPositions = _undeformedPositions;
+		deformedPositions = _undeformedPositions;
+		indices = _indices;
+		nodes.clear();
+		levelStarts.clear();
+
+		size_t triangleCount = indices.size() / 3;
+		triangleOrder.resize(triangleCount);
+		std::vector<glm::vec3> centroids(triangleCount);
+
+		for (size_t i = 0; i < triangleCount; i++)
+		{
+			triangleOrder[i] = (uint32_t)i;
+			centroids[i] = (undeformedPositions[indices[i * 3]] + undeformedPositions[indices[i * 3 + 1]] + undeformedPositions[indices[i * 3 + 2]]) / 3.f;
+		}
+
+		if (triangleCount == 0)
+			return;
+
+		// split at the median centroid along the longest axis, the nodes are added a level at a time 
+		// so that the refit can process each level in parallel
+		Node root;
+		root.start = 0;
+		root.count = (uint32_t)triangleCount;
+		nodes.push_back(root);
+		levelStarts.push_back(0);
+
+		size_t levelStart = 0;
+		while (levelStart < nodes.size())
+		{
+			size_t levelEnd = nodes.size();
+
+			for (size_t nodeIndex = levelStart; nodeIndex < levelEnd; nodeIndex++)
+			{
+				Node node = nodes[nodeIndex];
+				RefitNode(node);
+
+				if (node.count > MaxLeafTriangles)
+				{
+					glm::vec3 centroidMin(FLT_MAX);
+					glm::vec3 centroidMax(-FLT_MAX);
+
+					for (uint32_t i = node.start; i < node.start + node.count; i++)
+					{
+						centroidMin = glm::min(centroidMin, centroids[triangleOrder[i]]);
+						centroidMax = glm::max(centroidMax, centroids[triangleOrder[i]]);
+					}
+
+					glm::vec3 extent = centroidMax - centroidMin;
+					int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+					uint32_t halfCount = node.count / 2;
+
+					std::nth_element(
+						triangleOrder.begin() + node.start,
+						triangleOrder.begin() + node.start + halfCount,
+						triangleOrder.begin() + node.start + node.count,
+						[&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; }
+					);
+
+					Node left;
+					left.start = node.start;
+					left.count = halfCount;
+					Node right;
+					right.start = node.start + halfCount;
+					right.count = node.count - halfCount;
+
+					node.start = (uint32_t)nodes.size();
+					node.count = 0;
+					nodes.push_back(left);
+					nodes.push_back(right);
+				}
+
+				nodes[nodeIndex] = node;
+			}
+
+			levelStart = levelEnd;
+			levelStarts.push_back(levelStart);
+		}
+	}
+
+	void CageBvh::RefitNode(Node& node)
+	{
+		node.min = glm::vec3(FLT_MAX);
+		node.max = glm::vec3(-FLT_MAX);
+
+		if (node.count == 0)
+		{
+			for (uint32_t i = node.start; i < node.start + 2; i++)
+			{
+				node.min = glm::min(node.min, nodes[i].min);
+				node.max = glm::max(node.max, nodes[i].max);
+			}
+
+			return;
+		}
+
+		for (uint32_t i = node.start; i < node.start + node.count; i++)
+		{
+			const GLuint* p_indices = &indices[triangleOrder[i] * 3];
+
+			for (size_t j = 0; j < 3; j++)
+			{
+				node.min = glm::min(node.min, deformedPositions[p_indices[j]]);
+				node.max = glm::max(node.max, deformedPositions[p_indices[j]]);
+			}
+		}
+	}
+
+	void CageBvh::Refit(const Deformation& deformation, ThreadPool& threadPool)
+	{
+		using namespace Simd;
+
+		if (nodes.empty())
+			return;
+
+		size_t vertexCount = undeformedPositions.size();
+
+		threadPool.ParallelFor((vertexCount + RefitChunkSize - 1) / RefitChunkSize, [&](size_t chunkIndex, size_t)
+		{
+			size_t end = glm::min((chunkIndex + 1) * RefitChunkSize, vertexCount);
+
+			for (size_t start = chunkIndex * RefitChunkSize; start < end; start += Width)
+			{
+				size_t laneCount = glm::min(end - start, Width);
+				Vec3Packet points;
+
+				for (size_t lane = 0; lane < laneCount; lane++)
+					SetLane(points, lane, undeformedPositions[start + lane]);
+
+				Vec3Packet deformedPoints = deformation.Deform(points);
+
+				for (size_t lane = 0; lane < laneCount; lane++)
+					deformedPositions[start + lane] = GetLane(deformedPoints, lane);
+			}
+		});
+
+		// a level only reads the boxes of the deeper one, which is done
+		for (size_t level = levelStarts.size() - 1; level-- > 0;)
+		{
+			size_t start = levelStarts[level];
+			size_t count = levelStarts[level + 1] - start;
+
+			threadPool.ParallelFor((count + RefitChunkSize - 1) / RefitChunkSize, [&](size_t chunkIndex, size_t)
+			{
+				size_t end = glm::min((chunkIndex + 1) * RefitChunkSize, count);
+
+				for (size_t i = chunkIndex * RefitChunkSize; i < end; i++)
+					RefitNode(nodes[start + i]);
+			});
+		}
+	}
+
+	size_t CageBvh::TriangleCount() const
+	{
+		return indices.size() / 3;
+	}
+
+	Simd::MaskPacket CageBvh::IntersectClosest(
+		const Simd::Vec3Packet& origins,
+		const Simd::Vec3Packet& directions,
+		const Simd::FloatPacket& minDistances,
+		Simd::MaskPacket activeLanes,
+		Simd::FloatPacket& outDistances,
+		Simd::Vec3Packet& outUndeformedPositions
+	) const
+	{
+		using namespace Simd;
+
+		const FloatPacket zero(0.f);
+		const FloatPacket one(1.f);
+		const FloatPacket maxDeterminant(-1e-12f);
+		MaskPacket hitLanes = NoLanes();
+		outDistances = FloatPacket(FLT_MAX);
+		outUndeformedPositions = Vec3Packet(glm::vec3(0.f));
+
+		if (nodes.empty())
+			return hitLanes;
+
+		Vec3Packet invDirections(one / directions.x, one / directions.y, one / directions.z);
+
+		// a node is visited by the whole packet if any active lane's ray hits its box closer than that lane's closest hit
+		uint32_t stack[64];
+		size_t stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			const Node& node = nodes[stack[--stackSize]];
+
+			FloatPacket t0x = (FloatPacket(node.min.x) - origins.x) * invDirections.x;
+			FloatPacket t1x = (FloatPacket(node.max.x) - origins.x) * invDirections.x;
+			FloatPacket t0y = (FloatPacket(node.min.y) - origins.y) * invDirections.y;
+			FloatPacket t1y = (FloatPacket(node.max.y) - origins.y) * invDirections.y;
+			FloatPacket t0z = (FloatPacket(node.min.z) - origins.z) * invDirections.z;
+			FloatPacket t1z = (FloatPacket(node.max.z) - origins.z) * invDirections.z;
+			FloatPacket entry = Max(Max(Min(t0x, t1x), Min(t0y, t1y)), Max(Min(t0z, t1z), minDistances));
+			FloatPacket exit = Min(Min(Max(t0x, t1x), Max(t0y, t1y)), Min(Max(t0z, t1z), outDistances));
+
+			if (!Any(activeLanes & (exit >= entry)))
+				continue;
+
+			if (node.count == 0)
+			{
+				stack[stackSize++] = node.start + 1;
+				stack[stackSize++] = node.start;
+				continue;
+			}
+
+			for (uint32_t i = node.start; i < node.start + node.count; i++)
+			{
+				const GLuint* p_indices = &indices[triangleOrder[i] * 3];
+				const glm::vec3& a = deformedPositions[p_indices[0]];
+				Vec3Packet edge1(deformedPositions[p_indices[1]] - a);
+				Vec3Packet edge2(deformedPositions[p_indices[2]] - a);
+
+				// Moller-Trumbore, a negative determinant is a front facing triangle
+				Vec3Packet p = Cross(directions, edge2);
+				FloatPacket determinant = Dot(edge1, p);
+				FloatPacket invDeterminant = one / determinant;
+				Vec3Packet toOrigin = origins - Vec3Packet(a);
+				FloatPacket u = Dot(toOrigin, p) * invDeterminant;
+				Vec3Packet q = Cross(toOrigin, edge1);
+				FloatPacket v = Dot(directions, q) * invDeterminant;
+				FloatPacket t = Dot(edge2, q) * invDeterminant;
+
+				MaskPacket hit = 
+					activeLanes & 
+					(maxDeterminant > determinant) & 
+					(u >= zero) & 
+					(v >= zero) & 
+					(one >= u + v) & 
+					(t > minDistances) & 
+					(outDistances > t);
+
+				if (!Any(hit))
+					continue;
+
+				const glm::vec3& undefA = undeformedPositions[p_indices[0]];
+				Vec3Packet undefEdge1(undeformedPositions[p_indices[1]] - undefA);
+				Vec3Packet undefEdge2(undeformedPositions[p_indices[2]] - undefA);
+
+				outDistances = Select(hit, t, outDistances);
+				outUndeformedPositions = Select(hit, Vec3Packet(undefA) + undefEdge1 * u + undefEdge2 * v, outUndeformedPositions);
+				hitLanes = hitLanes | hit;
+			}
+		}
+
+		return hitLanes;
+	}
+}
\ No newline at end of file
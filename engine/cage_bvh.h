@@ -0,0 +1,53 @@
+#pragma once
+#include "deformation.h"
+#include "thread_pool.h"
+#include "simd.h"
+#include <GL/glew.h>
+#include <vector>
+
+namespace Engine
+{
+	// bounding volume hierarchy over the cage triangles, built once over the bind pose and refit to the deformed 
+	// vertices every frame, which keeps the tree and only moves the boxes with the triangles
+	class CageBvh final
+	{
+	private:
+		struct Node
+		{
+			glm::vec3 min;
+			glm::vec3 max;
+			uint32_t start;// first child for inner nodes, which have 2 consecutive children, first triangle for leaves
+			uint32_t count;// triangles of a leaf, 0 for inner nodes
+		};
+
+		std::vector<glm::vec3> undeformedPositions;
+		std::vector<glm::vec3> deformedPositions;
+		std::vector<GLuint> indices;
+		std::vector<uint32_t> triangleOrder;// the triangles of a leaf are consecutive in here
+		std::vector<Node> nodes;// breadth first, so that every depth is a contiguous range
+		std::vector<size_t> levelStarts;// the nodes of depth i are in [levelStarts[i], levelStarts[i + 1])
+
+		void RefitNode(Node& node);
+
+	public:
+		CageBvh();
+
+		void Build(const std::vector<glm::vec3>& _undeformedPositions, const std::vector<GLuint>& _indices);
+		// deforms the vertices and updates the boxes from the leaves up, a level at a time
+		void Refit(const Deformation& deformation, ThreadPool& threadPool);
+		size_t TriangleCount() const;
+
+		// finds the closest front facing triangle (clockwise seen from the ray origin, which Camera::CalcV mirrors 
+		// to counter clockwise on screen) further along each active ray than minDistances, returns the lanes 
+		// that hit one. the hit positions are interpolated from the undeformed corners with the barycentric 
+		// coordinates of the hit on the deformed triangle
+		Simd::MaskPacket IntersectClosest(
+			const Simd::Vec3Packet& origins,
+			const Simd::Vec3Packet& directions,
+			const Simd::FloatPacket& minDistances,
+			Simd::MaskPacket activeLanes,
+			Simd::FloatPacket& outDistances,
+			Simd::Vec3Packet& outUndeformedPositions
+		) const;
+	};
+}
\ No newline at end of file
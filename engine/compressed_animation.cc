@@ -0,0 +1,385 @@
+#include "compressed_animation.h"
+#include <gtc/constants.hpp>
+#include <cfloat>
+#include <cmath>
+
+namespace Engine
+{
+	const float MaxQuantized16 = 65535.f;
+	const float MaxQuantized15 = 32767.f;
+
+	AnimationCompressionSettings::AnimationCompressionSettings() :
+		positionTolerance(0.001f),
+		rotationTolerance(0.002f),
+		scaleTolerance(0.001f)
+	{}
+
+	uint16_t Quantize(float value, float min, float extent, float maxQuantized)
+	{
+		return (uint16_t)(glm::clamp((value - min) / extent, 0.f, 1.f) * maxQuantized + 0.5f);
+	}
+
+	float Dequantize(uint16_t value, float min, float extent, float maxQuantized)
+	{
+		return min + (float)value / maxQuantized * extent;
+	}
+
+	// along the shortest arc, like SamplePose
+	glm::quat Nlerp(const glm::quat& q1, const glm::quat& q2, float alpha)
+	{
+		glm::quat shortestQ2 = glm::dot(q1, q2) < 0.f ? -q2 : q2;
+		return glm::normalize(q1 * (1.f - alpha) + shortestQ2 * alpha);
+	}
+
+	float AngleBetween(const glm::quat& q1, const glm::quat& q2)
+	{
+		return 2.f * std::acos(glm::min(glm::abs(glm::dot(q1, q2)), 1.f));
+	}
+
+	// q and -q are the same rotation, so the largest component is made positive and left out. the other 
+	// three are at most 1/sqrt(2) and get 15 bits each, the index of the largest one gets 2 bits
+	void EncodeRotation(const glm::quat& rotation, std::vector<uint16_t>& outValues)
+	{
+		float components[4] = { rotation.x, rotation.y, rotation.z, rotation.w };
+		size_t largest = 0;
+
+		for (size_t i = 1; i < 4; i++)
+		{
+			if (std::fabs(components[i]) > std::fabs(components[largest]))
+				largest = i;
+		}
+
+		float sign = components[largest] < 0.f ? -1.f : 1.f;
+		uint64_t bits = (uint64_t)largest << 45;
+		int shift = 30;
+
+		for (size_t i = 0; i < 4; i++)
+		{
+			if (i == largest)
+				continue;
+
+			float scaled = components[i] * sign * glm::root_two<float>();
+			bits |= (uint64_t)Quantize(scaled, -1.f, 2.f, MaxQuantized15) << shift;
+			shift -= 15;
+		}
+
+		outValues.push_back((uint16_t)(bits >> 32));
+		outValues.push_back((uint16_t)(bits >> 16));
+		outValues.push_back((uint16_t)bits);
+	}
+
+	// keeps the first and last key and the ones that interpolating between the kept keys around them 
+	// can't reproduce within the tolerance, extending each interval as far as it goes
+	template<typename Value, typename Interpolate, typename Difference>
+	void ReduceKeys(
+		const std::vector<float>& times,
+		const std::vector<Value>& values,
+		float tolerance,
+		Interpolate interpolate,
+		Difference difference,
+		std::vector<size_t>& outKeys
+	)
+	{
+		outKeys.clear();
+		outKeys.push_back(0);
+
+		bool isConstant = true;
+
+		for (size_t i = 1; i < values.size() && isConstant; i++)
+			isConstant = difference(values[i], values[0]) <= tolerance;
+
+		if (isConstant)
+			return;
+
+		size_t start = 0;
+
+		for (size_t end = 2; end < values.size(); end++)
+		{
+			bool fits = true;
+
+			for (size_t i = start + 1; i < end && fits; i++)
+			{
+				float alpha = (times[i] - times[start]) / (times[end] - times[start]);
+				fits = difference(interpolate(values[start], values[end], alpha), values[i]) <= tolerance;
+			}
+
+			if (!fits)
+			{
+				start = end - 1;
+				outKeys.push_back(start);
+			}
+		}
+
+		outKeys.push_back(values.size() - 1);
+	}
+
+	// key starting the interval of the track that contains the time, and the position in the interval
+	size_t FindKey(const uint16_t* p_times, size_t count, float time, uint32_t& inoutCursor, float& outAlpha)
+	{
+		outAlpha = 0.f;
+
+		if (count == 1)
+			return 0;
+
+		size_t lastKey = count - 2;
+		size_t key = lastKey + 1;
+
+		// forward playback mostly stays in the same interval or moves to the next one, like Animation::FindKeyframe
+		for (size_t i = inoutCursor; i <= glm::min((size_t)inoutCursor + 1, lastKey); i++)
+		{
+			if ((float)p_times[i] <= time && (i == lastKey || time < (float)p_times[i + 1]))
+			{
+				key = i;
+				break;
+			}
+		}
+
+		if (key > lastKey)
+		{
+			// first key after the time among the ones that can end an interval
+			size_t first = 1;
+			size_t last = count - 1;
+
+			while (first < last)
+			{
+				size_t middle = (first + last) / 2;
+
+				if ((float)p_times[middle] > time)
+					last = middle;
+				else
+					first = middle + 1;
+			}
+
+			key = first - 1;
+		}
+
+		inoutCursor = (uint32_t)key;
+		float startTime = (float)p_times[key];
+		float endTime = (float)p_times[key + 1];
+
+		if (endTime > startTime)
+			outAlpha = glm::clamp((time - startTime) / (endTime - startTime), 0.f, 1.f);
+
+		return key;
+	}
+
+
+	CompressedAnimation::CompressedAnimation() :
+		jointCount(0),
+		positionMin(0.f),
+		positionExtent(1.f),
+		scaleMin(0.f),
+		scaleExtent(1.f)
+	{}
+
+	glm::vec3 CompressedAnimation::DecodePosition(size_t key) const
+	{
+		const uint16_t* p_values = &positions[key * 3];
+
+		return glm::vec3(
+			Dequantize(p_values[0], positionMin.x, positionExtent.x, MaxQuantized16),
+			Dequantize(p_values[1], positionMin.y, positionExtent.y, MaxQuantized16),
+			Dequantize(p_values[2], positionMin.z, positionExtent.z, MaxQuantized16)
+		);
+	}
+
+	glm::quat CompressedAnimation::DecodeRotation(size_t key) const
+	{
+		const uint16_t* p_values = &rotations[key * 3];
+		uint64_t bits = ((uint64_t)p_values[0] << 32) | ((uint64_t)p_values[1] << 16) | (uint64_t)p_values[2];
+		size_t largest = (size_t)(bits >> 45) & 3;
+		float components[4];
+		float sumSquares = 0.f;
+		int shift = 30;
+
+		for (size_t i = 0; i < 4; i++)
+		{
+			if (i == largest)
+				continue;
+
+			uint16_t quantized = (uint16_t)((bits >> shift) & 0x7fff);
+			components[i] = Dequantize(quantized, -1.f, 2.f, MaxQuantized15) / glm::root_two<float>();
+			sumSquares += components[i] * components[i];
+			shift -= 15;
+		}
+
+		components[largest] = std::sqrt(glm::max(1.f - sumSquares, 0.f));
+
+		return glm::quat(components[3], components[0], components[1], components[2]);
+	}
+
+	float CompressedAnimation::DecodeScale(size_t key) const
+	{
+		return Dequantize(scales[key], scaleMin, scaleExtent, MaxQuantized16);
+	}
+
+	void CompressedAnimation::Compress(const Animation& animation, size_t _jointCount, const AnimationCompressionSettings& settings)
+	{
+		jointCount = _jointCount;
+		size_t keyframeCount = animation.keyframeCount;
+
+		positionTracks.clear();
+		rotationTracks.clear();
+		scaleTracks.clear();
+		positionTimes.clear();
+		positions.clear();
+		rotationTimes.clear();
+		rotations.clear();
+		scaleTimes.clear();
+		scales.clear();
+
+		// the positions and scales are quantized relative to the range of the whole clip
+		glm::vec3 positionMax(-FLT_MAX);
+		float scaleMax = -FLT_MAX;
+		positionMin = glm::vec3(FLT_MAX);
+		scaleMin = FLT_MAX;
+
+		for (size_t i = 0; i < keyframeCount; i++)
+		{
+			for (size_t j = 0; j < jointCount; j++)
+			{
+				Transform transform = animation.p_keyframes[i].transforms.Get(j);
+				positionMin = glm::min(positionMin, transform.position);
+				positionMax = glm::max(positionMax, transform.position);
+				scaleMin = glm::min(scaleMin, transform.scale);
+				scaleMax = glm::max(scaleMax, transform.scale);
+			}
+		}
+
+		positionExtent = glm::max(positionMax - positionMin, glm::vec3(1e-6f));
+		scaleExtent = glm::max(scaleMax - scaleMin, 1e-6f);
+
+		std::vector<float> times(keyframeCount);
+		std::vector<glm::vec3> jointPositions(keyframeCount);
+		std::vector<glm::quat> jointRotations(keyframeCount);
+		std::vector<float> jointScales(keyframeCount);
+		std::vector<size_t> keys;
+
+		for (size_t i = 0; i < keyframeCount; i++)
+			times[i] = animation.p_keyframes[i].timestamp;
+
+		for (size_t j = 0; j < jointCount; j++)
+		{
+			for (size_t i = 0; i < keyframeCount; i++)
+			{
+				Transform transform = animation.p_keyframes[i].transforms.Get(j);
+				jointPositions[i] = transform.position;
+				jointRotations[i] = transform.rotation;
+				jointScales[i] = transform.scale;
+			}
+
+			ReduceKeys(
+				times,
+				jointPositions,
+				settings.positionTolerance,
+				[](const glm::vec3& p1, const glm::vec3& p2, float alpha) { return glm::mix(p1, p2, alpha); },
+				[](const glm::vec3& p1, const glm::vec3& p2) { return glm::distance(p1, p2); },
+				keys
+			);
+			positionTracks.push_back({ (uint32_t)positionTimes.size(), (uint32_t)keys.size() });
+
+			for (size_t key : keys)
+			{
+				positionTimes.push_back(Quantize(times[key], 0.f, 1.f, MaxQuantized16));
+
+				for (glm::length_t i = 0; i < 3; i++)
+					positions.push_back(Quantize(jointPositions[key][i], positionMin[i], positionExtent[i], MaxQuantized16));
+			}
+
+			ReduceKeys(
+				times,
+				jointRotations,
+				settings.rotationTolerance,
+				Nlerp,
+				AngleBetween,
+				keys
+			);
+			rotationTracks.push_back({ (uint32_t)rotationTimes.size(), (uint32_t)keys.size() });
+
+			for (size_t key : keys)
+			{
+				rotationTimes.push_back(Quantize(times[key], 0.f, 1.f, MaxQuantized16));
+				EncodeRotation(jointRotations[key], rotations);
+			}
+
+			ReduceKeys(
+				times,
+				jointScales,
+				settings.scaleTolerance,
+				[](float s1, float s2, float alpha) { return glm::mix(s1, s2, alpha); },
+				[](float s1, float s2) { return glm::abs(s1 - s2); },
+				keys
+			);
+			scaleTracks.push_back({ (uint32_t)scaleTimes.size(), (uint32_t)keys.size() });
+
+			for (size_t key : keys)
+			{
+				scaleTimes.push_back(Quantize(times[key], 0.f, 1.f, MaxQuantized16));
+				scales.push_back(Quantize(jointScales[key], scaleMin, scaleExtent, MaxQuantized16));
+			}
+		}
+	}
+
+	void CompressedAnimation::Decompress(float normalizedTime, Keyframe& outKeyframe, std::vector<uint32_t>& inoutKeyCursors) const
+	{
+		float time = glm::clamp(normalizedTime, 0.f, 1.f) * MaxQuantized16;
+
+		// a cursor per track, in the order position, rotation and scale per joint
+		if (inoutKeyCursors.size() != jointCount * 3)
+			inoutKeyCursors.assign(jointCount * 3, 0);
+
+		for (size_t j = 0; j < jointCount; j++)
+		{
+			Transform transform;
+			float alpha = 0.f;
+
+			const Track& positionTrack = positionTracks[j];
+			size_t key = positionTrack.start + FindKey(&positionTimes[positionTrack.start], positionTrack.count, time, inoutKeyCursors[j * 3 + 0], alpha);
+			transform.position = DecodePosition(key);
+
+			if (positionTrack.count > 1)
+				transform.position = glm::mix(transform.position, DecodePosition(key + 1), alpha);
+
+			const Track& rotationTrack = rotationTracks[j];
+			key = rotationTrack.start + FindKey(&rotationTimes[rotationTrack.start], rotationTrack.count, time, inoutKeyCursors[j * 3 + 1], alpha);
+			transform.rotation = DecodeRotation(key);
+
+			if (rotationTrack.count > 1)
+				transform.rotation = Nlerp(transform.rotation, DecodeRotation(key + 1), alpha);
+
+			const Track& scaleTrack = scaleTracks[j];
+			key = scaleTrack.start + FindKey(&scaleTimes[scaleTrack.start], scaleTrack.count, time, inoutKeyCursors[j * 3 + 2], alpha);
+			transform.scale = DecodeScale(key);
+
+			if (scaleTrack.count > 1)
+				transform.scale = glm::mix(transform.scale, DecodeScale(key + 1), alpha);
+
+			outKeyframe.transforms.Set(j, transform);
+		}
+	}
+
+	void CompressedAnimation::SampleAt(
+		float normalizedTime, 
+		const BindPose& bindPose, 
+		Keyframe& scratchKeyframe, 
+		std::vector<uint32_t>& scratchKeyCursors,
+		const PoseTarget& poseTarget
+	) const
+	{
+		Decompress(normalizedTime, scratchKeyframe, scratchKeyCursors);
+		SamplePose(scratchKeyframe, scratchKeyframe, 0.f, jointCount, bindPose, poseTarget);
+	}
+
+	size_t CompressedAnimation::KeyCount() const
+	{
+		return positionTimes.size() + rotationTimes.size() + scaleTimes.size();
+	}
+
+	size_t CompressedAnimation::ByteSize() const
+	{
+		return
+			sizeof(CompressedAnimation) +
+			(positionTracks.size() + rotationTracks.size() + scaleTracks.size()) * sizeof(Track) +
+			(positionTimes.size() + positions.size() + rotationTimes.size() + rotations.size() + scaleTimes.size() + scales.size()) * sizeof(uint16_t);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+#include "animation.h"
+#include <cstdint>
+#include <vector>
+
+namespace Engine
+{
+	struct AnimationCompressionSettings
+	{
+		float positionTolerance;// max distance between a removed position key and its reconstruction
+		float rotationTolerance;// max angle in radians between a removed rotation key and its reconstruction
+		float scaleTolerance;// max difference between a removed scale key and its reconstruction
+
+		AnimationCompressionSettings();
+	};
+
+	// animation where every joint keeps its own keys per channel, only the ones that interpolating 
+	// their neighbours can't reproduce within the tolerances. times, positions and scales are quantized 
+	// to 16 bits relative to the range of the clip, rotations to 48 bits with the smallest three encoding
+	class CompressedAnimation final
+	{
+	private:
+		// keys of one channel of one joint
+		struct Track
+		{
+			uint32_t start;
+			uint32_t count;
+		};
+
+		size_t jointCount;
+		glm::vec3 positionMin;
+		glm::vec3 positionExtent;
+		float scaleMin;
+		float scaleExtent;
+		std::vector<Track> positionTracks;
+		std::vector<Track> rotationTracks;
+		std::vector<Track> scaleTracks;
+		std::vector<uint16_t> positionTimes;
+		std::vector<uint16_t> positions;// 3 per key
+		std::vector<uint16_t> rotationTimes;
+		std::vector<uint16_t> rotations;// 3 per key
+		std::vector<uint16_t> scaleTimes;
+		std::vector<uint16_t> scales;
+
+		glm::vec3 DecodePosition(size_t key) const;
+		glm::quat DecodeRotation(size_t key) const;
+		float DecodeScale(size_t key) const;
+
+	public:
+		CompressedAnimation();
+
+		void Compress(const Animation& animation, size_t _jointCount, const AnimationCompressionSettings& settings);
+		// interpolates the channels of every joint at the time into a keyframe, the key cursors start the search
+		// for the key interval of every track at the one of the last call, like the keyframe cursor of a player
+		void Decompress(float normalizedTime, Keyframe& outKeyframe, std::vector<uint32_t>& inoutKeyCursors) const;
+		// the keyframe and the key cursors are scratch memory of the caller, so that sampling is thread safe
+		void SampleAt(
+			float normalizedTime, 
+			const BindPose& bindPose, 
+			Keyframe& scratchKeyframe, 
+			std::vector<uint32_t>& scratchKeyCursors, 
+			const PoseTarget& poseTarget
+		) const;
+
+		size_t KeyCount() const;
+		size_t ByteSize() const;
+	};
+}
\ No newline at end of file
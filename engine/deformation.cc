@@ -0,0 +1,359 @@
+#include "deformation.h"
+#include <glm.hpp>
+
+namespace Engine
+{
+	float JointWeight(const glm::vec3& point, const JointWeightVolume& weightVolume)
+	{
+		// squared length to the line segment defined by the weight volume
+		float length = glm::length(weightVolume.startToEnd);
+		glm::vec3 direction = weightVolume.startToEnd / length;
+		glm::vec3 startToPoint = point - weightVolume.startPoint;
+		float projectionLength = glm::clamp(glm::dot(startToPoint, direction), 0.f, length);
+		glm::vec3 projectionToPoint = startToPoint - direction * projectionLength;
+		float distanceSquared = glm::dot(projectionToPoint, projectionToPoint);
+
+		return 1.f / (1.f + weightVolume.falloffRate * distanceSquared * distanceSquared);
+	}
+
+	uint32_t JointInfluenceMask(
+		const glm::vec3& point,
+		const JointWeightVolume* p_weightVolumes,
+		size_t jointCount,
+		float weightThreshold
+	)
+	{
+		float weights[32];
+		float weightSum = 0.f;
+		size_t count = glm::min(jointCount, (size_t)32);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			weights[i] = JointWeight(point, p_weightVolumes[i]);
+			weightSum += weights[i];
+		}
+
+		uint32_t mask = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (weights[i] >= weightThreshold * weightSum)
+				mask |= 1u << i;
+		}
+
+		return mask;
+	}
+
+	glm::vec3 DualQuaternionTransform(const glm::vec4& real, const glm::vec4& dual, const glm::vec3& point)
+	{
+		// the real part does not have to be normalized, since both the rotation and the
+		// translation are divided by its squared length
+		glm::vec3 realXYZ(real);
+		glm::vec3 dualXYZ(dual);
+		float invLengthSquared = 1.f / glm::dot(real, real);
+		glm::vec3 rotated = point + 2.f * glm::cross(realXYZ, glm::cross(realXYZ, point) + real.w * point) * invLengthSquared;
+		glm::vec3 translation = 2.f * (real.w * dualXYZ - dual.w * realXYZ + glm::cross(realXYZ, dualXYZ)) * invLengthSquared;
+
+		return rotated + translation;
+	}
+
+	Deformation::Deformation() :
+		skinningMode(SkinningMode::LinearBlend)
+	{}
+
+	void Deformation::SetPose(const BindPose* p_bindPose, const AnimationPose* p_animationPose, size_t jointCount)
+	{
+		joints.resize(jointCount);
+
+		if (jointCount == 0)
+			return;
+
+		skinningMode = p_animationPose->skinningMode;
+
+		for (size_t i = 0; i < jointCount; i++)
+		{
+			const JointWeightVolume& weightVolume = p_bindPose->p_worldWeightVolumes[i];
+			Joint& joint = joints[i];
+
+			joint.startPoint = weightVolume.startPoint;
+			joint.length = glm::length(weightVolume.startToEnd);
+			joint.direction = weightVolume.startToEnd / joint.length;
+			joint.falloffRate = weightVolume.falloffRate;
+
+			if (skinningMode == SkinningMode::DualQuaternion)
+			{
+				const DualQuaternion& dualQuaternion = p_animationPose->p_dualQuaternions[i];
+				joint.real = glm::vec4(dualQuaternion.real.x, dualQuaternion.real.y, dualQuaternion.real.z, dualQuaternion.real.w);
+				joint.dual = glm::vec4(dualQuaternion.dual.x, dualQuaternion.dual.y, dualQuaternion.dual.z, dualQuaternion.dual.w);
+				joint.scale = p_animationPose->p_scales[i];
+			}
+			else
+			{
+				joint.deformationMatrix = p_animationPose->p_deformationMatrices[i];
+			}
+		}
+	}
+
+	size_t Deformation::JointCount() const
+	{
+		return joints.size();
+	}
+
+	float Deformation::JointWeight(const glm::vec3& point, size_t jointIndex) const
+	{
+		const Joint& joint = joints[jointIndex];
+		glm::vec3 startToPoint = point - joint.startPoint;
+		float projectionLength = glm::clamp(glm::dot(startToPoint, joint.direction), 0.f, joint.length);
+		glm::vec3 projectionToPoint = startToPoint - joint.direction * projectionLength;
+		float distanceSquared = glm::dot(projectionToPoint, projectionToPoint);
+
+		return 1.f / (1.f + joint.falloffRate * distanceSquared * distanceSquared);
+	}
+
+	float Deformation::JointWeightAndGradient(const glm::vec3& point, size_t jointIndex, glm::vec3& outGradient) const
+	{
+		const Joint& joint = joints[jointIndex];
+		glm::vec3 startToPoint = point - joint.startPoint;
+		float projectionLength = glm::clamp(glm::dot(startToPoint, joint.direction), 0.f, joint.length);
+		glm::vec3 projectionToPoint = startToPoint - joint.direction * projectionLength;
+		float distanceSquared = glm::dot(projectionToPoint, projectionToPoint);
+		float weight = 1.f / (1.f + joint.falloffRate * distanceSquared * distanceSquared);
+
+		outGradient = (-4.f * joint.falloffRate * distanceSquared * weight * weight) * projectionToPoint;
+
+		return weight;
+	}
+
+	glm::vec3 Deformation::LinearBlend(const glm::vec3& point) const
+	{
+		float weightSum = 0.f;
+		glm::vec3 result(0.f);
+
+		for (size_t i = 0; i < joints.size(); i++)
+		{
+			float weight = JointWeight(point, i);
+			result += weight * glm::vec3(joints[i].deformationMatrix * glm::vec4(point, 1.f));
+			weightSum += weight;
+		}
+
+		return result * (1.f / weightSum);
+	}
+
+	glm::vec3 Deformation::DualQuaternionBlend(const glm::vec3& point) const
+	{
+		const glm::vec4& pivot = joints[0].real;
+		glm::vec4 real(0.f);
+		glm::vec4 dual(0.f);
+		float scale = 0.f;
+		float weightSum = 0.f;
+
+		for (size_t i = 0; i < joints.size(); i++)
+		{
+			const Joint& joint = joints[i];
+			float weight = JointWeight(point, i);
+
+			// blend along the shortest path by keeping all rotations in the same hemisphere
+			float signedWeight = glm::dot(joint.real, pivot) < 0.f ? -weight : weight;
+
+			real += signedWeight * joint.real;
+			dual += signedWeight * joint.dual;
+			scale += weight * joint.scale;
+			weightSum += weight;
+		}
+
+		return DualQuaternionTransform(real, dual, point * (scale / weightSum));
+	}
+
+	glm::mat3 Deformation::DualQuaternionJacobian(const glm::vec3& point) const
+	{
+		// see DualQuaternionJacobian in deformation.glsl
+		const glm::vec4& pivot = joints[0].real;
+		glm::vec4 real(0.f);
+		glm::vec4 dual(0.f);
+		float scale = 0.f;
+		float weightSum = 0.f;
+		glm::vec4 realGradient[3] = { glm::vec4(0.f), glm::vec4(0.f), glm::vec4(0.f) };
+		glm::vec4 dualGradient[3] = { glm::vec4(0.f), glm::vec4(0.f), glm::vec4(0.f) };
+		glm::vec3 scaleGradient(0.f);
+		glm::vec3 weightSumGradient(0.f);
+
+		for (size_t i = 0; i < joints.size(); i++)
+		{
+			const Joint& joint = joints[i];
+			glm::vec3 weightGradient(0.f);
+			float weight = JointWeightAndGradient(point, i, weightGradient);
+			float jointSign = glm::dot(joint.real, pivot) < 0.f ? -1.f : 1.f;
+
+			real += (jointSign * weight) * joint.real;
+			dual += (jointSign * weight) * joint.dual;
+			scale += weight * joint.scale;
+			weightSum += weight;
+
+			for (glm::length_t k = 0; k < 3; k++)
+			{
+				realGradient[k] += (jointSign * weightGradient[k]) * joint.real;
+				dualGradient[k] += (jointSign * weightGradient[k]) * joint.dual;
+			}
+			scaleGradient += weightGradient * joint.scale;
+			weightSumGradient += weightGradient;
+		}
+
+		float normalizedScale = scale / weightSum;
+		glm::vec3 normalizedScaleGradient = (scaleGradient - normalizedScale * weightSumGradient) / weightSum;
+		glm::vec3 scaledPoint = point * normalizedScale;
+
+		glm::vec3 realXYZ(real);
+		glm::vec3 dualXYZ(dual);
+		float lengthSquared = glm::dot(real, real);
+		glm::vec3 deformedPoint = DualQuaternionTransform(real, dual, scaledPoint);
+		glm::vec3 rotationTerm = glm::cross(realXYZ, scaledPoint) + real.w * scaledPoint;
+
+		glm::mat3 jacobian(0.f);
+
+		for (glm::length_t k = 0; k < 3; k++)
+		{
+			glm::vec4 dReal = realGradient[k];
+			glm::vec4 dDual = dualGradient[k];
+			glm::vec3 dRealXYZ(dReal);
+			glm::vec3 dDualXYZ(dDual);
+			glm::vec3 dPoint = point * normalizedScaleGradient[k];
+			dPoint[k] += normalizedScale;
+			float dLengthSquared = 2.f * glm::dot(real, dReal);
+
+			glm::vec3 dRotationTerm =
+				glm::cross(dRealXYZ, scaledPoint) + glm::cross(realXYZ, dPoint) +
+				dReal.w * scaledPoint + real.w * dPoint;
+			glm::vec3 dNumerator =
+				dLengthSquared * scaledPoint + lengthSquared * dPoint +
+				2.f * (glm::cross(dRealXYZ, rotationTerm) + glm::cross(realXYZ, dRotationTerm)) +
+				2.f * (
+					dReal.w * dualXYZ + real.w * dDualXYZ -
+					dDual.w * realXYZ - dual.w * dRealXYZ +
+					glm::cross(dRealXYZ, dualXYZ) + glm::cross(realXYZ, dDualXYZ)
+				);
+
+			jacobian[k] = (dNumerator - deformedPoint * dLengthSquared) / lengthSquared;
+		}
+
+		return jacobian;
+	}
+
+	glm::vec3 Deformation::Deform(const glm::vec3& point) const
+	{
+		if (joints.empty())
+			return point;
+
+		if (skinningMode == SkinningMode::DualQuaternion)
+			return DualQuaternionBlend(point);
+
+		return LinearBlend(point);
+	}
+
+	glm::mat3 Deformation::Jacobian(const glm::vec3& point) const
+	{
+		if (joints.empty())
+			return glm::mat3(1.f);
+
+		if (skinningMode == SkinningMode::DualQuaternion)
+			return DualQuaternionJacobian(point);
+
+		// forward differences, same step as the shader
+		const float step = 0.0001f;
+		const float scale = 10000.f;
+
+		glm::vec3 centerDeformation = Deform(point);
+		glm::mat3 jacobian(0.f);
+		jacobian[0] = (Deform(point + glm::vec3(step, 0.f, 0.f)) - centerDeformation) * scale;
+		jacobian[1] = (Deform(point + glm::vec3(0.f, step, 0.f)) - centerDeformation) * scale;
+		jacobian[2] = (Deform(point + glm::vec3(0.f, 0.f, step)) - centerDeformation) * scale;
+
+		return jacobian;
+	}
+
+	Simd::FloatPacket Deformation::JointWeight(const Simd::Vec3Packet& points, size_t jointIndex) const
+	{
+		using namespace Simd;
+
+		const Joint& joint = joints[jointIndex];
+		Vec3Packet direction(joint.direction);
+		Vec3Packet startToPoint = points - Vec3Packet(joint.startPoint);
+		FloatPacket projectionLength = Clamp(Dot(startToPoint, direction), 0.f, joint.length);
+		Vec3Packet projectionToPoint = startToPoint - direction * projectionLength;
+		FloatPacket distanceSquared = Dot(projectionToPoint, projectionToPoint);
+
+		return FloatPacket(1.f) / (FloatPacket(1.f) + FloatPacket(joint.falloffRate) * distanceSquared * distanceSquared);
+	}
+
+	Simd::Vec3Packet Deformation::LinearBlend(const Simd::Vec3Packet& points) const
+	{
+		using namespace Simd;
+
+		FloatPacket weightSum(0.f);
+		Vec3Packet result(glm::vec3(0.f));
+
+		for (size_t i = 0; i < joints.size(); i++)
+		{
+			const glm::mat4& matrix = joints[i].deformationMatrix;
+			FloatPacket weight = JointWeight(points, i);
+
+			Vec3Packet transformed(
+				points.x * matrix[0][0] + points.y * matrix[1][0] + points.z * matrix[2][0] + matrix[3][0],
+				points.x * matrix[0][1] + points.y * matrix[1][1] + points.z * matrix[2][1] + matrix[3][1],
+				points.x * matrix[0][2] + points.y * matrix[1][2] + points.z * matrix[2][2] + matrix[3][2]
+			);
+
+			result = result + transformed * weight;
+			weightSum = weightSum + weight;
+		}
+
+		return result * (FloatPacket(1.f) / weightSum);
+	}
+
+	Simd::Vec3Packet Deformation::Deform(const Simd::Vec3Packet& points) const
+	{
+		if (joints.empty())
+			return points;
+
+		if (skinningMode == SkinningMode::LinearBlend)
+			return LinearBlend(points);
+
+		Simd::Vec3Packet result;
+		for (size_t lane = 0; lane < Simd::Width; lane++)
+			Simd::SetLane(result, lane, Deform(Simd::GetLane(points, lane)));
+
+		return result;
+	}
+
+	Simd::Mat3Packet Deformation::Jacobian(const Simd::Vec3Packet& points) const
+	{
+		using namespace Simd;
+
+		Mat3Packet jacobian;
+
+		if (joints.empty())
+		{
+			jacobian.columns[0] = Vec3Packet(glm::vec3(1.f, 0.f, 0.f));
+			jacobian.columns[1] = Vec3Packet(glm::vec3(0.f, 1.f, 0.f));
+			jacobian.columns[2] = Vec3Packet(glm::vec3(0.f, 0.f, 1.f));
+			return jacobian;
+		}
+
+		if (skinningMode == SkinningMode::DualQuaternion)
+		{
+			for (size_t lane = 0; lane < Width; lane++)
+				SetLane(jacobian, lane, Jacobian(GetLane(points, lane)));
+
+			return jacobian;
+		}
+
+		// forward differences, same step as the shader
+		const float step = 0.0001f;
+		const float scale = 10000.f;
+
+		Vec3Packet centerDeformation = LinearBlend(points);
+		jacobian.columns[0] = (LinearBlend(Vec3Packet(points.x + step, points.y, points.z)) - centerDeformation) * scale;
+		jacobian.columns[1] = (LinearBlend(Vec3Packet(points.x, points.y + step, points.z)) - centerDeformation) * scale;
+		jacobian.columns[2] = (LinearBlend(Vec3Packet(points.x, points.y, points.z + step)) - centerDeformation) * scale;
+
+		return jacobian;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+#include "animation.h"
+#include "simd.h"
+#include <cstdint>
+#include <mat3x3.hpp>
+
+namespace Engine
+{
+	// cpu mirror of the joint weight in deformation.glsl
+	float JointWeight(const glm::vec3& point, const JointWeightVolume& weightVolume);
+
+	// a bit per joint whose normalized weight at the point is at least the threshold
+	uint32_t JointInfluenceMask(
+		const glm::vec3& point, 
+		const JointWeightVolume* p_weightVolumes, 
+		size_t jointCount, 
+		float weightThreshold
+	);
+
+	// cpu mirror of deformation.glsl, set from the poses once per frame
+	class Deformation
+	{
+	private:
+		struct Joint
+		{
+			glm::vec3 startPoint;
+			glm::vec3 direction;
+			float length;
+			float falloffRate;
+			glm::mat4 deformationMatrix;
+			glm::vec4 real;// dual quaternion as x, y, z, w like the shader uniforms
+			glm::vec4 dual;
+			float scale;
+		};
+
+		SkinningMode skinningMode;
+		std::vector<Joint> joints;
+
+		float JointWeightAndGradient(const glm::vec3& point, size_t jointIndex, glm::vec3& outGradient) const;
+		glm::vec3 LinearBlend(const glm::vec3& point) const;
+		glm::vec3 DualQuaternionBlend(const glm::vec3& point) const;
+		glm::mat3 DualQuaternionJacobian(const glm::vec3& point) const;
+		Simd::FloatPacket JointWeight(const Simd::Vec3Packet& points, size_t jointIndex) const;
+		Simd::Vec3Packet LinearBlend(const Simd::Vec3Packet& points) const;
+
+	public:
+		Deformation();
+
+		// no joints means no deformation
+		void SetPose(const BindPose* p_bindPose, const AnimationPose* p_animationPose, size_t jointCount);
+		size_t JointCount() const;
+		float JointWeight(const glm::vec3& point, size_t jointIndex) const;
+		glm::vec3 Deform(const glm::vec3& point) const;
+		glm::mat3 Jacobian(const glm::vec3& point) const;
+		// one point per lane, linear blending is vectorized and dual quaternion blending runs per lane
+		Simd::Vec3Packet Deform(const Simd::Vec3Packet& points) const;
+		Simd::Mat3Packet Jacobian(const Simd::Vec3Packet& points) const;
+	};
+}
\ No newline at end of file
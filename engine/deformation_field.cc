@@ -0,0 +1,98 @@
+#include "deformation_field.h"
+#include <glm.hpp>
+
+namespace Engine
+{
+	DeformationField::DeformationField() :
+		columnTextures{ 0, 0, 0 },
+		resolution(0)
+	{}
+
+	DeformationField::~DeformationField()
+	{
+		Deinit();
+	}
+
+	void DeformationField::Deinit()
+	{
+		if (columnTextures[0] != 0)
+			glDeleteTextures(3, columnTextures);
+
+		for (GLuint& texture : columnTextures)
+			texture = 0;
+
+		resolution = glm::ivec3(0);
+	}
+
+	bool DeformationField::Reload(const std::string& bakeShaderFilePath)
+	{
+		return bakeShader.Reload(bakeShaderFilePath);
+	}
+
+	Shader& DeformationField::GetBakeShader()
+	{
+		return bakeShader;
+	}
+
+	void DeformationField::Bake(const glm::vec3& volumeMin, const glm::vec3& volumeMax, const glm::ivec3& _resolution)
+	{
+		// (re)create textures if the resolution changed
+		if (_resolution != resolution)
+		{
+			Deinit();
+			resolution = _resolution;
+
+			glGenTextures(3, columnTextures);
+
+			for (GLuint texture : columnTextures)
+			{
+				glBindTexture(GL_TEXTURE_3D, texture);
+				glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA32F, resolution.x, resolution.y, resolution.z, 0, GL_RGBA, GL_FLOAT, nullptr);
+				glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+			}
+
+			glBindTexture(GL_TEXTURE_3D, 0);
+		}
+
+		// samples are taken at the texel centers, so that trilinear filtering reconstructs the field
+		glm::vec3 voxelSize = (volumeMax - volumeMin) / glm::vec3(resolution);
+
+		bakeShader.Use();
+		bakeShader.SetVec3("u_volumeMin", &volumeMin[0]);
+		bakeShader.SetVec3("u_voxelSize", &voxelSize[0]);
+		bakeShader.SetInt("u_voxelCountX", (GLint)resolution.x);
+		bakeShader.SetInt("u_voxelCountY", (GLint)resolution.y);
+		bakeShader.SetInt("u_voxelCountZ", (GLint)resolution.z);
+
+		for (GLuint i = 0; i < 3; i++)
+			glBindImageTexture(i, columnTextures[i], 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+		const GLuint groupSize = 4;
+		glDispatchCompute(
+			(resolution.x + groupSize - 1) / groupSize,
+			(resolution.y + groupSize - 1) / groupSize,
+			(resolution.z + groupSize - 1) / groupSize
+		);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+		for (GLuint i = 0; i < 3; i++)
+			glBindImageTexture(i, 0, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+		bakeShader.StopUsing();
+	}
+
+	void DeformationField::BindTextures(GLuint firstTextureUnit) const
+	{
+		for (GLuint i = 0; i < 3; i++)
+		{
+			glActiveTexture(GL_TEXTURE0 + firstTextureUnit + i);
+			glBindTexture(GL_TEXTURE_3D, columnTextures[i]);
+		}
+
+		glActiveTexture(GL_TEXTURE0);
+	}
+}
\ No newline at end of file
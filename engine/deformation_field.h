@@ -0,0 +1,29 @@
+#pragma once
+#include "shader.h"
+#include <vec3.hpp>
+
+namespace Engine
+{
+	// bakes the inverse Jacobian of the deformation over a volume in undeformed space into 
+	// 3D textures, so that it can be sampled instead of evaluated
+	class DeformationField
+	{
+	private:
+		Shader bakeShader;
+		GLuint columnTextures[3];// one column of the inverse Jacobian per texture
+		glm::ivec3 resolution;
+
+		void Deinit();
+
+	public:
+		DeformationField();
+		~DeformationField();
+
+		bool Reload(const std::string& bakeShaderFilePath);
+		// the deformation uniforms must be set on this shader (while in use) before baking
+		Shader& GetBakeShader();
+		// min and max inclusive (from edge to edge)
+		void Bake(const glm::vec3& volumeMin, const glm::vec3& volumeMax, const glm::ivec3& _resolution);
+		void BindTextures(GLuint firstTextureUnit) const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include "frame_buffer.h"
+
+namespace Engine
+{
+	FrameBuffer::FrameBuffer() :
+		frameBuffer(0),
+		depthTexture(0),
+		hasDepth(false),
+		width(0),
+		height(0)
+	{}
+
+	FrameBuffer::~FrameBuffer()
+	{
+		Deinit();
+	}
+
+	void FrameBuffer::Deinit()
+	{
+		if (frameBuffer != 0)
+			glDeleteFramebuffers(1, &frameBuffer);
+
+		if (!colorTextures.empty())
+			glDeleteTextures((GLsizei)colorTextures.size(), colorTextures.data());
+
+		if (depthTexture != 0)
+			glDeleteTextures(1, &depthTexture);
+
+		frameBuffer = 0;
+		colorTextures.clear();
+		depthTexture = 0;
+		width = 0;
+		height = 0;
+	}
+
+	void SetNearestFiltering()
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	bool FrameBuffer::Resize(GLsizei _width, GLsizei _height, const std::vector<GLenum>& _colorFormats, bool _hasDepth)
+	{
+		if (frameBuffer != 0 && width == _width && height == _height && colorFormats == _colorFormats && hasDepth == _hasDepth)
+			return false;
+
+		Deinit();
+		width = _width;
+		height = _height;
+		colorFormats = _colorFormats;
+		hasDepth = _hasDepth;
+
+		glGenFramebuffers(1, &frameBuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+
+		colorTextures.resize(colorFormats.size());
+		std::vector<GLenum> drawBuffers(colorFormats.size());
+
+		if (!colorTextures.empty())
+			glGenTextures((GLsizei)colorTextures.size(), colorTextures.data());
+
+		for (size_t i = 0; i < colorTextures.size(); i++)
+		{
+			glBindTexture(GL_TEXTURE_2D, colorTextures[i]);
+			glTexImage2D(GL_TEXTURE_2D, 0, colorFormats[i], width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+			SetNearestFiltering();
+
+			drawBuffers[i] = GL_COLOR_ATTACHMENT0 + (GLenum)i;
+			glFramebufferTexture2D(GL_FRAMEBUFFER, drawBuffers[i], GL_TEXTURE_2D, colorTextures[i], 0);
+		}
+
+		if (hasDepth)
+		{
+			glGenTextures(1, &depthTexture);
+			glBindTexture(GL_TEXTURE_2D, depthTexture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+			SetNearestFiltering();
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+		}
+
+		if (drawBuffers.empty())
+			glDrawBuffer(GL_NONE);
+		else
+			glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		return true;
+	}
+
+	void FrameBuffer::Bind() const
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+		glViewport(0, 0, width, height);
+	}
+
+	void FrameBuffer::Unbind(GLsizei screenWidth, GLsizei screenHeight) const
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, screenWidth, screenHeight);
+	}
+
+	void FrameBuffer::Clear() const
+	{
+		const GLfloat zeros[4] = { 0.f, 0.f, 0.f, 0.f };
+		const GLfloat farDepth = 1.f;
+
+		glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+
+		for (size_t i = 0; i < colorTextures.size(); i++)
+			glClearBufferfv(GL_COLOR, (GLint)i, zeros);
+
+		if (hasDepth)
+			glClearBufferfv(GL_DEPTH, 0, &farDepth);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	void FrameBuffer::BlitColorToScreen(size_t index, GLsizei screenWidth, GLsizei screenHeight) const
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, frameBuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glReadBuffer(GL_COLOR_ATTACHMENT0 + (GLenum)index);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, screenWidth, screenHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	void FrameBuffer::BindColorTexture(size_t index, GLuint textureUnit) const
+	{
+		glActiveTexture(GL_TEXTURE0 + textureUnit);
+		glBindTexture(GL_TEXTURE_2D, colorTextures[index]);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	void FrameBuffer::BindDepthTexture(GLuint textureUnit) const
+	{
+		glActiveTexture(GL_TEXTURE0 + textureUnit);
+		glBindTexture(GL_TEXTURE_2D, depthTexture);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	GLuint FrameBuffer::GetColorTexture(size_t index) const
+	{
+		return colorTextures[index];
+	}
+
+	GLsizei FrameBuffer::Width() const
+	{
+		return width;
+	}
+
+	GLsizei FrameBuffer::Height() const
+	{
+		return height;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+#include <GL/glew.h>
+#include <vector>
+
+namespace Engine
+{
+	// offscreen render target with float color textures and an optional depth texture,
+	// all sampled with nearest filtering
+	class FrameBuffer
+	{
+	private:
+		GLuint frameBuffer;
+		std::vector<GLuint> colorTextures;
+		GLuint depthTexture;
+		std::vector<GLenum> colorFormats;
+		bool hasDepth;
+		GLsizei width;
+		GLsizei height;
+
+		void Deinit();
+
+	public:
+		FrameBuffer();
+		~FrameBuffer();
+
+		// (re)creates the textures if the size or the formats changed, e.g. GL_RGBA32F, returns true if it did
+		bool Resize(GLsizei _width, GLsizei _height, const std::vector<GLenum>& _colorFormats, bool _hasDepth);
+		// binds for drawing and sets the viewport to the size of the buffer
+		void Bind() const;
+		// binds the default frame buffer and sets the viewport to the given size
+		void Unbind(GLsizei screenWidth, GLsizei screenHeight) const;
+		// clears the colors to 0 and the depth to 1
+		void Clear() const;
+		// copies a color texture to the whole default frame buffer
+		void BlitColorToScreen(size_t index, GLsizei screenWidth, GLsizei screenHeight) const;
+		void BindColorTexture(size_t index, GLuint textureUnit) const;
+		void BindDepthTexture(GLuint textureUnit) const;
+		GLuint GetColorTexture(size_t index) const;
+		GLsizei Width() const;
+		GLsizei Height() const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "gpu_counters.h"
+
+namespace Engine
+{
+	GpuCounters::GpuCounters() :
+		buffer(0),
+		count(0)
+	{}
+
+	GpuCounters::~GpuCounters()
+	{
+		Deinit();
+	}
+
+	void GpuCounters::Deinit()
+	{
+		if (buffer != 0)
+			glDeleteBuffers(1, &buffer);
+
+		buffer = 0;
+		count = 0;
+	}
+
+	void GpuCounters::Init(GLsizei _count)
+	{
+		Deinit();
+		count = _count;
+
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(GLuint), nullptr, GL_DYNAMIC_READ);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		Reset();
+	}
+
+	void GpuCounters::Reset()
+	{
+		std::vector<GLuint> zeros(count, 0);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(GLuint), zeros.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	void GpuCounters::Bind(GLuint binding) const
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+	}
+
+	void GpuCounters::Unbind(GLuint binding) const
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, 0);
+	}
+
+	void GpuCounters::Read(std::vector<GLuint>& outValues) const
+	{
+		outValues.resize(count);
+
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(GLuint), outValues.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+}
\ No newline at end of file
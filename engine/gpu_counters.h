@@ -0,0 +1,27 @@
+#pragma once
+#include <GL/glew.h>
+#include <vector>
+
+namespace Engine
+{
+	// a small shader storage buffer of uints that shaders increment with atomicAdd,
+	// read back on the cpu which waits for the gpu to finish
+	class GpuCounters
+	{
+	private:
+		GLuint buffer;
+		GLsizei count;
+
+		void Deinit();
+
+	public:
+		GpuCounters();
+		~GpuCounters();
+
+		void Init(GLsizei _count);
+		void Reset();
+		void Bind(GLuint binding) const;
+		void Unbind(GLuint binding) const;
+		void Read(std::vector<GLuint>& outValues) const;
+	};
+}
\ No newline at end of file
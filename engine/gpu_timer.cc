@@ -0,0 +1,76 @@
+#include "gpu_timer.h"
+
+namespace Engine
+{
+	GpuTimer::GpuTimer() :
+		queries{ 0, 0, 0, 0 },
+		isPending{ false, false, false, false },
+		currentQuery(0),
+		lastMilliseconds(0.f)
+	{}
+
+	GpuTimer::~GpuTimer()
+	{
+		Deinit();
+	}
+
+	void GpuTimer::Deinit()
+	{
+		if (queries[0] != 0)
+			glDeleteQueries(QueryCount, queries);
+
+		for (size_t i = 0; i < QueryCount; i++)
+		{
+			queries[i] = 0;
+			isPending[i] = false;
+		}
+
+		lastMilliseconds = 0.f;
+	}
+
+	void GpuTimer::ReadAvailableResults()
+	{
+		// the oldest query is the one that is used next
+		for (size_t i = 0; i < QueryCount; i++)
+		{
+			size_t query = (currentQuery + i) % QueryCount;
+			if (!isPending[query])
+				continue;
+
+			GLint isAvailable = GL_FALSE;
+			glGetQueryObjectiv(queries[query], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+
+			// the queries finish in order, so the later ones are not available either
+			if (isAvailable == GL_FALSE)
+				return;
+
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(queries[query], GL_QUERY_RESULT, &nanoseconds);
+			lastMilliseconds = float(nanoseconds) * 1e-6f;
+			isPending[query] = false;
+		}
+	}
+
+	void GpuTimer::Begin()
+	{
+		if (queries[0] == 0)
+			glGenQueries(QueryCount, queries);
+
+		// a measurement that is still pending after all others were started is dropped
+		glBeginQuery(GL_TIME_ELAPSED, queries[currentQuery]);
+	}
+
+	void GpuTimer::End()
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		isPending[currentQuery] = true;
+		currentQuery = (currentQuery + 1) % QueryCount;
+
+		ReadAvailableResults();
+	}
+
+	float GpuTimer::GetMilliseconds() const
+	{
+		return lastMilliseconds;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+#include <GL/glew.h>
+
+namespace Engine
+{
+	// measures the gpu time between Begin and End with timer queries. the results are only read once
+	// they are available, so that the cpu never waits for the gpu, even when it is several frames behind
+	class GpuTimer
+	{
+	private:
+		static const size_t QueryCount = 4;
+
+		GLuint queries[QueryCount];
+		bool isPending[QueryCount];// ended, but the result has not been read yet
+		size_t currentQuery;
+		float lastMilliseconds;
+
+		void Deinit();
+		// reads the available results in the order the queries were ended
+		void ReadAvailableResults();
+
+	public:
+		GpuTimer();
+		~GpuTimer();
+
+		void Begin();
+		void End();
+		// time of the latest measurement with an available result, 0 if there is none
+		float GetMilliseconds() const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#include "image.h"
+#include "file_io.h"
+#include <glm.hpp>
+#include <cmath>
+
+namespace Engine
+{
+	bool WriteImagePpm(const std::string& path, size_t width, size_t height, const glm::vec3* p_colors)
+	{
+		std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+		std::vector<char> binary(header.begin(), header.end());
+		binary.reserve(header.size() + width * height * 3);
+
+		// ppm rows go from top to bottom
+		for (size_t y = height; y-- > 0;)
+		{
+			for (size_t x = 0; x < width; x++)
+			{
+				glm::vec3 color = glm::clamp(p_colors[y * width + x], 0.f, 1.f);
+
+				for (glm::length_t i = 0; i < 3; i++)
+					binary.push_back((char)(unsigned char)(color[i] * 255.f + 0.5f));
+			}
+		}
+
+		return WriteBinaryFile(path, binary, false);
+	}
+
+	ImageDifference CompareImages(size_t pixelCount, const glm::vec3* p_colorsA, const glm::vec3* p_colorsB)
+	{
+		double squaredErrorSum = 0.;
+
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			glm::vec3 difference = glm::clamp(p_colorsA[i], 0.f, 1.f) - glm::clamp(p_colorsB[i], 0.f, 1.f);
+			squaredErrorSum += (double)glm::dot(difference, difference);
+		}
+
+		ImageDifference result;
+		double meanSquaredError = pixelCount > 0 ? squaredErrorSum / double(pixelCount * 3) : 0.;
+		result.rmse = (float)glm::sqrt(meanSquaredError);
+		result.psnr = meanSquaredError > 0. ? (float)(-10. * std::log10(meanSquaredError)) : INFINITY;
+		return result;
+	}
+}
\ No newline at end of file
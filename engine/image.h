@@ -0,0 +1,18 @@
+#pragma once
+#include <vec3.hpp>
+#include <string>
+
+namespace Engine
+{
+	struct ImageDifference
+	{
+		float rmse;// root mean square error over all channels of colors in [0, 1]
+		float psnr;// peak signal-to-noise ratio in dB, infinity for equal images
+	};
+
+	// writes a binary 8 bit ppm, the colors are clamped to [0, 1] and the
+	// rows are ordered from bottom to top like OpenGL framebuffers
+	bool WriteImagePpm(const std::string& path, size_t width, size_t height, const glm::vec3* p_colors);
+	// the colors are clamped to [0, 1] like when they are written
+	ImageDifference CompareImages(size_t pixelCount, const glm::vec3* p_colorsA, const glm::vec3* p_colorsB);
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "linear_allocator.h"
+#include <cassert>
+
+namespace Engine
+{
+	LinearAllocator::LinearAllocator() :
+		p_memory(nullptr),
+		capacity(0),
+		used(0)
+	{}
+
+	LinearAllocator::~LinearAllocator()
+	{
+		Free();
+	}
+
+	void LinearAllocator::Reserve(size_t byteCount)
+	{
+		Free();
+
+		if (byteCount == 0)
+			return;
+
+		p_memory = static_cast<char*>(::operator new(byteCount, std::align_val_t(Alignment)));
+		capacity = byteCount;
+	}
+
+	void* LinearAllocator::Allocate(size_t byteCount)
+	{
+		size_t alignedByteCount = (byteCount + Alignment - 1) / Alignment * Alignment;
+		assert(used + alignedByteCount <= capacity);
+
+		void* p_allocation = p_memory + used;
+		used += alignedByteCount;
+
+		return p_allocation;
+	}
+
+	void LinearAllocator::Free()
+	{
+		if (p_memory != nullptr)
+			::operator delete(p_memory, std::align_val_t(Alignment));
+
+		p_memory = nullptr;
+		capacity = 0;
+		used = 0;
+	}
+
+	size_t LinearAllocator::Capacity() const
+	{
+		return capacity;
+	}
+
+	size_t LinearAllocator::Used() const
+	{
+		return used;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <new>
+
+namespace Engine
+{
+	// hands out memory from one block reserved up front by bumping an offset, everything is 
+	// freed at once. allocations are aligned to cache lines, which also covers every simd width
+	class LinearAllocator final
+	{
+	private:
+		char* p_memory;
+		size_t capacity;
+		size_t used;
+
+	public:
+		static constexpr size_t Alignment = 64;
+
+		LinearAllocator();
+		~LinearAllocator();
+
+		LinearAllocator(const LinearAllocator&) = delete;
+		LinearAllocator& operator=(const LinearAllocator&) = delete;
+
+		// bytes taken by an allocation of count elements, for summing up the size to reserve
+		template<typename T>
+		static size_t ByteSize(size_t count)
+		{
+			return (count * sizeof(T) + Alignment - 1) / Alignment * Alignment;
+		}
+
+		// frees the previous block
+		void Reserve(size_t byteCount);
+		void* Allocate(size_t byteCount);
+		// the elements are value initialized but never destroyed, owners of 
+		// types with destructors have to call them before freeing
+		template<typename T>
+		T* Allocate(size_t count)
+		{
+			T* p_elements = static_cast<T*>(Allocate(count * sizeof(T)));
+
+			for (size_t i = 0; i < count; i++)
+				new (p_elements + i) T();
+
+			return p_elements;
+		}
+		void Free();
+
+		size_t Capacity() const;
+		size_t Used() const;
+	};
+}
\ No newline at end of file
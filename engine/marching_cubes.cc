@@ -600,7 +600,8 @@ namespace Engine
         float surfaceOffset,
         glm::vec3& outMinCorner,
         glm::vec3& outMaxCorner,
-        RenderMesh& outMesh
+        std::vector<glm::vec3>& outPositions,
+        std::vector<GLuint>& outIndices
 	)
 	{ 
         PointGrid pointGrid;
@@ -631,18 +632,28 @@ namespace Engine
         for (size_t z=0; z<cellGrid.sizeZ; z++)
             TriangulateCell(meshData, cellGrid, x, y, z, pointGrid, volumeMin, cellSize, surfaceOffset, outMinCorner, outMaxCorner);
 
+        outPositions = std::move(meshData.positions);
+        outIndices = std::move(meshData.indices);
+	}
+
+    void GenerateTriangleMesh(
+        const std::vector<glm::vec3>& positions,
+        const std::vector<GLuint>& indices,
+        RenderMesh& outMesh
+    )
+    {
         DataBuffer indexBuffer;
-        indexBuffer.bufferStart = (GLubyte*)meshData.indices.data();
-        indexBuffer.byteSize = sizeof(GLuint) * meshData.indices.size();
+        indexBuffer.bufferStart = (GLubyte*)indices.data();
+        indexBuffer.byteSize = sizeof(GLuint) * indices.size();
 
         IndexAttribute indexAttrib;
         indexAttrib.offset = 0;
-        indexAttrib.count = meshData.indices.size();
+        indexAttrib.count = indices.size();
         indexAttrib.type = GL_UNSIGNED_INT;
 
         DataBuffer posBuffer;
-        posBuffer.bufferStart = (GLubyte*)meshData.positions.data();
-        posBuffer.byteSize = sizeof(glm::vec3) * meshData.positions.size();
+        posBuffer.bufferStart = (GLubyte*)positions.data();
+        posBuffer.byteSize = sizeof(glm::vec3) * positions.size();
 
         VertexAttribute posAttrib;
         posAttrib.location = 0;
@@ -652,5 +663,38 @@ namespace Engine
         posAttrib.type = GL_FLOAT;
 
         outMesh.Reload(indexBuffer, { indexAttrib }, { posBuffer }, { posAttrib });
+    }
+
+	void TriangulateScalarField(
+        const float* p_scalarField,
+        size_t sizeX,
+        size_t sizeY,
+        size_t sizeZ,
+        const glm::vec3& volumeMin,
+        const glm::vec3& cellSize,
+        float surfaceOffset,
+        glm::vec3& outMinCorner,
+        glm::vec3& outMaxCorner,
+        RenderMesh& outMesh
+	)
+	{ 
+        std::vector<glm::vec3> positions;
+        std::vector<GLuint> indices;
+
+        TriangulateScalarField(
+            p_scalarField, 
+            sizeX, 
+            sizeY, 
+            sizeZ, 
+            volumeMin, 
+            cellSize, 
+            surfaceOffset, 
+            outMinCorner, 
+            outMaxCorner, 
+            positions, 
+            indices
+        );
+
+        GenerateTriangleMesh(positions, indices, outMesh);
 	}
 }
\ No newline at end of file
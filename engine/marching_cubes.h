@@ -4,6 +4,27 @@
 
 namespace Engine
 {
+	void TriangulateScalarField(
+		const float* p_scalarField, 
+		size_t sizeX,
+		size_t sizeY,
+		size_t sizeZ,
+		const glm::vec3& volumeMin,
+		const glm::vec3& cellSize,
+		float surfaceOffset,
+		glm::vec3& outMinCorner,
+		glm::vec3& outMaxCorner,
+		std::vector<glm::vec3>& outPositions,
+		std::vector<GLuint>& outIndices
+	);
+
+	// uploads triangles as a mesh with the positions at attribute location 0
+	void GenerateTriangleMesh(
+		const std::vector<glm::vec3>& positions,
+		const std::vector<GLuint>& indices,
+		RenderMesh& outMesh
+	);
+
 	void TriangulateScalarField(
 		const float* p_scalarField, 
 		size_t sizeX,
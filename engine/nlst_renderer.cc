@@ -0,0 +1,1137 @@
+#include "nlst_renderer.h"
+#include <glm.hpp>
+#include <algorithm>
+
+namespace Engine
+{
+	NlstRenderSettings::NlstRenderSettings() :
+		maxDistanceFromSurface(2.f),
+		maxRadius(0.2f),
+		cageSubdivisions(5),
+		tileSize(16),
+		lightDirection(glm::normalize(glm::vec3(-0.8f, -1.f, 0.6f))),
+		clearColor(0.f),
+		odeTolerance(0.f),
+		usePackets(true),
+		deferredShading(false),
+		broydenMaxSteps(0),
+		broydenTolerance(0.05f),
+		useCageBvh(false)
+	{}
+
+
+	NlstRenderTarget::NlstRenderTarget() :
+		width(0),
+		height(0)
+	{}
+
+	void NlstRenderTarget::Resize(size_t _width, size_t _height)
+	{
+		width = _width;
+		height = _height;
+		hits.resize(width * height);
+		steps.resize(width * height);
+		depths.resize(width * height);
+		hitPoints.resize(width * height);
+		colors.resize(width * height);
+	}
+
+	void NlstRenderTarget::Clear(const glm::vec3& clearColor)
+	{
+		std::fill(hits.begin(), hits.end(), (uint8_t)0);
+		std::fill(steps.begin(), steps.end(), 0u);
+		std::fill(depths.begin(), depths.end(), 1.f);
+		std::fill(hitPoints.begin(), hitPoints.end(), glm::vec3(0.f));
+		std::fill(colors.begin(), colors.end(), clearColor);
+	}
+
+
+	// step sizes of SolveBS23Adaptive, same as in deform_frag.glsl
+	const float InitialOdeStepSize = 0.01f;
+	const float MinOdeStepSize = 0.001f;
+	// cage layers found along a ray when tracing the cage bvh
+	const size_t MaxCageLayers = 16;
+
+	NlstContext::NlstContext() :
+		p_deformation(nullptr),
+		p_sdf(nullptr),
+		p_packetSdf(nullptr),
+		odeTolerance(0.f),
+		broydenMaxSteps(0),
+		broydenTolerance(0.f),
+		p_broydenState(nullptr),
+		VP(1.f),
+		cameraPos(0.f)
+	{}
+
+	BroydenState::BroydenState() :
+		inverseJacobian(1.f),
+		undefPoint(0.f),
+		defPoint(0.f),
+		updates(-1)
+	{}
+
+	glm::mat3 InverseDeformationJacobian(const NlstContext& context, const glm::vec3& undefPoint)
+	{
+		return glm::inverse(context.p_deformation->Jacobian(undefPoint));
+	}
+
+	glm::mat3 BroydenInverseJacobian(const NlstContext& context, BroydenState& state, const glm::vec3& undefPoint)
+	{
+		glm::vec3 defPoint = context.p_deformation->Deform(undefPoint);
+
+		if (state.updates >= 0 && state.updates < context.broydenMaxSteps)
+		{
+			glm::vec3 undefStep = undefPoint - state.undefPoint;
+			glm::vec3 defStep = defPoint - state.defPoint;
+
+			if (undefStep == glm::vec3(0.f))
+				return state.inverseJacobian;
+
+			// the "good" Broyden update in Sherman-Morrison form, H += (s - H y) (s^T H) / (s^T H y),
+			// makes the inverse map the deformed step y back to the undeformed step s
+			glm::vec3 predictedStep = state.inverseJacobian * defStep;
+			float denominator = glm::dot(undefStep, predictedStep);
+			float predictionError = glm::length(predictedStep - undefStep);
+
+			if (predictionError <= context.broydenTolerance * glm::length(undefStep) && glm::abs(denominator) > 1e-12f)
+			{
+				state.inverseJacobian += glm::outerProduct(undefStep - predictedStep, undefStep * state.inverseJacobian) / denominator;
+				state.undefPoint = undefPoint;
+				state.defPoint = defPoint;
+				state.updates++;
+				return state.inverseJacobian;
+			}
+		}
+
+		state.inverseJacobian = InverseDeformationJacobian(context, undefPoint);
+		state.undefPoint = undefPoint;
+		state.defPoint = defPoint;
+		state.updates = 0;
+		return state.inverseJacobian;
+	}
+
+	glm::vec3 UndeformedDirection(const NlstContext& context, const glm::vec3& undefPoint, const glm::vec3& defDirection)
+	{
+		if (context.p_broydenState != nullptr)
+			return glm::normalize(BroydenInverseJacobian(context, *context.p_broydenState, undefPoint) * defDirection);
+
+		return glm::normalize(InverseDeformationJacobian(context, undefPoint) * defDirection);
+	}
+
+	glm::vec3 SolveBS23(
+		const NlstContext& context,
+		const glm::vec3& undefPoint,
+		const glm::vec3& defDirection,
+		float maxRadius,
+		float& distTraveled,
+		uint32_t& stepCount
+	)
+	{
+		// Bogacki-Shampine ODE solver that returns the next undeformed point along the 
+		// deformed ray path
+		const float h = 0.01f;
+		const float c12 = 1.f / 2.f;
+		const float c34 = 3.f / 4.f;
+		const float c29 = 2.f / 9.f;
+		const float c13 = 1.f / 3.f;
+		const float c49 = 4.f / 9.f;
+		const float c724 = 7.f / 24.f;
+		const float c14 = 1.f / 4.f;
+		const float c18 = 1.f / 8.f;
+		const float paddedMaxRadius = maxRadius - h;
+
+		glm::vec3 y1(0.f);
+		glm::vec3 y2(0.f);
+		glm::vec3 y1_next = undefPoint;
+		glm::vec3 k1(0.f);
+		glm::vec3 k2(0.f);
+		glm::vec3 k3(0.f);
+		glm::vec3 k4(0.f);
+		glm::vec3 k1_next = UndeformedDirection(context, undefPoint, defDirection);
+
+		float newDistTraveled = 0.f;
+
+		for (int i = 0; i < 16; i++)
+		{
+			y1 = y1_next;
+			k1 = k1_next;
+
+			k2 = UndeformedDirection(context, y1 + (c12 * h) * k1, defDirection);
+			k3 = UndeformedDirection(context, y1 + (c34 * h) * k2, defDirection);
+			y2 = y1 + (c29 * h) * k1 + (c13 * h) * k2 + (c49 * h) * k3;
+			k4 = UndeformedDirection(context, y2, defDirection);
+			stepCount++;
+
+			newDistTraveled += h;
+			if (newDistTraveled > paddedMaxRadius)
+				break;
+
+			y1_next = y2;
+			k1_next = k4;
+		}
+
+		distTraveled += newDistTraveled;
+
+		return y1 + (c724 * h) * k1 + (c14 * h) * k2 + (c13 * h) * k3 + (c18 * h) * k4;
+	}
+
+	glm::vec3 SolveBS23Adaptive(
+		const NlstContext& context,
+		const glm::vec3& undefPoint,
+		const glm::vec3& defDirection,
+		float maxRadius,
+		float& distTraveled,
+		float& stepSize,
+		uint32_t& stepCount
+	)
+	{
+		// Bogacki-Shampine ODE solver that adapts the step size to the difference between its 
+		// 3rd and embedded 2nd order solutions, the step size is kept between calls along the ray
+		const float c12 = 1.f / 2.f;
+		const float c34 = 3.f / 4.f;
+		const float c29 = 2.f / 9.f;
+		const float c13 = 1.f / 3.f;
+		const float c49 = 4.f / 9.f;
+		const float c724 = 7.f / 24.f;
+		const float c14 = 1.f / 4.f;
+		const float c18 = 1.f / 8.f;
+
+		glm::vec3 y1 = undefPoint;
+		glm::vec3 k1 = UndeformedDirection(context, undefPoint, defDirection);
+		float newDistTraveled = 0.f;
+		float h = stepSize;
+
+		for (int i = 0; i < 16; i++)
+		{
+			// the directions are normalized, so the step size bounds the distance moved
+			float remainingRadius = maxRadius - newDistTraveled;
+			if (remainingRadius < MinOdeStepSize)
+				break;
+
+			h = glm::min(glm::max(h, MinOdeStepSize), remainingRadius);
+
+			glm::vec3 k2 = UndeformedDirection(context, y1 + (c12 * h) * k1, defDirection);
+			glm::vec3 k3 = UndeformedDirection(context, y1 + (c34 * h) * k2, defDirection);
+			glm::vec3 y2 = y1 + (c29 * h) * k1 + (c13 * h) * k2 + (c49 * h) * k3;
+			glm::vec3 k4 = UndeformedDirection(context, y2, defDirection);
+			glm::vec3 z2 = y1 + (c724 * h) * k1 + (c14 * h) * k2 + (c13 * h) * k3 + (c18 * h) * k4;
+			stepCount++;
+
+			float error = glm::distance(y2, z2);
+			float scale = error > 0.f ? glm::clamp(0.9f * glm::pow(context.odeTolerance / error, 1.f / 3.f), 0.2f, 5.f) : 5.f;
+
+			// steps at the min size are taken regardless of the error, so the ray always advances
+			if (error <= context.odeTolerance || h <= MinOdeStepSize)
+			{
+				y1 = y2;
+				k1 = k4;
+				newDistTraveled += h;
+				stepSize = h * scale;
+			}
+
+			h *= scale;
+		}
+
+		distTraveled += newDistTraveled;
+
+		return y1;
+	}
+
+	float OffsetError(float distTraveled)
+	{
+		const float permittedErrorPerLength = 0.001f;
+		return permittedErrorPerLength * distTraveled;
+	}
+
+	glm::vec3 AdjustTerminationPoint(
+		const NlstContext& context,
+		const glm::vec3& undefPoint,
+		const glm::vec3& undefDirection,
+		float distTraveled
+	)
+	{
+		const SdfFunction& sdf = *context.p_sdf;
+		float offset = 0.f;
+
+		for (int i = 0; i < 3; i++)
+			offset += sdf(undefPoint + undefDirection * offset) - OffsetError(distTraveled + offset);
+
+		return undefPoint + undefDirection * offset;
+	}
+
+	glm::vec3 Nlst(
+		const NlstContext& context,
+		const glm::vec3& undefOrigin,
+		const glm::vec3& defDirection,
+		float distToOrigin,
+		float undefPixelRadiusPerLength,
+		float maxDist,
+		float maxRadius,
+		bool& outHit,
+		uint32_t& outStepCount
+	)
+	{
+		// the running inverse Jacobian belongs to this ray
+		BroydenState broydenState;
+		NlstContext broydenContext = context;
+		broydenContext.p_broydenState = &broydenState;
+		const NlstContext& rayContext = context.broydenMaxSteps > 0 ? broydenContext : context;
+
+		const SdfFunction& sdf = *context.p_sdf;
+		float distTraveled = distToOrigin;
+		glm::vec3 undefPoint = undefOrigin;
+		float stepSize = InitialOdeStepSize;
+		outHit = false;
+		outStepCount = 0;
+
+		for (int i = 0; i < 64; i++)
+		{
+			float radius = sdf(undefPoint);
+			float minRadius = undefPixelRadiusPerLength * distTraveled;
+
+			if (radius < minRadius)
+			{
+				outHit = true;
+				break;
+			}
+
+			if (distTraveled > maxDist || radius > maxRadius)
+				break;
+
+			if (radius < minRadius * 3.f)
+			{
+				// use simple euler integration step when the radius is small
+				undefPoint += UndeformedDirection(rayContext, undefPoint, defDirection) * radius;
+				distTraveled += radius;
+				outStepCount++;
+			}
+			else if (context.odeTolerance > 0.f)
+			{
+				undefPoint = SolveBS23Adaptive(rayContext, undefPoint, defDirection, radius, distTraveled, stepSize, outStepCount);
+			}
+			else
+			{
+				undefPoint = SolveBS23(rayContext, undefPoint, defDirection, radius, distTraveled, outStepCount);
+			}
+		}
+
+		if (outHit)
+		{
+			undefPoint = AdjustTerminationPoint(
+				context,
+				undefPoint,
+				UndeformedDirection(rayContext, undefPoint, defDirection),
+				glm::distance(context.cameraPos, context.p_deformation->Deform(undefPoint))
+			);
+		}
+
+		return undefPoint;
+	}
+
+	Simd::Vec3Packet UndeformedDirection(const NlstContext& context, const Simd::Vec3Packet& undefPoints, const Simd::Vec3Packet& defDirections)
+	{
+		Simd::Mat3Packet invJacobian = Simd::Inverse(context.p_deformation->Jacobian(undefPoints));
+		return Simd::Normalize(invJacobian * defDirections);
+	}
+
+	void SolveBS23(
+		const NlstContext& context,
+		Simd::Vec3Packet& undefPoints,
+		const Simd::Vec3Packet& defDirections,
+		const Simd::FloatPacket& maxRadii,
+		Simd::FloatPacket& distTraveled,
+		Simd::FloatPacket& stepCounts,
+		const Simd::Vec3Packet& startDirections,
+		const Simd::MaskPacket& mask
+	)
+	{
+		// same as the scalar version, lanes stop advancing once they have covered their radius
+		using namespace Simd;
+
+		const float h = 0.01f;
+		const float c12 = 1.f / 2.f;
+		const float c34 = 3.f / 4.f;
+		const float c29 = 2.f / 9.f;
+		const float c13 = 1.f / 3.f;
+		const float c49 = 4.f / 9.f;
+		const float c724 = 7.f / 24.f;
+		const float c14 = 1.f / 4.f;
+		const float c18 = 1.f / 8.f;
+		const FloatPacket paddedMaxRadii = maxRadii - h;
+
+		Vec3Packet y1 = undefPoints;
+		Vec3Packet y2 = undefPoints;
+		Vec3Packet y1_next = undefPoints;
+		Vec3Packet k1 = startDirections;
+		Vec3Packet k2 = startDirections;
+		Vec3Packet k3 = startDirections;
+		Vec3Packet k4 = startDirections;
+		Vec3Packet k1_next = startDirections;
+
+		FloatPacket newDistTraveled(0.f);
+		MaskPacket running = mask;
+
+		for (int i = 0; i < 16 && Any(running); i++)
+		{
+			y1 = Select(running, y1_next, y1);
+			k1 = Select(running, k1_next, k1);
+
+			Vec3Packet newK2 = UndeformedDirection(context, y1 + k1 * (c12 * h), defDirections);
+			Vec3Packet newK3 = UndeformedDirection(context, y1 + newK2 * (c34 * h), defDirections);
+			Vec3Packet newY2 = y1 + k1 * (c29 * h) + newK2 * (c13 * h) + newK3 * (c49 * h);
+			Vec3Packet newK4 = UndeformedDirection(context, newY2, defDirections);
+
+			k2 = Select(running, newK2, k2);
+			k3 = Select(running, newK3, k3);
+			y2 = Select(running, newY2, y2);
+			k4 = Select(running, newK4, k4);
+			stepCounts = Select(running, stepCounts + 1.f, stepCounts);
+
+			newDistTraveled = Select(running, newDistTraveled + h, newDistTraveled);
+			running = AndNot(running, newDistTraveled > paddedMaxRadii);
+
+			y1_next = Select(running, y2, y1_next);
+			k1_next = Select(running, k4, k1_next);
+		}
+
+		distTraveled = Select(mask, distTraveled + newDistTraveled, distTraveled);
+
+		Vec3Packet result = y1 + k1 * (c724 * h) + k2 * (c14 * h) + k3 * (c13 * h) + k4 * (c18 * h);
+		undefPoints = Select(mask, result, undefPoints);
+	}
+
+	void SolveBS23Adaptive(
+		const NlstContext& context,
+		Simd::Vec3Packet& undefPoints,
+		const Simd::Vec3Packet& defDirections,
+		const Simd::FloatPacket& maxRadii,
+		Simd::FloatPacket& distTraveled,
+		Simd::FloatPacket& stepSizes,
+		Simd::FloatPacket& stepCounts,
+		const Simd::Vec3Packet& startDirections,
+		const Simd::MaskPacket& mask
+	)
+	{
+		// same as the scalar version, each lane adapts its own step size
+		using namespace Simd;
+
+		const float c12 = 1.f / 2.f;
+		const float c34 = 3.f / 4.f;
+		const float c29 = 2.f / 9.f;
+		const float c13 = 1.f / 3.f;
+		const float c49 = 4.f / 9.f;
+		const float c724 = 7.f / 24.f;
+		const float c14 = 1.f / 4.f;
+		const float c18 = 1.f / 8.f;
+		const FloatPacket minStepSize(MinOdeStepSize);
+		const FloatPacket tolerance(context.odeTolerance);
+
+		Vec3Packet y1 = undefPoints;
+		Vec3Packet k1 = startDirections;
+		FloatPacket newDistTraveled(0.f);
+		FloatPacket h = stepSizes;
+		MaskPacket running = mask;
+
+		for (int i = 0; i < 16; i++)
+		{
+			FloatPacket remainingRadii = maxRadii - newDistTraveled;
+			running = AndNot(running, remainingRadii < minStepSize);
+			if (!Any(running))
+				break;
+
+			h = Min(Max(h, minStepSize), remainingRadii);
+
+			Vec3Packet k2 = UndeformedDirection(context, y1 + k1 * (c12 * h), defDirections);
+			Vec3Packet k3 = UndeformedDirection(context, y1 + k2 * (c34 * h), defDirections);
+			Vec3Packet y2 = y1 + k1 * (c29 * h) + k2 * (c13 * h) + k3 * (c49 * h);
+			Vec3Packet k4 = UndeformedDirection(context, y2, defDirections);
+			Vec3Packet z2 = y1 + k1 * (c724 * h) + k2 * (c14 * h) + k3 * (c13 * h) + k4 * (c18 * h);
+			stepCounts = Select(running, stepCounts + 1.f, stepCounts);
+
+			FloatPacket errors = Length(y2 - z2);
+			FloatPacket scales(5.f);
+			for (size_t lane = 0; lane < Width; lane++)
+			{
+				float error = GetLane(errors, lane);
+				if (error > 0.f)
+					SetLane(scales, lane, glm::clamp(0.9f * glm::pow(context.odeTolerance / error, 1.f / 3.f), 0.2f, 5.f));
+			}
+
+			MaskPacket accepted = running & (AndNot(AllLanes(), errors > tolerance) | AndNot(AllLanes(), h > minStepSize));
+			y1 = Select(accepted, y2, y1);
+			k1 = Select(accepted, k4, k1);
+			newDistTraveled = Select(accepted, newDistTraveled + h, newDistTraveled);
+			stepSizes = Select(accepted, h * scales, stepSizes);
+
+			h = Select(running, h * scales, h);
+		}
+
+		distTraveled = Select(mask, distTraveled + newDistTraveled, distTraveled);
+		undefPoints = Select(mask, y1, undefPoints);
+	}
+
+	glm::vec3 WorldSdfGradient(const NlstContext& context, const glm::vec3& undefPoint)
+	{
+		const SdfFunction& sdf = *context.p_sdf;
+		const float step = 0.0001f;
+		const glm::vec3 xyy(1.f, -1.f, -1.f);
+		const glm::vec3 yyx(-1.f, -1.f, 1.f);
+		const glm::vec3 yxy(-1.f, 1.f, -1.f);
+		const glm::vec3 xxx(1.f, 1.f, 1.f);
+
+		glm::vec3 undefGradient =
+			xyy * sdf(undefPoint + xyy * step) +
+			yyx * sdf(undefPoint + yyx * step) +
+			yxy * sdf(undefPoint + yxy * step) +
+			xxx * sdf(undefPoint + xxx * step);
+
+		glm::mat3 invJacobian = InverseDeformationJacobian(context, undefPoint);
+		glm::vec3 defGradient = glm::transpose(invJacobian) * undefGradient;
+
+		return glm::normalize(defGradient);
+	}
+
+	glm::vec3 DeformationColor(const NlstContext& context, const glm::vec3& undefPoint)
+	{
+		const float spectrumScale = 2.f;
+		float deformAmount = glm::distance(undefPoint, context.p_deformation->Deform(undefPoint));
+		deformAmount = glm::min(deformAmount / spectrumScale, 1.f);
+
+		const glm::vec3 blue(0.2f, 0.f, 1.f);
+		const glm::vec3 green(0.f, 1.f, 0.2f);
+		const glm::vec3 yellow(1.f, 1.f, 0.f);
+		const glm::vec3 red(1.f, 0.f, 0.f);
+
+		glm::vec3 color = glm::mix(blue, green, glm::smoothstep(0.f, 0.33f, deformAmount));
+		color = glm::mix(color, yellow, glm::smoothstep(0.33f, 0.66f, deformAmount));
+		color = glm::mix(color, red, glm::smoothstep(0.66f, 1.f, deformAmount));
+		return color;
+	}
+
+	glm::vec3 Shade(const NlstContext& context, const glm::vec3& undefHitPoint, const glm::vec3& defDirection, const glm::vec3& lightDir)
+	{
+		glm::vec3 normal = WorldSdfGradient(context, undefHitPoint);
+		float diff = glm::max(0.f, glm::dot(normal, -lightDir));
+		float spec = glm::pow(glm::max(0.f, glm::dot(glm::reflect(defDirection, normal), -lightDir)), 32.f);
+
+		glm::vec3 ambientColor(0.1f, 0.1f, 0.2f);
+		glm::vec3 lightColor(1.f, 0.9f, 0.7f);
+		glm::vec3 albedo = DeformationColor(context, undefHitPoint);
+
+		return albedo * (ambientColor + lightColor * (diff + spec));
+	}
+
+	float DeformedPointToDepth(const NlstContext& context, const glm::vec3& defPoint)
+	{
+		glm::vec4 clipPoint = context.VP * glm::vec4(defPoint, 1.f);
+		return (clipPoint.z / clipPoint.w + 1.f) * 0.5f;
+	}
+
+	// point on the edge from vertex a to vertex b, always interpolated from the vertex with the lowest 
+	// index so that triangles sharing the edge get bitwise equal points and no cracks
+	glm::vec3 CageEdgePoint(const glm::vec3* p_positions, const GLuint* p_indices, int a, int b, size_t step, size_t steps)
+	{
+		if (p_indices[a] > p_indices[b])
+		{
+			std::swap(a, b);
+			step = steps - step;
+		}
+
+		if (step == 0)
+			return p_positions[a];
+		if (step == steps)
+			return p_positions[b];
+
+		return p_positions[a] + (p_positions[b] - p_positions[a]) * (float(step) / float(steps));
+	}
+
+	float EdgeFunction(const glm::vec3& a, const glm::vec3& b, const glm::vec2& p)
+	{
+		return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+	}
+
+
+	// start values of a ray from a cage fragment, like the start of main in deform_frag.glsl
+	struct NlstRay
+	{
+		glm::vec3 undefOrigin;
+		glm::vec3 defDirection;
+		float distToOrigin;
+		float maxDist;
+		float undefPixelRadiusPerLength;
+	};
+
+	NlstRay SetupRay(const NlstContext& context, const NlstRenderSettings& settings, const glm::vec3& undefOrigin, float pixelRadiusPerLength)
+	{
+		NlstRay ray;
+		ray.undefOrigin = undefOrigin;
+		glm::vec3 defOrigin = context.p_deformation->Deform(undefOrigin);
+		ray.defDirection = defOrigin - context.cameraPos;
+		ray.distToOrigin = glm::length(ray.defDirection);
+		ray.defDirection *= 1.f / ray.distToOrigin;
+		ray.maxDist = ray.distToOrigin + settings.maxDistanceFromSurface;
+		ray.undefPixelRadiusPerLength =
+			pixelRadiusPerLength * glm::pow(glm::determinant(InverseDeformationJacobian(context, undefOrigin)), 0.333f);
+
+		return ray;
+	}
+
+	// depth tests a hit and shades it unless shading is deferred, returns true if it is the closest so far
+	bool WriteHit(
+		const NlstContext& context, 
+		const NlstRenderSettings& settings, 
+		const glm::vec3& undefHitPoint, 
+		const glm::vec3& defDirection, 
+		size_t pixelIndex, 
+		float& closestDepth, 
+		NlstRenderTarget& outTarget
+	)
+	{
+		float depth = DeformedPointToDepth(context, context.p_deformation->Deform(undefHitPoint));
+		if (depth >= closestDepth)
+			return false;
+
+		closestDepth = depth;
+		outTarget.hits[pixelIndex] = 1;
+		outTarget.depths[pixelIndex] = depth;
+		outTarget.hitPoints[pixelIndex] = undefHitPoint;
+
+		if (!settings.deferredShading)
+			outTarget.colors[pixelIndex] = Shade(context, undefHitPoint, defDirection, settings.lightDirection);
+
+		return true;
+	}
+
+	NlstRenderer::NlstRenderer(ThreadPool& _threadPool) :
+		threadPool(_threadPool)
+	{}
+
+	void NlstRenderer::SetCage(const std::vector<glm::vec3>& cagePositions, const std::vector<GLuint>& cageIndices)
+	{
+		cageBvh.Build(cagePositions, cageIndices);
+	}
+
+	void NlstRenderer::Render(
+		const Camera& camera,
+		const glm::mat4& cameraTransform,
+		const BindPose* p_bindPose,
+		const AnimationPose* p_animationPose,
+		size_t jointCount,
+		const SdfFunction& sdf,
+		const PacketSdfFunction& packetSdf,
+		const std::vector<glm::vec3>& cagePositions,
+		const std::vector<GLuint>& cageIndices,
+		const NlstRenderSettings& settings,
+		NlstRenderTarget& outTarget
+	)
+	{
+		outTarget.Clear(settings.clearColor);
+		deformation.SetPose(p_bindPose, p_animationPose, jointCount);
+
+		NlstContext context;
+		context.p_deformation = &deformation;
+		context.p_sdf = &sdf;
+		context.odeTolerance = settings.odeTolerance;
+		context.broydenMaxSteps = settings.broydenMaxSteps;
+		context.broydenTolerance = settings.broydenTolerance;
+
+		// without a packet sdf the lanes are evaluated one by one
+		PacketSdfFunction laneSdf = [&sdf](const Simd::Vec3Packet& points)
+		{
+			Simd::FloatPacket distances;
+			for (size_t lane = 0; lane < Simd::Width; lane++)
+				Simd::SetLane(distances, lane, sdf(Simd::GetLane(points, lane)));
+
+			return distances;
+		};
+		context.p_packetSdf = packetSdf ? &packetSdf : &laneSdf;
+
+		glm::mat4 P = camera.CalcP();
+		glm::mat4 invP = glm::inverse(P);
+		context.VP = P * camera.CalcV(cameraTransform);
+		context.cameraPos = cameraTransform[3];
+		glm::mat4 invVP = glm::inverse(context.VP);
+
+		// same pixel radius as for the gpu
+		glm::vec2 screenSize((float)outTarget.width, (float)outTarget.height);
+		glm::vec4 nearPlaneBottomLeft = invP * glm::vec4(-1.f, -1.f, -1.f, 1.f);
+		glm::vec4 nearPlaneTopRight = invP * glm::vec4(1.f, 1.f, -1.f, 1.f);
+		glm::vec2 nearPlaneWorldSize(
+			nearPlaneTopRight.x - nearPlaneBottomLeft.x,
+			nearPlaneTopRight.y - nearPlaneBottomLeft.y
+		);
+		float pixelRadius = glm::length(nearPlaneWorldSize / screenSize) * 0.5f;
+
+		// the cage fragments of a pixel come from tracing the refit bvh, or from rasterizing the subdivided cage
+		const bool useCageBvh = settings.useCageBvh && cageBvh.TriangleCount() > 0;
+
+		if (useCageBvh)
+			cageBvh.Refit(deformation, threadPool);
+
+		// subdivide and deform the cage, (i, j) are the steps from vertex 0 towards vertex 1 and 2
+		const size_t subdivisions = glm::clamp(settings.cageSubdivisions, (size_t)1, (size_t)16);
+		const size_t gridWidth = subdivisions + 1;
+		const size_t subTriangleCount = subdivisions * subdivisions;
+		const size_t triangleCount = useCageBvh ? 0 : cageIndices.size() / 3;
+		cageTriangles.resize(triangleCount * subTriangleCount);
+
+		threadPool.ParallelFor(triangleCount, [&](size_t triangleIndex, size_t)
+		{
+			const GLuint* p_indices = &cageIndices[triangleIndex * 3];
+			glm::vec3 corners[3] = { cagePositions[p_indices[0]], cagePositions[p_indices[1]], cagePositions[p_indices[2]] };
+
+			glm::vec3 undeformedGrid[17 * 17];
+			glm::vec4 clipGrid[17 * 17];
+
+			for (size_t i = 0; i <= subdivisions; i++)
+			{
+				for (size_t j = 0; i + j <= subdivisions; j++)
+				{
+					glm::vec3 point;
+					if (j == 0)
+						point = CageEdgePoint(corners, p_indices, 0, 1, i, subdivisions);
+					else if (i == 0)
+						point = CageEdgePoint(corners, p_indices, 0, 2, j, subdivisions);
+					else if (i + j == subdivisions)
+						point = CageEdgePoint(corners, p_indices, 1, 2, j, subdivisions);
+					else
+					{
+						float w1 = float(i) / float(subdivisions);
+						float w2 = float(j) / float(subdivisions);
+						point = corners[0] * (1.f - w1 - w2) + corners[1] * w1 + corners[2] * w2;
+					}
+
+					undeformedGrid[i * gridWidth + j] = point;
+					clipGrid[i * gridWidth + j] = context.VP * glm::vec4(deformation.Deform(point), 1.f);
+				}
+			}
+
+			CageTriangle* p_triangles = &cageTriangles[triangleIndex * subTriangleCount];
+			size_t subTriangleIndex = 0;
+
+			auto addTriangle = [&](size_t a, size_t b, size_t c)
+			{
+				CageTriangle& triangle = p_triangles[subTriangleIndex++];
+				size_t gridIndices[3] = { a, b, c };
+				triangle.isVisible = true;
+
+				for (size_t k = 0; k < 3; k++)
+				{
+					const glm::vec4& clipPos = clipGrid[gridIndices[k]];
+
+					// no clipping, triangles crossing the near plane are skipped
+					if (clipPos.w <= 0.f || clipPos.z < -clipPos.w)
+						triangle.isVisible = false;
+
+					float invW = 1.f / clipPos.w;
+					glm::vec3 ndc = glm::vec3(clipPos) * invW;
+					triangle.windowPositions[k] = glm::vec3((glm::vec2(ndc) * 0.5f + 0.5f) * screenSize, ndc.z);
+					triangle.invW[k] = invW;
+					triangle.undeformedPositions[k] = undeformedGrid[gridIndices[k]];
+				}
+
+				// cull back faces like the gpu, front faces are counter clockwise
+				if (EdgeFunction(triangle.windowPositions[0], triangle.windowPositions[1], triangle.windowPositions[2]) <= 0.f)
+					triangle.isVisible = false;
+			};
+
+			for (size_t i = 0; i < subdivisions; i++)
+			{
+				for (size_t j = 0; i + j < subdivisions; j++)
+				{
+					addTriangle(i * gridWidth + j, (i + 1) * gridWidth + j, i * gridWidth + j + 1);
+
+					if (i + j + 1 < subdivisions)
+						addTriangle((i + 1) * gridWidth + j, (i + 1) * gridWidth + j + 1, i * gridWidth + j + 1);
+				}
+			}
+		});
+
+		// bin the visible triangles into screen tiles
+		const size_t tileSize = glm::max(settings.tileSize, (size_t)1);
+		const size_t tilesX = (outTarget.width + tileSize - 1) / tileSize;
+		const size_t tilesY = (outTarget.height + tileSize - 1) / tileSize;
+		tileTriangles.resize(tilesX * tilesY);
+
+		for (std::vector<size_t>& triangles : tileTriangles)
+			triangles.clear();
+
+		for (size_t i = 0; i < cageTriangles.size(); i++)
+		{
+			const CageTriangle& triangle = cageTriangles[i];
+			if (!triangle.isVisible)
+				continue;
+
+			glm::vec2 min = glm::min(glm::min(glm::vec2(triangle.windowPositions[0]), glm::vec2(triangle.windowPositions[1])), glm::vec2(triangle.windowPositions[2]));
+			glm::vec2 max = glm::max(glm::max(glm::vec2(triangle.windowPositions[0]), glm::vec2(triangle.windowPositions[1])), glm::vec2(triangle.windowPositions[2]));
+
+			if (max.x < 0.f || max.y < 0.f || min.x >= screenSize.x || min.y >= screenSize.y)
+				continue;
+
+			// clamped before the casts, converting floats out of the range of size_t is undefined
+			min = glm::clamp(min, glm::vec2(0.f), glm::vec2(screenSize));
+			max = glm::clamp(max, glm::vec2(0.f), glm::vec2(screenSize));
+			size_t minTileX = (size_t)min.x / tileSize;
+			size_t minTileY = (size_t)min.y / tileSize;
+			size_t maxTileX = glm::min((size_t)max.x / tileSize, tilesX - 1);
+			size_t maxTileY = glm::min((size_t)max.y / tileSize, tilesY - 1);
+
+			for (size_t y = minTileY; y <= maxTileY; y++)
+				for (size_t x = minTileX; x <= maxTileX; x++)
+					tileTriangles[y * tilesX + x].push_back(i);
+		}
+
+		threadScratch.resize(threadPool.ThreadCount());
+
+		// tiles differ a lot in cost, which the work stealing of the thread pool evens out
+		threadPool.ParallelFor(tilesX * tilesY, [&](size_t tileIndex, size_t threadIndex)
+		{
+			TileScratch& scratch = threadScratch[threadIndex];
+			const std::vector<size_t>& triangles = tileTriangles[tileIndex];
+
+			if (triangles.empty() && !useCageBvh)
+				return;
+
+			scratch.fragments.clear();
+			scratch.pixels.clear();
+
+			size_t startX = (tileIndex % tilesX) * tileSize;
+			size_t startY = (tileIndex / tilesX) * tileSize;
+			size_t endX = glm::min(startX + tileSize, outTarget.width);
+			size_t endY = glm::min(startY + tileSize, outTarget.height);
+
+			// adds the pixel of the fragments from fragmentsStart to the end of the scratch, if there are any
+			auto addPixel = [&](size_t x, size_t y, size_t fragmentsStart)
+			{
+				if (scratch.fragments.size() == fragmentsStart)
+					return;
+
+				// a trace never hits in front of the cage fragment it started from, so tracing front to
+				// back can stop at the first fragment behind the closest hit, like the depth test
+				std::sort(
+					scratch.fragments.begin() + fragmentsStart, 
+					scratch.fragments.end(), 
+					[](const Fragment& a, const Fragment& b) { return a.depth < b.depth; }
+				);
+
+				glm::vec2 pixelUV = glm::vec2((float)x + 0.5f, (float)y + 0.5f) / screenSize;
+				glm::vec4 pixelWorldPos = invVP * glm::vec4(pixelUV * 2.f - 1.f, -1.f, 1.f);
+				float distToPixel = glm::distance(glm::vec3(pixelWorldPos) / pixelWorldPos.w, context.cameraPos);
+
+				PixelFragments pixel;
+				pixel.pixelIndex = y * outTarget.width + x;
+				pixel.fragmentsStart = fragmentsStart;
+				pixel.fragmentsEnd = scratch.fragments.size();
+				pixel.nextFragment = fragmentsStart;
+				pixel.pixelRadiusPerLength = pixelRadius / distToPixel;
+				pixel.closestDepth = 1.f;
+				scratch.pixels.push_back(pixel);
+			};
+
+			if (useCageBvh)
+			{
+				for (size_t y = startY; y < endY; y++)
+				{
+					for (size_t x = startX; x < endX; x += Simd::Width)
+					{
+						size_t laneCount = glm::min(endX - x, Simd::Width);
+						Simd::Vec3Packet origins(context.cameraPos);
+						Simd::Vec3Packet directions(glm::vec3(0.f, 0.f, 1.f));
+
+						for (size_t lane = 0; lane < laneCount; lane++)
+						{
+							glm::vec2 pixelUV = glm::vec2((float)(x + lane) + 0.5f, (float)y + 0.5f) / screenSize;
+							glm::vec4 pixelWorldPos = invVP * glm::vec4(pixelUV * 2.f - 1.f, -1.f, 1.f);
+							Simd::SetLane(directions, lane, glm::normalize(glm::vec3(pixelWorldPos) / pixelWorldPos.w - context.cameraPos));
+						}
+
+						// the front facing cage layers along each ray, front to back
+						Fragment laneFragments[Simd::Width][MaxCageLayers];
+						size_t laneFragmentCounts[Simd::Width] = {};
+						Simd::FloatPacket minDistances(0.f);
+						Simd::MaskPacket activeLanes = Simd::MaskFromBits((1u << laneCount) - 1);
+
+						for (size_t layer = 0; layer < MaxCageLayers && Simd::Any(activeLanes); layer++)
+						{
+							Simd::FloatPacket distances;
+							Simd::Vec3Packet undefPositions;
+							activeLanes = cageBvh.IntersectClosest(origins, directions, minDistances, activeLanes, distances, undefPositions);
+							// a bit beyond the hit, so that a ray through a shared edge does not find it twice
+							minDistances = distances * Simd::FloatPacket(1.0001f);
+							uint32_t hitBits = Simd::Bits(activeLanes);
+
+							for (size_t lane = 0; lane < laneCount; lane++)
+							{
+								if (((hitBits >> lane) & 1u) == 0)
+									continue;
+
+								glm::vec3 defPoint = context.cameraPos + Simd::GetLane(directions, lane) * Simd::GetLane(distances, lane);
+								glm::vec4 clipPoint = context.VP * glm::vec4(defPoint, 1.f);
+								float ndcDepth = clipPoint.z / clipPoint.w;
+
+								if (ndcDepth < -1.f || ndcDepth > 1.f)
+									continue;
+
+								Fragment& fragment = laneFragments[lane][laneFragmentCounts[lane]++];
+								fragment.depth = ndcDepth * 0.5f + 0.5f;
+								fragment.undeformedPos = Simd::GetLane(undefPositions, lane);
+							}
+						}
+
+						for (size_t lane = 0; lane < laneCount; lane++)
+						{
+							size_t fragmentsStart = scratch.fragments.size();
+							scratch.fragments.insert(scratch.fragments.end(), laneFragments[lane], laneFragments[lane] + laneFragmentCounts[lane]);
+							addPixel(x + lane, y, fragmentsStart);
+						}
+					}
+				}
+			}
+			else
+			{
+				for (size_t y = startY; y < endY; y++)
+				{
+					for (size_t x = startX; x < endX; x++)
+					{
+						glm::vec2 pixelCenter((float)x + 0.5f, (float)y + 0.5f);
+						size_t fragmentsStart = scratch.fragments.size();
+
+						for (size_t triangleIndex : triangles)
+						{
+							const CageTriangle& triangle = cageTriangles[triangleIndex];
+							const glm::vec3* p_window = triangle.windowPositions;
+
+							float area = EdgeFunction(p_window[0], p_window[1], p_window[2]);
+							float b0 = EdgeFunction(p_window[1], p_window[2], pixelCenter);
+							float b1 = EdgeFunction(p_window[2], p_window[0], pixelCenter);
+							float b2 = EdgeFunction(p_window[0], p_window[1], pixelCenter);
+
+							if (b0 < 0.f || b1 < 0.f || b2 < 0.f)
+								continue;
+
+							b0 /= area;
+							b1 /= area;
+							b2 /= area;
+
+							float ndcDepth = b0 * p_window[0].z + b1 * p_window[1].z + b2 * p_window[2].z;
+							if (ndcDepth < -1.f || ndcDepth > 1.f)
+								continue;
+
+							// perspective correct interpolation of the undeformed position
+							float p0 = b0 * triangle.invW[0];
+							float p1 = b1 * triangle.invW[1];
+							float p2 = b2 * triangle.invW[2];
+
+							Fragment fragment;
+							fragment.depth = ndcDepth * 0.5f + 0.5f;
+							fragment.undeformedPos =
+								(triangle.undeformedPositions[0] * p0 +
+								triangle.undeformedPositions[1] * p1 +
+								triangle.undeformedPositions[2] * p2) / (p0 + p1 + p2);
+							scratch.fragments.push_back(fragment);
+						}
+
+						addPixel(x, y, fragmentsStart);
+					}
+				}
+			}
+
+			// the packet path has no per lane Broyden state, so it always evaluates the inverse Jacobian
+			if (settings.usePackets && settings.broydenMaxSteps == 0)
+				TracePixelPackets(context, settings, scratch, outTarget);
+			else
+				TracePixels(context, settings, scratch, outTarget);
+		});
+
+		if (settings.deferredShading)
+			ShadeHits(context, settings, invVP, outTarget);
+	}
+
+	void NlstRenderer::ShadeHits(const NlstContext& context, const NlstRenderSettings& settings, const glm::mat4& invVP, NlstRenderTarget& outTarget) const
+	{
+		glm::vec2 screenSize((float)outTarget.width, (float)outTarget.height);
+
+		threadPool.ParallelFor(outTarget.height, [&](size_t y, size_t)
+		{
+			for (size_t x = 0; x < outTarget.width; x++)
+			{
+				size_t pixelIndex = y * outTarget.width + x;
+				if (outTarget.hits[pixelIndex] == 0)
+					continue;
+
+				// the deformed ray direction through the pixel center
+				glm::vec2 pixelUV = glm::vec2((float)x + 0.5f, (float)y + 0.5f) / screenSize;
+				glm::vec4 pixelWorldPos = invVP * glm::vec4(pixelUV * 2.f - 1.f, -1.f, 1.f);
+				glm::vec3 defDirection = glm::normalize(glm::vec3(pixelWorldPos) / pixelWorldPos.w - context.cameraPos);
+
+				outTarget.colors[pixelIndex] = Shade(context, outTarget.hitPoints[pixelIndex], defDirection, settings.lightDirection);
+			}
+		});
+	}
+
+	void NlstRenderer::TracePixels(const NlstContext& context, const NlstRenderSettings& settings, TileScratch& scratch, NlstRenderTarget& outTarget) const
+	{
+		for (PixelFragments& pixel : scratch.pixels)
+		{
+			for (size_t i = pixel.fragmentsStart; i < pixel.fragmentsEnd; i++)
+			{
+				const Fragment& fragment = scratch.fragments[i];
+				if (fragment.depth >= pixel.closestDepth)
+					break;
+
+				NlstRay ray = SetupRay(context, settings, fragment.undeformedPos, pixel.pixelRadiusPerLength);
+
+				bool hit = false;
+				uint32_t stepCount = 0;
+				glm::vec3 undefHitPoint = Nlst(
+					context,
+					ray.undefOrigin,
+					ray.defDirection,
+					ray.distToOrigin,
+					ray.undefPixelRadiusPerLength,
+					ray.maxDist,
+					settings.maxRadius,
+					hit,
+					stepCount
+				);
+
+				outTarget.steps[pixel.pixelIndex] += stepCount;
+
+				if (hit)
+					WriteHit(context, settings, undefHitPoint, ray.defDirection, pixel.pixelIndex, pixel.closestDepth, outTarget);
+			}
+		}
+	}
+
+	void NlstRenderer::TracePixelPackets(const NlstContext& context, const NlstRenderSettings& settings, TileScratch& scratch, NlstRenderTarget& outTarget) const
+	{
+		// the loop of Nlst over Simd::Width rays at once, rays that hit or exit are masked out and
+		// their lane is refilled with the next fragment, so the packets stay full until the tile runs dry
+		using namespace Simd;
+
+		const PacketSdfFunction& packetSdf = *context.p_packetSdf;
+
+		Vec3Packet undefPoints;
+		Vec3Packet defDirections;
+		FloatPacket distTraveled;
+		FloatPacket maxDists;
+		FloatPacket undefPixelRadiiPerLength;
+		FloatPacket iterations;
+		FloatPacket stepSizes;
+		FloatPacket stepCounts;
+		size_t lanePixels[Width];
+		uint32_t activeLanes = 0;
+		size_t nextPixel = 0;
+
+		// starts the next fragment of a pixel in the lane, if it can still be in front of the closest hit
+		auto startFragment = [&](size_t lane, size_t pixelIndex)
+		{
+			PixelFragments& pixel = scratch.pixels[pixelIndex];
+
+			if (pixel.nextFragment == pixel.fragmentsEnd)
+				return false;
+
+			const Fragment& fragment = scratch.fragments[pixel.nextFragment++];
+			if (fragment.depth >= pixel.closestDepth)
+			{
+				pixel.nextFragment = pixel.fragmentsEnd;
+				return false;
+			}
+
+			NlstRay ray = SetupRay(context, settings, fragment.undeformedPos, pixel.pixelRadiusPerLength);
+			SetLane(undefPoints, lane, ray.undefOrigin);
+			SetLane(defDirections, lane, ray.defDirection);
+			SetLane(distTraveled, lane, ray.distToOrigin);
+			SetLane(maxDists, lane, ray.maxDist);
+			SetLane(undefPixelRadiiPerLength, lane, ray.undefPixelRadiusPerLength);
+			SetLane(iterations, lane, 0.f);
+			SetLane(stepSizes, lane, InitialOdeStepSize);
+			SetLane(stepCounts, lane, 0.f);
+			lanePixels[lane] = pixelIndex;
+			return true;
+		};
+
+		// a pixel keeps its lane until its fragments are done, then the lane moves on to the next pixel
+		auto refillLane = [&](size_t lane, bool continuePixel)
+		{
+			if (continuePixel && startFragment(lane, lanePixels[lane]))
+				return true;
+
+			while (nextPixel < scratch.pixels.size())
+			{
+				if (startFragment(lane, nextPixel++))
+					return true;
+			}
+
+			return false;
+		};
+
+		for (size_t lane = 0; lane < Width; lane++)
+		{
+			if (refillLane(lane, false))
+				activeLanes |= 1u << lane;
+		}
+
+		while (activeLanes != 0)
+		{
+			MaskPacket active = MaskFromBits(activeLanes);
+
+			FloatPacket radii = packetSdf(undefPoints);
+			FloatPacket minRadii = undefPixelRadiiPerLength * distTraveled;
+
+			MaskPacket hits = active & (radii < minRadii);
+			MaskPacket exits = AndNot(active, hits) & ((distTraveled > maxDists) | (radii > FloatPacket(settings.maxRadius)));
+			MaskPacket steps = AndNot(AndNot(active, hits), exits);
+
+			if (Any(steps))
+			{
+				Vec3Packet directions = UndeformedDirection(context, undefPoints, defDirections);
+
+				// euler steps when the radius is small, otherwise the ode solver
+				MaskPacket eulerSteps = steps & (radii < minRadii * 3.f);
+				undefPoints = Select(eulerSteps, undefPoints + directions * radii, undefPoints);
+				distTraveled = Select(eulerSteps, distTraveled + radii, distTraveled);
+				stepCounts = Select(eulerSteps, stepCounts + 1.f, stepCounts);
+
+				MaskPacket solverSteps = AndNot(steps, eulerSteps);
+				if (Any(solverSteps) && context.odeTolerance > 0.f)
+					SolveBS23Adaptive(context, undefPoints, defDirections, radii, distTraveled, stepSizes, stepCounts, directions, solverSteps);
+				else if (Any(solverSteps))
+					SolveBS23(context, undefPoints, defDirections, radii, distTraveled, stepCounts, directions, solverSteps);
+
+				iterations = Select(steps, iterations + 1.f, iterations);
+			}
+
+			MaskPacket exhausted = steps & (iterations >= FloatPacket(64.f));
+			uint32_t hitLanes = Bits(hits);
+			uint32_t retiredLanes = Bits(hits | exits | exhausted);
+
+			for (size_t lane = 0; lane < Width; lane++)
+			{
+				if (((retiredLanes >> lane) & 1u) == 0)
+					continue;
+
+				PixelFragments& pixel = scratch.pixels[lanePixels[lane]];
+				outTarget.steps[pixel.pixelIndex] += (uint32_t)GetLane(stepCounts, lane);
+
+				if ((hitLanes >> lane) & 1u)
+				{
+					glm::vec3 defDirection = GetLane(defDirections, lane);
+					glm::vec3 undefPoint = GetLane(undefPoints, lane);
+					undefPoint = AdjustTerminationPoint(
+						context,
+						undefPoint,
+						UndeformedDirection(context, undefPoint, defDirection),
+						glm::distance(context.cameraPos, context.p_deformation->Deform(undefPoint))
+					);
+
+					WriteHit(context, settings, undefPoint, defDirection, pixel.pixelIndex, pixel.closestDepth, outTarget);
+				}
+
+				if (!refillLane(lane, true))
+					activeLanes &= ~(1u << lane);
+			}
+		}
+	}
+}
\ No newline at end of file
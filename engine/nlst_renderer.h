@@ -0,0 +1,160 @@
+#pragma once
+#include "camera.h"
+#include "deformation.h"
+#include "sampled_sdf.h"
+#include "thread_pool.h"
+#include "cage_bvh.h"
+#include <GL/glew.h>
+#include <mat4x4.hpp>
+
+namespace Engine
+{
+	struct NlstRenderSettings
+	{
+		float maxDistanceFromSurface;
+		float maxRadius;
+		size_t cageSubdivisions;// per cage edge, like a fixed tessellation level
+		size_t tileSize;
+		glm::vec3 lightDirection;
+		glm::vec3 clearColor;
+		float odeTolerance;// adapts the ODE step size to this error if above 0, otherwise fixed steps
+		bool usePackets;// trace Simd::Width rays at a time, otherwise one by one
+		bool deferredShading;// shade the closest hit of each pixel after tracing, otherwise every closer hit when it is found
+		int broydenMaxSteps;// Broyden updates of a ray's inverse Jacobian before it is evaluated again, 0 to always evaluate it
+		float broydenTolerance;// max relative error of the updated inverse Jacobian's prediction of a step
+		bool useCageBvh;// find the cage fragments of a pixel by tracing the cage set with SetCage, instead of rasterizing the subdivided cage
+
+		NlstRenderSettings();
+	};
+
+	// per pixel results, rows are ordered from bottom to top like OpenGL framebuffers
+	struct NlstRenderTarget
+	{
+		size_t width;
+		size_t height;
+		std::vector<uint8_t> hits;
+		std::vector<float> depths;// window space depth like gl_FragDepth, 1 where nothing was hit
+		std::vector<glm::vec3> hitPoints;// undeformed, like the G_BUFFER output of deform_frag.glsl
+		std::vector<glm::vec3> colors;
+		std::vector<uint32_t> steps;// sphere tracing and ODE steps of all fragments traced for the pixel
+
+		NlstRenderTarget();
+
+		void Resize(size_t _width, size_t _height);
+		void Clear(const glm::vec3& clearColor);
+	};
+
+	// running inverse deformation Jacobian of a ray, like the BROYDEN_UPDATES globals of deform_frag.glsl
+	struct BroydenState
+	{
+		glm::mat3 inverseJacobian;
+		glm::vec3 undefPoint;// where the inverse Jacobian was last evaluated or updated
+		glm::vec3 defPoint;
+		int updates;// since the last evaluation, -1 before the first
+
+		BroydenState();
+	};
+
+	// what a ray needs to be traced, mirrors the uniforms of deform_frag.glsl
+	struct NlstContext
+	{
+		const Deformation* p_deformation;
+		const SdfFunction* p_sdf;
+		const PacketSdfFunction* p_packetSdf;
+		float odeTolerance;
+		int broydenMaxSteps;
+		float broydenTolerance;
+		BroydenState* p_broydenState;// of the ray being traced, nullptr to evaluate every inverse Jacobian
+		glm::mat4 VP;
+		glm::vec3 cameraPos;
+
+		NlstContext();
+	};
+
+	// cpu versions of the functions in deform_frag.glsl
+	glm::vec3 UndeformedDirection(const NlstContext& context, const glm::vec3& undefPoint, const glm::vec3& defDirection);
+	Simd::Vec3Packet UndeformedDirection(const NlstContext& context, const Simd::Vec3Packet& undefPoints, const Simd::Vec3Packet& defDirections);
+	glm::vec3 Nlst(
+		const NlstContext& context,
+		const glm::vec3& undefOrigin,
+		const glm::vec3& defDirection,
+		float distToOrigin,
+		float undefPixelRadiusPerLength,
+		float maxDist,
+		float maxRadius,
+		bool& outHit,
+		uint32_t& outStepCount
+	);
+	glm::vec3 Shade(const NlstContext& context, const glm::vec3& undefHitPoint, const glm::vec3& defDirection, const glm::vec3& lightDir);
+	float DeformedPointToDepth(const NlstContext& context, const glm::vec3& defPoint);
+
+	// reference renderer for the non-linear sphere tracing in deform_frag.glsl, the deformed cage is 
+	// rasterized per screen tile and the fragments of each pixel are traced front to back
+	class NlstRenderer
+	{
+	private:
+		// a rasterizable piece of the subdivided cage
+		struct CageTriangle
+		{
+			glm::vec3 windowPositions[3];// x and y in pixels, z is the normalized device depth
+			float invW[3];
+			glm::vec3 undeformedPositions[3];
+			bool isVisible;
+		};
+
+		struct Fragment
+		{
+			float depth;
+			glm::vec3 undeformedPos;
+		};
+
+		// the fragments of a pixel sorted front to back, traced in order until one is behind the closest hit
+		struct PixelFragments
+		{
+			size_t pixelIndex;
+			size_t fragmentsStart;
+			size_t fragmentsEnd;
+			size_t nextFragment;
+			float pixelRadiusPerLength;
+			float closestDepth;
+		};
+
+		struct TileScratch
+		{
+			std::vector<Fragment> fragments;
+			std::vector<PixelFragments> pixels;
+		};
+
+		ThreadPool& threadPool;
+		Deformation deformation;
+		CageBvh cageBvh;
+		std::vector<CageTriangle> cageTriangles;
+		std::vector<std::vector<size_t>> tileTriangles;
+		std::vector<TileScratch> threadScratch;
+
+		void TracePixels(const NlstContext& context, const NlstRenderSettings& settings, TileScratch& scratch, NlstRenderTarget& outTarget) const;
+		void TracePixelPackets(const NlstContext& context, const NlstRenderSettings& settings, TileScratch& scratch, NlstRenderTarget& outTarget) const;
+		// like deferred_shading_frag.glsl
+		void ShadeHits(const NlstContext& context, const NlstRenderSettings& settings, const glm::mat4& invVP, NlstRenderTarget& outTarget) const;
+
+	public:
+		NlstRenderer(ThreadPool& _threadPool);
+
+		// builds the cage bvh over the bind pose, which is refit to the pose of every render that uses it
+		void SetCage(const std::vector<glm::vec3>& cagePositions, const std::vector<GLuint>& cageIndices);
+
+		void Render(
+			const Camera& camera,
+			const glm::mat4& cameraTransform,
+			const BindPose* p_bindPose,
+			const AnimationPose* p_animationPose,
+			size_t jointCount,
+			const SdfFunction& sdf,
+			const PacketSdfFunction& packetSdf,// evaluates sdf per lane if empty
+			const std::vector<glm::vec3>& cagePositions,
+			const std::vector<GLuint>& cageIndices,
+			const NlstRenderSettings& settings,
+			NlstRenderTarget& outTarget
+		);
+	};
+}
\ No newline at end of file
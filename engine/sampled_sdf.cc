@@ -0,0 +1,108 @@
+#include "sampled_sdf.h"
+#include <glm.hpp>
+#include <cfloat>
+
+namespace Engine
+{
+	SampledSdf::SampledSdf() :
+		sampleCount(0),
+		volumeMin(0.f),
+		sampleSpacing(1.f)
+	{}
+
+	void SampledSdf::Reload(
+		const std::vector<float>& _samples,
+		const glm::ivec3& _sampleCount,
+		const glm::vec3& _volumeMin,
+		const glm::vec3& _sampleSpacing
+	)
+	{
+		samples = _samples;
+		sampleCount = _sampleCount;
+		volumeMin = _volumeMin;
+		sampleSpacing = _sampleSpacing;
+	}
+
+	float SampledSdf::Sample(int x, int y, int z) const
+	{
+		return samples[(size_t)x * sampleCount.y * sampleCount.z + (size_t)y * sampleCount.z + (size_t)z];
+	}
+
+	float SampledSdf::operator()(const glm::vec3& point) const
+	{
+		if (samples.empty())
+			return FLT_MAX;
+
+		glm::vec3 volumeMax = volumeMin + sampleSpacing * glm::vec3(sampleCount - 1);
+		glm::vec3 clampedPoint = glm::clamp(point, volumeMin, volumeMax);
+		float outsideDistance = glm::distance(point, clampedPoint);
+
+		glm::vec3 gridPoint = (clampedPoint - volumeMin) / sampleSpacing;
+		glm::ivec3 index0 = glm::min(glm::ivec3(gridPoint), glm::max(sampleCount - 2, 0));
+		glm::ivec3 index1 = glm::min(index0 + 1, sampleCount - 1);
+		glm::vec3 t = glm::clamp(gridPoint - glm::vec3(index0), 0.f, 1.f);
+
+		float c00 = glm::mix(Sample(index0.x, index0.y, index0.z), Sample(index1.x, index0.y, index0.z), t.x);
+		float c10 = glm::mix(Sample(index0.x, index1.y, index0.z), Sample(index1.x, index1.y, index0.z), t.x);
+		float c01 = glm::mix(Sample(index0.x, index0.y, index1.z), Sample(index1.x, index0.y, index1.z), t.x);
+		float c11 = glm::mix(Sample(index0.x, index1.y, index1.z), Sample(index1.x, index1.y, index1.z), t.x);
+
+		float c0 = glm::mix(c00, c10, t.y);
+		float c1 = glm::mix(c01, c11, t.y);
+
+		return glm::mix(c0, c1, t.z) + outsideDistance;
+	}
+
+	Simd::FloatPacket SampledSdf::operator()(const Simd::Vec3Packet& points) const
+	{
+		using namespace Simd;
+
+		if (samples.empty())
+			return FloatPacket(FLT_MAX);
+
+		glm::vec3 volumeMax = volumeMin + sampleSpacing * glm::vec3(sampleCount - 1);
+		Vec3Packet clampedPoints(
+			Clamp(points.x, volumeMin.x, volumeMax.x),
+			Clamp(points.y, volumeMin.y, volumeMax.y),
+			Clamp(points.z, volumeMin.z, volumeMax.z)
+		);
+		FloatPacket outsideDistance = Length(points - clampedPoints);
+
+		Vec3Packet gridPoints(
+			(clampedPoints.x - volumeMin.x) * (1.f / sampleSpacing.x),
+			(clampedPoints.y - volumeMin.y) * (1.f / sampleSpacing.y),
+			(clampedPoints.z - volumeMin.z) * (1.f / sampleSpacing.z)
+		);
+
+		glm::ivec3 maxIndex0 = glm::max(sampleCount - 2, 0);
+		IntPacket x0 = MinInt(ToInt(gridPoints.x), BroadcastInt(maxIndex0.x));
+		IntPacket y0 = MinInt(ToInt(gridPoints.y), BroadcastInt(maxIndex0.y));
+		IntPacket z0 = MinInt(ToInt(gridPoints.z), BroadcastInt(maxIndex0.z));
+		FloatPacket tx = Clamp(gridPoints.x - ToFloat(x0), 0.f, 1.f);
+		FloatPacket ty = Clamp(gridPoints.y - ToFloat(y0), 0.f, 1.f);
+		FloatPacket tz = Clamp(gridPoints.z - ToFloat(z0), 0.f, 1.f);
+
+		// linear indices of the 8 surrounding samples, the neighbours are clamped to the grid
+		IntPacket strideX = BroadcastInt(sampleCount.y * sampleCount.z);
+		IntPacket strideY = BroadcastInt(sampleCount.z);
+		IntPacket one = BroadcastInt(1);
+		IntPacket x1 = MinInt(x0 + one, BroadcastInt(sampleCount.x - 1));
+		IntPacket y1 = MinInt(y0 + one, BroadcastInt(sampleCount.y - 1));
+		IntPacket z1 = MinInt(z0 + one, BroadcastInt(sampleCount.z - 1));
+
+		IntPacket offsetX0 = x0 * strideX;
+		IntPacket offsetX1 = x1 * strideX;
+		IntPacket offsetY0 = y0 * strideY;
+		IntPacket offsetY1 = y1 * strideY;
+
+		const float* p_samples = samples.data();
+		auto lerp = [](const FloatPacket& a, const FloatPacket& b, const FloatPacket& t) { return a + (b - a) * t; };
+
+		FloatPacket c00 = lerp(Gather(p_samples, offsetX0 + offsetY0 + z0), Gather(p_samples, offsetX1 + offsetY0 + z0), tx);
+		FloatPacket c10 = lerp(Gather(p_samples, offsetX0 + offsetY1 + z0), Gather(p_samples, offsetX1 + offsetY1 + z0), tx);
+		FloatPacket c01 = lerp(Gather(p_samples, offsetX0 + offsetY0 + z1), Gather(p_samples, offsetX1 + offsetY0 + z1), tx);
+		FloatPacket c11 = lerp(Gather(p_samples, offsetX0 + offsetY1 + z1), Gather(p_samples, offsetX1 + offsetY1 + z1), tx);
+
+		return lerp(lerp(c00, c10, ty), lerp(c01, c11, ty), tz) + outsideDistance;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+#include "simd.h"
+#include <vec3.hpp>
+#include <vector>
+#include <functional>
+
+namespace Engine
+{
+	using SdfFunction = std::function<float(const glm::vec3&)>;
+	using PacketSdfFunction = std::function<Simd::FloatPacket(const Simd::Vec3Packet&)>;
+
+	// trilinear interpolation of signed distances sampled on a grid, 
+	// with the same layout as the output of the Voxelizer
+	class SampledSdf
+	{
+	private:
+		std::vector<float> samples;
+		glm::ivec3 sampleCount;
+		glm::vec3 volumeMin;
+		glm::vec3 sampleSpacing;
+
+		float Sample(int x, int y, int z) const;
+
+	public:
+		SampledSdf();
+
+		void Reload(
+			const std::vector<float>& _samples,
+			const glm::ivec3& _sampleCount,
+			const glm::vec3& _volumeMin,
+			const glm::vec3& _sampleSpacing
+		);
+		// points outside of the grid get the distance to the grid added to the closest sample
+		float operator()(const glm::vec3& point) const;
+		Simd::FloatPacket operator()(const Simd::Vec3Packet& points) const;
+	};
+}
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "shader.h"
 #include "file_io.h"
 #include <regex>
+#include <algorithm>
 #include <memory>
 #include <iostream>
 
@@ -47,19 +48,48 @@ namespace Engine
 			outShaderCode += includeMatch.prefix();
 			outShaderCode += includeCode;
 			strStart = includeMatch.suffix().first;
+
+			// continue the numbering of the file after the included code, so that 
+			// error messages point at the lines in the file
+			size_t includeLine = 1 + std::count(shaderCode.cbegin(), includeMatch[0].first, '\n');
+			outShaderCode += "\n#line " + std::to_string(includeLine + 1);
 		}
 
+		// the match is empty after the failed search, so the rest is taken from the last position
 		if (outShaderCode.size() == 0)
 			outShaderCode = shaderCode;
 		else
-			outShaderCode += includeMatch.suffix();
+			outShaderCode.append(strStart, shaderCode.cend());
+	}
+
+	void InsertDefines(const std::vector<std::string>& defines, std::string& inoutShaderCode)
+	{
+		if (defines.size() == 0)
+			return;
+
+		// the version directive has to come first, so the defines go on the line after it
+		size_t versionStart = inoutShaderCode.find("#version");
+		size_t insertIndex = versionStart == std::string::npos ? 0 : inoutShaderCode.find('\n', versionStart);
+		insertIndex = insertIndex == std::string::npos ? inoutShaderCode.size() : insertIndex + 1;
+
+		std::string defineCode;
+		for (const std::string& define : defines)
+			defineCode += "#define " + define + "\n";
+
+		// keep the line numbers in error messages the same as in the file, the version directive is 
+		// on the first line and the includes after it restore the numbering themselves
+		if (versionStart != std::string::npos)
+			defineCode += "#line 2\n";
+
+		inoutShaderCode.insert(insertIndex, defineCode);
 	}
 
-	bool TryLoadShader(const std::string& path, GLenum shaderType, GLuint& outShader)
+	bool TryLoadShader(const std::string& path, GLenum shaderType, const std::vector<std::string>& defines, GLuint& outShader)
 	{
 		std::string rawShaderText, shaderText;
 		ReadTextFile(path, rawShaderText);
 		PreprocessShaderCode(rawShaderText, shaderText);
+		InsertDefines(defines, shaderText);
 		const char* shaderText_C = shaderText.c_str();
 
 		GLuint shader = glCreateShader(shaderType);
@@ -97,7 +127,8 @@ namespace Engine
 	bool Shader::Reload(
 		const std::string& vertexFilePath, 
 		const std::string& fragmentFilePath,
-		const std::pair<std::string, std::string>& tesselationFilePaths
+		const std::pair<std::string, std::string>& tesselationFilePaths,
+		const std::vector<std::string>& defines
 	)
 	{
 		// compile shaders
@@ -107,14 +138,14 @@ namespace Engine
 		TempShader tessEvalShader = { 0 };
 		bool useTess = false;
 
-		if (!TryLoadShader(vertexFilePath, GL_VERTEX_SHADER, vertexShader.shader) ||
-			!TryLoadShader(fragmentFilePath, GL_FRAGMENT_SHADER, fragmentShader.shader)) 
+		if (!TryLoadShader(vertexFilePath, GL_VERTEX_SHADER, defines, vertexShader.shader) ||
+			!TryLoadShader(fragmentFilePath, GL_FRAGMENT_SHADER, defines, fragmentShader.shader)) 
 			return false;
 
 		if (tesselationFilePaths.first.size() > 0 && tesselationFilePaths.second.size() > 0)
 		{
-			if (!TryLoadShader(tesselationFilePaths.first, GL_TESS_CONTROL_SHADER, tessControlShader.shader) ||
-				!TryLoadShader(tesselationFilePaths.second, GL_TESS_EVALUATION_SHADER, tessEvalShader.shader))
+			if (!TryLoadShader(tesselationFilePaths.first, GL_TESS_CONTROL_SHADER, defines, tessControlShader.shader) ||
+				!TryLoadShader(tesselationFilePaths.second, GL_TESS_EVALUATION_SHADER, defines, tessEvalShader.shader))
 				return false;
 
 			useTess = true;
@@ -149,12 +180,12 @@ namespace Engine
 		return true;
 	}
 
-	bool Shader::Reload(const std::string& computeFilePath)
+	bool Shader::Reload(const std::string& computeFilePath, const std::vector<std::string>& defines)
 	{
 		// compile shader
 		TempShader computeShader = { 0 };
 
-		if (!TryLoadShader(computeFilePath, GL_COMPUTE_SHADER, computeShader.shader))
+		if (!TryLoadShader(computeFilePath, GL_COMPUTE_SHADER, defines, computeShader.shader))
 			return false;
 
 		// create and link program
@@ -214,6 +245,12 @@ namespace Engine
 		glUniform1i(nameToLocation[name], value);
 	}
 
+	void Shader::SetUint(const std::string& name, GLuint value)
+	{
+		AddLocationIfNeeded(name);
+		glUniform1ui(nameToLocation[name], value);
+	}
+
 	void Shader::SetFloats(const std::string& name, GLfloat* valuePtr, GLsizei count)
 	{
 		AddLocationIfNeeded(name);
@@ -1,6 +1,7 @@
 #pragma once
 #include <GL/glew.h>
 #include <string>
+#include <vector>
 #include <map>
 
 namespace Engine
@@ -19,18 +20,21 @@ namespace Engine
 		Shader();
 		~Shader();
 		
+		// defines are inserted after the version directive in every stage, e.g. "JOINT_COUNT 4"
 		bool Reload(
 			const std::string& vertexFilePath, 
 			const std::string& fragmentFilePath, 
-			const std::pair<std::string, std::string>& tesselationFilePaths = {"", ""}
+			const std::pair<std::string, std::string>& tesselationFilePaths = {"", ""},
+			const std::vector<std::string>& defines = {}
 		);
-		bool Reload(const std::string& computeFilePath);
+		bool Reload(const std::string& computeFilePath, const std::vector<std::string>& defines = {});
 
 		void Use();
 		void StopUsing();
 
 		void SetFloat(const std::string& name, GLfloat value);
 		void SetInt(const std::string& name, GLint value);
+		void SetUint(const std::string& name, GLuint value);
 		void SetFloats(const std::string& name, GLfloat* valuePtr, GLsizei count = 1);
 		void SetInts(const std::string& name, GLint* valuePtr, GLsizei count = 1);
 		void SetVec2(const std::string& name, const GLfloat* valuePtr, GLsizei count = 1);
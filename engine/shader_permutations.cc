@@ -0,0 +1,48 @@
+#include "shader_permutations.h"
+
+namespace Engine
+{
+	ShaderPermutations::ShaderPermutations()
+	{}
+
+	void ShaderPermutations::Init(
+		const std::string& _vertexFilePath,
+		const std::string& _fragmentFilePath,
+		const std::pair<std::string, std::string>& _tesselationFilePaths
+	)
+	{
+		vertexFilePath = _vertexFilePath;
+		fragmentFilePath = _fragmentFilePath;
+		tesselationFilePaths = _tesselationFilePaths;
+		Clear();
+	}
+
+	Shader* ShaderPermutations::Get(const std::vector<std::string>& defines)
+	{
+		std::string key;
+		for (const std::string& define : defines)
+			key += define + ";";
+
+		auto it = permutations.find(key);
+		if (it != permutations.end())
+			return it->second.get();
+
+		std::unique_ptr<Shader> shader(new Shader());
+		if (!shader->Reload(vertexFilePath, fragmentFilePath, tesselationFilePaths, defines))
+			shader.reset();
+
+		Shader* p_shader = shader.get();
+		permutations[key] = std::move(shader);
+		return p_shader;
+	}
+
+	void ShaderPermutations::Clear()
+	{
+		permutations.clear();
+	}
+
+	size_t ShaderPermutations::PermutationCount() const
+	{
+		return permutations.size();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+#include "shader.h"
+#include <memory>
+
+namespace Engine
+{
+	// cache of shader programs compiled from the same files with different sets of defines,
+	// each permutation is compiled the first time it is requested
+	class ShaderPermutations final
+	{
+	private:
+		std::string vertexFilePath;
+		std::string fragmentFilePath;
+		std::pair<std::string, std::string> tesselationFilePaths;
+		// keyed by the joined defines, failed permutations are stored as nullptr
+		std::map<std::string, std::unique_ptr<Shader>> permutations;
+
+	public:
+		ShaderPermutations();
+
+		void Init(
+			const std::string& _vertexFilePath,
+			const std::string& _fragmentFilePath,
+			const std::pair<std::string, std::string>& _tesselationFilePaths = { "", "" }
+		);
+		// returns nullptr if the permutation failed to compile
+		Shader* Get(const std::vector<std::string>& defines);
+		// removes all permutations, so that they are recompiled from the files when requested
+		void Clear();
+		size_t PermutationCount() const;
+	};
+}
\ No newline at end of file
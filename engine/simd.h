@@ -0,0 +1,330 @@
+#pragma once
+#include <vec3.hpp>
+#include <mat3x3.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+
+// packet width follows the instruction set the engine is compiled for,
+// see the ENGINE_SIMD option in engine/CMakeLists.txt
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define ENGINE_SIMD_AVX512
+#define ENGINE_SIMD_WIDTH 16
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define ENGINE_SIMD_AVX2
+#define ENGINE_SIMD_WIDTH 8
+#else
+#define ENGINE_SIMD_SCALAR
+#define ENGINE_SIMD_WIDTH 4
+#endif
+
+namespace Engine
+{
+	namespace Simd
+	{
+		constexpr size_t Width = ENGINE_SIMD_WIDTH;
+
+#if defined(ENGINE_SIMD_AVX512)
+		struct MaskPacket
+		{
+			__mmask16 m;
+		};
+
+		struct IntPacket
+		{
+			__m512i v;
+		};
+
+		struct FloatPacket
+		{
+			__m512 v;
+
+			FloatPacket() : v(_mm512_setzero_ps()) {}
+			FloatPacket(float value) : v(_mm512_set1_ps(value)) {}
+			FloatPacket(__m512 _v) : v(_v) {}
+
+			static FloatPacket Load(const float* p_values) { return _mm512_loadu_ps(p_values); }
+			void Store(float* p_values) const { _mm512_storeu_ps(p_values, v); }
+		};
+
+		inline FloatPacket operator+(const FloatPacket& a, const FloatPacket& b) { return _mm512_add_ps(a.v, b.v); }
+		inline FloatPacket operator-(const FloatPacket& a, const FloatPacket& b) { return _mm512_sub_ps(a.v, b.v); }
+		inline FloatPacket operator*(const FloatPacket& a, const FloatPacket& b) { return _mm512_mul_ps(a.v, b.v); }
+		inline FloatPacket operator/(const FloatPacket& a, const FloatPacket& b) { return _mm512_div_ps(a.v, b.v); }
+		inline FloatPacket operator-(const FloatPacket& a) { return _mm512_sub_ps(_mm512_setzero_ps(), a.v); }
+		inline FloatPacket Min(const FloatPacket& a, const FloatPacket& b) { return _mm512_min_ps(a.v, b.v); }
+		inline FloatPacket Max(const FloatPacket& a, const FloatPacket& b) { return _mm512_max_ps(a.v, b.v); }
+		inline FloatPacket Sqrt(const FloatPacket& a) { return _mm512_sqrt_ps(a.v); }
+		inline FloatPacket Abs(const FloatPacket& a) { return _mm512_abs_ps(a.v); }
+
+		inline MaskPacket operator<(const FloatPacket& a, const FloatPacket& b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ) }; }
+		inline MaskPacket operator>(const FloatPacket& a, const FloatPacket& b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ) }; }
+		inline MaskPacket operator>=(const FloatPacket& a, const FloatPacket& b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ) }; }
+
+		inline MaskPacket operator&(const MaskPacket& a, const MaskPacket& b) { return { (__mmask16)(a.m & b.m) }; }
+		inline MaskPacket operator|(const MaskPacket& a, const MaskPacket& b) { return { (__mmask16)(a.m | b.m) }; }
+		inline MaskPacket AndNot(const MaskPacket& a, const MaskPacket& b) { return { (__mmask16)(a.m & ~b.m) }; }
+		inline uint32_t Bits(const MaskPacket& a) { return (uint32_t)a.m; }
+		inline MaskPacket MaskFromBits(uint32_t bits) { return { (__mmask16)bits }; }
+
+		// a where the mask is set, b otherwise
+		inline FloatPacket Select(const MaskPacket& mask, const FloatPacket& a, const FloatPacket& b) { return _mm512_mask_blend_ps(mask.m, b.v, a.v); }
+
+		inline IntPacket ToInt(const FloatPacket& a) { return { _mm512_cvttps_epi32(a.v) }; }
+		inline FloatPacket ToFloat(const IntPacket& a) { return _mm512_cvtepi32_ps(a.v); }
+		inline IntPacket operator+(const IntPacket& a, const IntPacket& b) { return { _mm512_add_epi32(a.v, b.v) }; }
+		inline IntPacket operator*(const IntPacket& a, const IntPacket& b) { return { _mm512_mullo_epi32(a.v, b.v) }; }
+		inline IntPacket MinInt(const IntPacket& a, const IntPacket& b) { return { _mm512_min_epi32(a.v, b.v) }; }
+		inline IntPacket BroadcastInt(int32_t value) { return { _mm512_set1_epi32(value) }; }
+		inline FloatPacket Gather(const float* p_base, const IntPacket& indices) { return _mm512_i32gather_ps(indices.v, p_base, 4); }
+
+#elif defined(ENGINE_SIMD_AVX2)
+		struct MaskPacket
+		{
+			__m256 m;// all bits set in active lanes
+		};
+
+		struct IntPacket
+		{
+			__m256i v;
+		};
+
+		struct FloatPacket
+		{
+			__m256 v;
+
+			FloatPacket() : v(_mm256_setzero_ps()) {}
+			FloatPacket(float value) : v(_mm256_set1_ps(value)) {}
+			FloatPacket(__m256 _v) : v(_v) {}
+
+			static FloatPacket Load(const float* p_values) { return _mm256_loadu_ps(p_values); }
+			void Store(float* p_values) const { _mm256_storeu_ps(p_values, v); }
+		};
+
+		inline FloatPacket operator+(const FloatPacket& a, const FloatPacket& b) { return _mm256_add_ps(a.v, b.v); }
+		inline FloatPacket operator-(const FloatPacket& a, const FloatPacket& b) { return _mm256_sub_ps(a.v, b.v); }
+		inline FloatPacket operator*(const FloatPacket& a, const FloatPacket& b) { return _mm256_mul_ps(a.v, b.v); }
+		inline FloatPacket operator/(const FloatPacket& a, const FloatPacket& b) { return _mm256_div_ps(a.v, b.v); }
+		inline FloatPacket operator-(const FloatPacket& a) { return _mm256_sub_ps(_mm256_setzero_ps(), a.v); }
+		inline FloatPacket Min(const FloatPacket& a, const FloatPacket& b) { return _mm256_min_ps(a.v, b.v); }
+		inline FloatPacket Max(const FloatPacket& a, const FloatPacket& b) { return _mm256_max_ps(a.v, b.v); }
+		inline FloatPacket Sqrt(const FloatPacket& a) { return _mm256_sqrt_ps(a.v); }
+		inline FloatPacket Abs(const FloatPacket& a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v); }
+
+		inline MaskPacket operator<(const FloatPacket& a, const FloatPacket& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+		inline MaskPacket operator>(const FloatPacket& a, const FloatPacket& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+		inline MaskPacket operator>=(const FloatPacket& a, const FloatPacket& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+
+		inline MaskPacket operator&(const MaskPacket& a, const MaskPacket& b) { return { _mm256_and_ps(a.m, b.m) }; }
+		inline MaskPacket operator|(const MaskPacket& a, const MaskPacket& b) { return { _mm256_or_ps(a.m, b.m) }; }
+		inline MaskPacket AndNot(const MaskPacket& a, const MaskPacket& b) { return { _mm256_andnot_ps(b.m, a.m) }; }
+		inline uint32_t Bits(const MaskPacket& a) { return (uint32_t)_mm256_movemask_ps(a.m); }
+
+		inline MaskPacket MaskFromBits(uint32_t bits)
+		{
+			const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+			__m256i selected = _mm256_and_si256(_mm256_set1_epi32((int)bits), laneBits);
+			return { _mm256_castsi256_ps(_mm256_cmpeq_epi32(selected, laneBits)) };
+		}
+
+		// a where the mask is set, b otherwise
+		inline FloatPacket Select(const MaskPacket& mask, const FloatPacket& a, const FloatPacket& b) { return _mm256_blendv_ps(b.v, a.v, mask.m); }
+
+		inline IntPacket ToInt(const FloatPacket& a) { return { _mm256_cvttps_epi32(a.v) }; }
+		inline FloatPacket ToFloat(const IntPacket& a) { return _mm256_cvtepi32_ps(a.v); }
+		inline IntPacket operator+(const IntPacket& a, const IntPacket& b) { return { _mm256_add_epi32(a.v, b.v) }; }
+		inline IntPacket operator*(const IntPacket& a, const IntPacket& b) { return { _mm256_mullo_epi32(a.v, b.v) }; }
+		inline IntPacket MinInt(const IntPacket& a, const IntPacket& b) { return { _mm256_min_epi32(a.v, b.v) }; }
+		inline IntPacket BroadcastInt(int32_t value) { return { _mm256_set1_epi32(value) }; }
+		inline FloatPacket Gather(const float* p_base, const IntPacket& indices) { return _mm256_i32gather_ps(p_base, indices.v, 4); }
+
+#else
+		// plain arrays, simple enough for the compiler to vectorize with whatever is available
+		struct MaskPacket
+		{
+			uint32_t m;// a bit per lane
+		};
+
+		struct IntPacket
+		{
+			int32_t v[Width];
+		};
+
+		struct FloatPacket
+		{
+			float v[Width];
+
+			FloatPacket() : v{ 0.f, 0.f, 0.f, 0.f } {}
+			FloatPacket(float value) : v{ value, value, value, value } {}
+
+			static FloatPacket Load(const float* p_values)
+			{
+				FloatPacket result;
+				for (size_t i = 0; i < Width; i++)
+					result.v[i] = p_values[i];
+				return result;
+			}
+
+			void Store(float* p_values) const
+			{
+				for (size_t i = 0; i < Width; i++)
+					p_values[i] = v[i];
+			}
+		};
+
+#define ENGINE_SIMD_LANEWISE(expression) FloatPacket result; for (size_t i = 0; i < Width; i++) result.v[i] = (expression); return result;
+#define ENGINE_SIMD_LANEWISE_MASK(expression) MaskPacket result{ 0 }; for (size_t i = 0; i < Width; i++) result.m |= (expression) ? (1u << i) : 0u; return result;
+#define ENGINE_SIMD_LANEWISE_INT(expression) IntPacket result; for (size_t i = 0; i < Width; i++) result.v[i] = (expression); return result;
+
+		inline FloatPacket operator+(const FloatPacket& a, const FloatPacket& b) { ENGINE_SIMD_LANEWISE(a.v[i] + b.v[i]) }
+		inline FloatPacket operator-(const FloatPacket& a, const FloatPacket& b) { ENGINE_SIMD_LANEWISE(a.v[i] - b.v[i]) }
+		inline FloatPacket operator*(const FloatPacket& a, const FloatPacket& b) { ENGINE_SIMD_LANEWISE(a.v[i] * b.v[i]) }
+		inline FloatPacket operator/(const FloatPacket& a, const FloatPacket& b) { ENGINE_SIMD_LANEWISE(a.v[i] / b.v[i]) }
+		inline FloatPacket operator-(const FloatPacket& a) { ENGINE_SIMD_LANEWISE(-a.v[i]) }
+		inline FloatPacket Min(const FloatPacket& a, const FloatPacket& b) { ENGINE_SIMD_LANEWISE(a.v[i] < b.v[i] ? a.v[i] : b.v[i]) }
+		inline FloatPacket Max(const FloatPacket& a, const FloatPacket& b) { ENGINE_SIMD_LANEWISE(a.v[i] > b.v[i] ? a.v[i] : b.v[i]) }
+		inline FloatPacket Sqrt(const FloatPacket& a) { ENGINE_SIMD_LANEWISE(std::sqrt(a.v[i])) }
+		inline FloatPacket Abs(const FloatPacket& a) { ENGINE_SIMD_LANEWISE(std::fabs(a.v[i])) }
+
+		inline MaskPacket operator<(const FloatPacket& a, const FloatPacket& b) { ENGINE_SIMD_LANEWISE_MASK(a.v[i] < b.v[i]) }
+		inline MaskPacket operator>(const FloatPacket& a, const FloatPacket& b) { ENGINE_SIMD_LANEWISE_MASK(a.v[i] > b.v[i]) }
+		inline MaskPacket operator>=(const FloatPacket& a, const FloatPacket& b) { ENGINE_SIMD_LANEWISE_MASK(a.v[i] >= b.v[i]) }
+
+		inline MaskPacket operator&(const MaskPacket& a, const MaskPacket& b) { return { a.m & b.m }; }
+		inline MaskPacket operator|(const MaskPacket& a, const MaskPacket& b) { return { a.m | b.m }; }
+		inline MaskPacket AndNot(const MaskPacket& a, const MaskPacket& b) { return { a.m & ~b.m }; }
+		inline uint32_t Bits(const MaskPacket& a) { return a.m; }
+		inline MaskPacket MaskFromBits(uint32_t bits) { return { bits & ((1u << Width) - 1) }; }
+
+		// a where the mask is set, b otherwise
+		inline FloatPacket Select(const MaskPacket& mask, const FloatPacket& a, const FloatPacket& b) { ENGINE_SIMD_LANEWISE(((mask.m >> i) & 1u) ? a.v[i] : b.v[i]) }
+
+		inline IntPacket ToInt(const FloatPacket& a) { ENGINE_SIMD_LANEWISE_INT((int32_t)a.v[i]) }
+		inline FloatPacket ToFloat(const IntPacket& a) { ENGINE_SIMD_LANEWISE((float)a.v[i]) }
+		inline IntPacket operator+(const IntPacket& a, const IntPacket& b) { ENGINE_SIMD_LANEWISE_INT(a.v[i] + b.v[i]) }
+		inline IntPacket operator*(const IntPacket& a, const IntPacket& b) { ENGINE_SIMD_LANEWISE_INT(a.v[i] * b.v[i]) }
+		inline IntPacket MinInt(const IntPacket& a, const IntPacket& b) { ENGINE_SIMD_LANEWISE_INT(a.v[i] < b.v[i] ? a.v[i] : b.v[i]) }
+		inline IntPacket BroadcastInt(int32_t value) { ENGINE_SIMD_LANEWISE_INT(value) }
+		inline FloatPacket Gather(const float* p_base, const IntPacket& indices) { ENGINE_SIMD_LANEWISE(p_base[indices.v[i]]) }
+
+#undef ENGINE_SIMD_LANEWISE
+#undef ENGINE_SIMD_LANEWISE_MASK
+#undef ENGINE_SIMD_LANEWISE_INT
+#endif
+
+		inline bool Any(const MaskPacket& a) { return Bits(a) != 0; }
+		inline MaskPacket AllLanes() { return MaskFromBits((1u << Width) - 1); }
+		inline MaskPacket NoLanes() { return MaskFromBits(0); }
+		inline FloatPacket Clamp(const FloatPacket& a, const FloatPacket& min, const FloatPacket& max) { return Min(Max(a, min), max); }
+
+		inline float GetLane(const FloatPacket& a, size_t lane)
+		{
+			float values[Width];
+			a.Store(values);
+			return values[lane];
+		}
+
+		inline void SetLane(FloatPacket& a, size_t lane, float value)
+		{
+			float values[Width];
+			a.Store(values);
+			values[lane] = value;
+			a = FloatPacket::Load(values);
+		}
+
+
+		// structure of arrays, one point per lane
+		struct Vec3Packet
+		{
+			FloatPacket x, y, z;
+
+			Vec3Packet() {}
+			Vec3Packet(const FloatPacket& _x, const FloatPacket& _y, const FloatPacket& _z) : x(_x), y(_y), z(_z) {}
+			Vec3Packet(const glm::vec3& value) : x(value.x), y(value.y), z(value.z) {}
+		};
+
+		inline Vec3Packet operator+(const Vec3Packet& a, const Vec3Packet& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+		inline Vec3Packet operator-(const Vec3Packet& a, const Vec3Packet& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+		inline Vec3Packet operator*(const Vec3Packet& a, const FloatPacket& s) { return { a.x * s, a.y * s, a.z * s }; }
+		inline Vec3Packet operator*(const FloatPacket& s, const Vec3Packet& a) { return { a.x * s, a.y * s, a.z * s }; }
+		inline FloatPacket Dot(const Vec3Packet& a, const Vec3Packet& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+		inline FloatPacket Length(const Vec3Packet& a) { return Sqrt(Dot(a, a)); }
+		inline Vec3Packet Normalize(const Vec3Packet& a) { return a * (FloatPacket(1.f) / Length(a)); }
+
+		inline Vec3Packet Select(const MaskPacket& mask, const Vec3Packet& a, const Vec3Packet& b)
+		{
+			return { Select(mask, a.x, b.x), Select(mask, a.y, b.y), Select(mask, a.z, b.z) };
+		}
+
+		inline glm::vec3 GetLane(const Vec3Packet& a, size_t lane)
+		{
+			return glm::vec3(GetLane(a.x, lane), GetLane(a.y, lane), GetLane(a.z, lane));
+		}
+
+		inline void SetLane(Vec3Packet& a, size_t lane, const glm::vec3& value)
+		{
+			SetLane(a.x, lane, value.x);
+			SetLane(a.y, lane, value.y);
+			SetLane(a.z, lane, value.z);
+		}
+
+
+		// column major like glm
+		struct Mat3Packet
+		{
+			Vec3Packet columns[3];
+		};
+
+		inline Vec3Packet operator*(const Mat3Packet& m, const Vec3Packet& v)
+		{
+			return m.columns[0] * v.x + m.columns[1] * v.y + m.columns[2] * v.z;
+		}
+
+		inline Vec3Packet Cross(const Vec3Packet& a, const Vec3Packet& b)
+		{
+			return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+		}
+
+		inline FloatPacket Determinant(const Mat3Packet& m)
+		{
+			return Dot(m.columns[0], Cross(m.columns[1], m.columns[2]));
+		}
+
+		inline Mat3Packet Inverse(const Mat3Packet& m)
+		{
+			// the rows of the inverse are the cross products of the columns divided by the determinant
+			Vec3Packet row0 = Cross(m.columns[1], m.columns[2]);
+			Vec3Packet row1 = Cross(m.columns[2], m.columns[0]);
+			Vec3Packet row2 = Cross(m.columns[0], m.columns[1]);
+			FloatPacket invDeterminant = FloatPacket(1.f) / Dot(m.columns[0], row0);
+
+			Mat3Packet result;
+			result.columns[0] = Vec3Packet(row0.x, row1.x, row2.x) * invDeterminant;
+			result.columns[1] = Vec3Packet(row0.y, row1.y, row2.y) * invDeterminant;
+			result.columns[2] = Vec3Packet(row0.z, row1.z, row2.z) * invDeterminant;
+			return result;
+		}
+
+		inline Mat3Packet Transpose(const Mat3Packet& m)
+		{
+			Mat3Packet result;
+			result.columns[0] = Vec3Packet(m.columns[0].x, m.columns[1].x, m.columns[2].x);
+			result.columns[1] = Vec3Packet(m.columns[0].y, m.columns[1].y, m.columns[2].y);
+			result.columns[2] = Vec3Packet(m.columns[0].z, m.columns[1].z, m.columns[2].z);
+			return result;
+		}
+
+		inline glm::mat3 GetLane(const Mat3Packet& m, size_t lane)
+		{
+			return glm::mat3(GetLane(m.columns[0], lane), GetLane(m.columns[1], lane), GetLane(m.columns[2], lane));
+		}
+
+		inline void SetLane(Mat3Packet& m, size_t lane, const glm::mat3& value)
+		{
+			for (int i = 0; i < 3; i++)
+				SetLane(m.columns[i], lane, value[i]);
+		}
+	}
+}
\ No newline at end of file
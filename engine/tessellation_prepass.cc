@@ -0,0 +1,292 @@
+#include "tessellation_prepass.h"
+#include "deformation.h"
+#include <glm.hpp>
+#include <unordered_map>
+
+namespace Engine
+{
+	TessellationPrepass::TessellationPrepass() :
+		buffers{ 0, 0, 0, 0, 0, 0, 0 },
+		vertexCount(0),
+		edgeCount(0),
+		referenceSkinningMode(SkinningMode::LinearBlend),
+		isCacheValid(false),
+		influenceWeightThreshold(0.001f)
+	{}
+
+	TessellationPrepass::~TessellationPrepass()
+	{
+		Deinit();
+	}
+
+	void TessellationPrepass::Deinit()
+	{
+		if (buffers[0] != 0)
+			glDeleteBuffers(BufferCount, buffers);
+
+		for (GLuint& buffer : buffers)
+			buffer = 0;
+
+		vertexCount = 0;
+		edgeCount = 0;
+		undeformedPositions.clear();
+		edges.clear();
+		influenceWeightVolumes.clear();
+		Invalidate();
+	}
+
+	bool TessellationPrepass::Reload(const std::string& computeShaderFilePath)
+	{
+		Invalidate();
+
+		return 
+			vertexPassShader.Reload(computeShaderFilePath, std::vector<std::string>{ "VERTEX_PASS" }) &&
+			edgePassShader.Reload(computeShaderFilePath);
+	}
+
+	Shader& TessellationPrepass::GetVertexPassShader()
+	{
+		return vertexPassShader;
+	}
+
+	Shader& TessellationPrepass::GetEdgePassShader()
+	{
+		return edgePassShader;
+	}
+
+	void TessellationPrepass::SetMesh(const std::vector<glm::vec3>& positions, const std::vector<GLuint>& indices)
+	{
+		Deinit();
+
+		// give each undirected edge an id, the patch edge order matches deform_tess_control.glsl
+		const GLuint edgeStarts[3] = { 1, 0, 0 };
+		const GLuint edgeEnds[3] = { 2, 2, 1 };
+
+		std::unordered_map<uint64_t, GLuint> edgeIds;
+		std::vector<GLuint> triangleEdges(indices.size());
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			for (size_t j = 0; j < 3; j++)
+			{
+				GLuint a = indices[i + edgeStarts[j]];
+				GLuint b = indices[i + edgeEnds[j]];
+				glm::uvec2 edge(glm::min(a, b), glm::max(a, b));
+				uint64_t key = ((uint64_t)edge.x << 32) | (uint64_t)edge.y;
+
+				auto result = edgeIds.emplace(key, (GLuint)edges.size());
+				if (result.second)
+					edges.push_back(edge);
+
+				triangleEdges[i + j] = result.first->second;
+			}
+		}
+
+		undeformedPositions = positions;
+
+		std::vector<glm::vec4> paddedPositions;
+		paddedPositions.reserve(positions.size());
+		for (const glm::vec3& position : positions)
+			paddedPositions.push_back(glm::vec4(position, 1.f));
+
+		vertexCount = (GLsizei)positions.size();
+		edgeCount = (GLsizei)edges.size();
+
+		glGenBuffers(BufferCount, buffers);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[UndeformedPositions]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, paddedPositions.size() * sizeof(glm::vec4), paddedPositions.data(), GL_STATIC_DRAW);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[DeformedPositions]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, vertexCount * sizeof(glm::vec4), nullptr, GL_DYNAMIC_COPY);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[Edges]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, edges.size() * sizeof(glm::uvec2), edges.data(), GL_STATIC_DRAW);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[TriangleEdges]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, triangleEdges.size() * sizeof(GLuint), triangleEdges.data(), GL_STATIC_DRAW);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[EdgeTessellation]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, edgeCount * sizeof(glm::vec2), nullptr, GL_DYNAMIC_COPY);
+
+		// every joint influences everything until the influences are set
+		std::vector<GLuint> allJointsMasks(glm::max(vertexCount, edgeCount), AllJoints);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[VertexJointMasks]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, vertexCount * sizeof(GLuint), allJointsMasks.data(), GL_STATIC_DRAW);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[EdgeJointMasks]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, edgeCount * sizeof(GLuint), allJointsMasks.data(), GL_STATIC_DRAW);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	void TessellationPrepass::SetJointInfluences(const JointWeightVolume* p_worldWeightVolumes, size_t jointCount)
+	{
+		bool isSame = influenceWeightVolumes.size() == jointCount;
+		for (size_t i = 0; isSame && i < jointCount; i++)
+		{
+			const JointWeightVolume& a = influenceWeightVolumes[i];
+			const JointWeightVolume& b = p_worldWeightVolumes[i];
+			isSame = a.startPoint == b.startPoint && a.startToEnd == b.startToEnd && a.falloffRate == b.falloffRate;
+		}
+
+		if (isSame || vertexCount == 0)
+			return;
+
+		influenceWeightVolumes.assign(p_worldWeightVolumes, p_worldWeightVolumes + jointCount);
+		Invalidate();
+
+		std::vector<GLuint> vertexMasks(vertexCount);
+		for (GLsizei i = 0; i < vertexCount; i++)
+			vertexMasks[i] = JointInfluenceMask(undeformedPositions[i], p_worldWeightVolumes, jointCount, influenceWeightThreshold);
+
+		// an edge is influenced by the joints influencing the points its error is sampled at,
+		// see EdgeLinearizationError in tessellation.glsl
+		const int edgeSections = 5;
+		std::vector<GLuint> edgeMasks(edgeCount);
+
+		for (GLsizei i = 0; i < edgeCount; i++)
+		{
+			const glm::vec3& start = undeformedPositions[edges[i].x];
+			const glm::vec3& end = undeformedPositions[edges[i].y];
+			GLuint mask = vertexMasks[edges[i].x] | vertexMasks[edges[i].y];
+
+			for (int j = 1; j < edgeSections; j++)
+			{
+				glm::vec3 point = glm::mix(start, end, float(j) / float(edgeSections));
+				mask |= JointInfluenceMask(point, p_worldWeightVolumes, jointCount, influenceWeightThreshold);
+			}
+
+			edgeMasks[i] = mask;
+		}
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[VertexJointMasks]);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, vertexMasks.size() * sizeof(GLuint), vertexMasks.data());
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[EdgeJointMasks]);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, edgeMasks.size() * sizeof(GLuint), edgeMasks.data());
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	GLuint TessellationPrepass::UpdateChangedJoints(const AnimationPose& animationPose, size_t jointCount, float tolerance)
+	{
+		// 16 floats per joint, the deformation matrix or the dual quaternion and scale
+		const size_t jointDataSize = 16;
+		float jointData[jointDataSize];
+
+		bool isNewReference = 
+			!isCacheValid ||
+			referenceJointData.size() != jointCount * jointDataSize ||
+			referenceSkinningMode != animationPose.skinningMode;
+
+		if (isNewReference)
+		{
+			referenceJointData.assign(jointCount * jointDataSize, 0.f);
+			referenceSkinningMode = animationPose.skinningMode;
+		}
+
+		GLuint changedJointMask = 0;
+
+		for (size_t i = 0; i < jointCount; i++)
+		{
+			if (animationPose.skinningMode == SkinningMode::DualQuaternion)
+			{
+				const DualQuaternion& dualQuaternion = animationPose.p_dualQuaternions[i];
+				for (glm::length_t j = 0; j < 4; j++)
+				{
+					jointData[j] = dualQuaternion.real[j];
+					jointData[4 + j] = dualQuaternion.dual[j];
+				}
+				jointData[8] = animationPose.p_scales[i];
+				for (size_t j = 9; j < jointDataSize; j++)
+					jointData[j] = 0.f;
+			}
+			else
+			{
+				const float* p_matrix = &animationPose.p_deformationMatrices[i][0][0];
+				for (size_t j = 0; j < jointDataSize; j++)
+					jointData[j] = p_matrix[j];
+			}
+
+			float* p_reference = &referenceJointData[i * jointDataSize];
+			bool hasChanged = isNewReference;
+
+			for (size_t j = 0; j < jointDataSize && !hasChanged; j++)
+				hasChanged = glm::abs(jointData[j] - p_reference[j]) > tolerance;
+
+			if (hasChanged)
+			{
+				changedJointMask |= 1u << i;
+				for (size_t j = 0; j < jointDataSize; j++)
+					p_reference[j] = jointData[j];
+			}
+		}
+
+		return isNewReference ? AllJoints : changedJointMask;
+	}
+
+	void TessellationPrepass::Invalidate()
+	{
+		isCacheValid = false;
+		referenceJointData.clear();
+	}
+
+	void TessellationPrepass::Run(GLuint changedJointMask)
+	{
+		if (!isCacheValid)
+			changedJointMask = AllJoints;
+
+		// nothing moved, the cached results are still valid
+		if (vertexCount == 0 || changedJointMask == 0)
+			return;
+
+		const GLuint groupSize = 64;
+		GLint updateAll = changedJointMask == AllJoints ? 1 : 0;
+
+		for (GLuint i = 0; i < BufferCount; i++)
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, buffers[i]);
+
+		// deform the vertices first, since the edges reuse them as end points
+		vertexPassShader.Use();
+		vertexPassShader.SetInt("u_elementCount", vertexCount);
+		vertexPassShader.SetInt("u_updateAll", updateAll);
+		vertexPassShader.SetUint("u_changedJointMask", changedJointMask);
+		glDispatchCompute((vertexCount + groupSize - 1) / groupSize, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		edgePassShader.Use();
+		edgePassShader.SetInt("u_elementCount", edgeCount);
+		edgePassShader.SetInt("u_updateAll", updateAll);
+		edgePassShader.SetUint("u_changedJointMask", changedJointMask);
+		glDispatchCompute((edgeCount + groupSize - 1) / groupSize, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		edgePassShader.StopUsing();
+
+		for (GLuint i = 0; i < BufferCount; i++)
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, 0);
+
+		isCacheValid = true;
+	}
+
+	void TessellationPrepass::BindBuffers() const
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DeformedPositions, buffers[DeformedPositions]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TriangleEdges, buffers[TriangleEdges]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, EdgeTessellation, buffers[EdgeTessellation]);
+	}
+
+	void TessellationPrepass::UnbindBuffers() const
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DeformedPositions, 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TriangleEdges, 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, EdgeTessellation, 0);
+	}
+
+	GLsizei TessellationPrepass::GetEdgeCount() const
+	{
+		return edgeCount;
+	}
+}
\ No newline at end of file
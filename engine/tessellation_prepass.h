@@ -0,0 +1,74 @@
+#pragma once
+#include "shader.h"
+#include "animation.h"
+#include <vec3.hpp>
+#include <vector>
+
+namespace Engine
+{
+	// deforms each cage vertex and evaluates the tessellation level of each unique cage edge 
+	// with compute shaders, so that neighbouring patches share the work. the results persist
+	// across frames and only the vertices and edges influenced by joints that changed are updated
+	class TessellationPrepass
+	{
+	private:
+		// shader storage binding points, must match tessellation.glsl and tessellation_prepass_compute.glsl
+		enum BufferBinding : GLuint
+		{
+			UndeformedPositions = 0,
+			DeformedPositions = 1,
+			Edges = 2,
+			TriangleEdges = 3,
+			EdgeTessellation = 4,
+			VertexJointMasks = 5,
+			EdgeJointMasks = 6,
+			BufferCount = 7
+		};
+
+		Shader vertexPassShader;
+		Shader edgePassShader;
+		GLuint buffers[BufferCount];
+		GLsizei vertexCount;
+		GLsizei edgeCount;
+
+		// kept to compute the joint influences when the bind pose changes
+		std::vector<glm::vec3> undeformedPositions;
+		std::vector<glm::uvec2> edges;
+		std::vector<JointWeightVolume> influenceWeightVolumes;
+
+		// per joint deformation that the cached results were computed with
+		std::vector<float> referenceJointData;
+		SkinningMode referenceSkinningMode;
+		bool isCacheValid;
+
+		void Deinit();
+
+	public:
+		static constexpr GLuint AllJoints = 0xFFFFFFFF;
+
+		// normalized joint weight below which a joint is not considered to influence a point
+		float influenceWeightThreshold;
+
+		TessellationPrepass();
+		~TessellationPrepass();
+
+		bool Reload(const std::string& computeShaderFilePath);
+		// the deformation uniforms must be set on both shaders (while in use) before running
+		Shader& GetVertexPassShader();
+		Shader& GetEdgePassShader();
+		// builds the unique edge list of an indexed triangle list and uploads the cage
+		void SetMesh(const std::vector<glm::vec3>& positions, const std::vector<GLuint>& indices);
+		// recomputes the joint influence masks of the vertices and edges if the weight volumes changed
+		void SetJointInfluences(const JointWeightVolume* p_worldWeightVolumes, size_t jointCount);
+		// returns a bit per joint whose deformation changed more than the tolerance since it was last
+		// used for updating the cache, and makes the pose the new reference for those joints
+		GLuint UpdateChangedJoints(const AnimationPose& animationPose, size_t jointCount, float tolerance);
+		void Invalidate();
+		// updates the vertices and edges influenced by the changed joints, everything if the cache is invalid
+		void Run(GLuint changedJointMask = AllJoints);
+		// binds the deformed positions and the edge tessellation for the draw call
+		void BindBuffers() const;
+		void UnbindBuffers() const;
+		GLsizei GetEdgeCount() const;
+	};
+}
\ No newline at end of file
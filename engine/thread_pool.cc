@@ -0,0 +1,126 @@
+#include "thread_pool.h"
+
+namespace Engine
+{
+	ThreadPool::ThreadPool(size_t threadCount) :
+		p_task(nullptr),
+		remainingCount(0),
+		generation(0),
+		isStopping(false)
+	{
+		if (threadCount == 0)
+			threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+		for (size_t i = 0; i < threadCount; i++)
+			queues.push_back(std::make_unique<WorkQueue>());
+
+		for (size_t i = 0; i < threadCount; i++)
+			threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			isStopping = true;
+		}
+		workAvailable.notify_all();
+
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	size_t ThreadPool::ThreadCount() const
+	{
+		return threads.size();
+	}
+
+	bool ThreadPool::PopOrSteal(size_t threadIndex, size_t& outIndex)
+	{
+		// take from the front of the own queue first, so that neighbouring indices are processed together
+		{
+			WorkQueue& queue = *queues[threadIndex];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+
+			if (!queue.indices.empty())
+			{
+				outIndex = queue.indices.front();
+				queue.indices.pop_front();
+				return true;
+			}
+		}
+
+		for (size_t i = 1; i < queues.size(); i++)
+		{
+			WorkQueue& queue = *queues[(threadIndex + i) % queues.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+
+			if (!queue.indices.empty())
+			{
+				outIndex = queue.indices.back();
+				queue.indices.pop_back();
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void ThreadPool::WorkerLoop(size_t threadIndex)
+	{
+		size_t seenGeneration = 0;
+
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				workAvailable.wait(lock, [&]() { return isStopping || generation != seenGeneration; });
+
+				if (isStopping)
+					return;
+
+				seenGeneration = generation;
+			}
+
+			size_t index = 0;
+			while (PopOrSteal(threadIndex, index))
+			{
+				(*p_task)(index, threadIndex);
+
+				if (--remainingCount == 0)
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					workDone.notify_all();
+				}
+			}
+		}
+	}
+
+	void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t, size_t)>& task)
+	{
+		if (count == 0)
+			return;
+
+		std::lock_guard<std::mutex> parallelForLock(parallelForMutex);
+
+		p_task = &task;
+		remainingCount = count;
+
+		// contiguous ranges per thread, the rest is balanced by stealing
+		size_t rangeSize = (count + queues.size() - 1) / queues.size();
+		for (size_t i = 0; i < queues.size(); i++)
+		{
+			WorkQueue& queue = *queues[i];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+
+			for (size_t index = i * rangeSize; index < std::min((i + 1) * rangeSize, count); index++)
+				queue.indices.push_back(index);
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		generation++;
+		workAvailable.notify_all();
+		workDone.wait(lock, [&]() { return remainingCount == 0; });
+		p_task = nullptr;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+namespace Engine
+{
+	// fixed set of worker threads with one work queue each, idle workers steal
+	// from the back of the other queues to balance uneven work items
+	class ThreadPool final
+	{
+	private:
+		struct WorkQueue
+		{
+			std::mutex mutex;
+			std::deque<size_t> indices;
+		};
+
+		std::vector<std::thread> threads;
+		std::vector<std::unique_ptr<WorkQueue>> queues;
+
+		std::mutex mutex;
+		std::condition_variable workAvailable;
+		std::condition_variable workDone;
+		std::mutex parallelForMutex;// only one parallel for at a time
+		const std::function<void(size_t, size_t)>* p_task;
+		std::atomic<size_t> remainingCount;
+		size_t generation;
+		bool isStopping;
+
+		void WorkerLoop(size_t threadIndex);
+		bool PopOrSteal(size_t threadIndex, size_t& outIndex);
+
+	public:
+		// 0 threads uses the hardware concurrency
+		ThreadPool(size_t threadCount = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		size_t ThreadCount() const;
+		// calls task(index, threadIndex) for every index in [0, count) and returns when all are done
+		void ParallelFor(size_t count, const std::function<void(size_t, size_t)>& task);
+	};
+}
\ No newline at end of file
@@ -43,4 +43,44 @@ namespace Engine
 			t1.scale * t2.scale
 		);
 	}
+
+	Transform Inverse(const Transform& t)
+	{
+		glm::quat inverseRotation = glm::conjugate(t.rotation);
+		float inverseScale = 1.f / t.scale;
+
+		return Transform(
+			inverseRotation * (-t.position * inverseScale),
+			inverseRotation,
+			inverseScale
+		);
+	}
+
+	Transform TransformFromMatrix(const glm::mat4& matrix)
+	{
+		float scale = glm::length(glm::vec3(matrix[0]));
+		glm::mat3 rotationMatrix = glm::mat3(matrix) * (1.f / scale);
+
+		return Transform(
+			glm::vec3(matrix[3]),
+			glm::normalize(glm::quat_cast(rotationMatrix)),
+			scale
+		);
+	}
+
+
+	DualQuaternion::DualQuaternion() :
+		real(glm::identity<glm::quat>()),
+		dual(0.f, 0.f, 0.f, 0.f)
+	{}
+
+	DualQuaternion::DualQuaternion(const glm::quat& _real, const glm::quat& _dual) :
+		real(_real),
+		dual(_dual)
+	{}
+
+	DualQuaternion::DualQuaternion(const Transform& transform) :
+		real(transform.rotation),
+		dual(glm::quat(0.f, transform.position) * transform.rotation * 0.5f)
+	{}
 }
\ No newline at end of file
@@ -18,4 +18,18 @@ namespace Engine
 
 	Transform Lerp(const Transform& t1, const Transform& t2, float alpha);
 	Transform Multiply(const Transform& t1, const Transform& t2);
+	Transform Inverse(const Transform& t);
+	// assumes the matrix only contains translation, rotation and uniform scale
+	Transform TransformFromMatrix(const glm::mat4& matrix);
+
+	// rigid part (rotation and translation) of a transform, the scale is not included
+	struct DualQuaternion
+	{
+		glm::quat real;
+		glm::quat dual;
+
+		DualQuaternion();
+		DualQuaternion(const glm::quat& _real, const glm::quat& _dual);
+		DualQuaternion(const Transform& transform);
+	};
 }
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "animation_serializer.h"
+#include "nlst_renderer.h"
+#include "marching_cubes.h"
+#include "file_io.h"
+#include "image.h"
+#include "analytic_sdf.h"
+#include <glm.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// usage: nlst_headless [animation file] [output ppm] [width] [height] [animation time]
+// renders the first animation of the file like the cpu reference of setup_test, without a window or gpu
+int main(int argc, char** argv)
+{
+	std::string animationFilepath = argc > 1 ? argv[1] : "test_joints.anim";
+	std::string imageFilepath = argc > 2 ? argv[2] : "nlst_headless.ppm";
+	size_t width = argc > 3 ? (size_t)std::atoi(argv[3]) : 1600;
+	size_t height = argc > 4 ? (size_t)std::atoi(argv[4]) : 1200;
+	float animationTime = argc > 5 ? (float)std::atof(argv[5]) : 0.f;
+
+	// the cage is triangulated from the same grid as the voxelizer of setup_test samples
+	glm::vec3 volumeMin(-2.f);
+	glm::vec3 volumeMax(2.f);
+	glm::ivec3 voxelCount = glm::ivec3(glm::ceil((volumeMax - volumeMin) / 0.05f));
+	glm::vec3 voxelSize = (volumeMax - volumeMin) / glm::vec3(voxelCount);
+	std::vector<float> samples((size_t)voxelCount.x * (size_t)voxelCount.y * (size_t)voxelCount.z);
+
+	for (int x = 0; x < voxelCount.x; x++)
+		for (int y = 0; y < voxelCount.y; y++)
+			for (int z = 0; z < voxelCount.z; z++)
+				samples[((size_t)x * voxelCount.y + y) * voxelCount.z + z] = Engine::AnalyticSdf(volumeMin + voxelSize * glm::vec3(x, y, z));
+
+	glm::vec3 meshMinCorner, meshMaxCorner;
+	std::vector<glm::vec3> cagePositions;
+	std::vector<GLuint> cageIndices;
+	Engine::TriangulateScalarField(
+		samples.data(),
+		voxelCount.x,
+		voxelCount.y,
+		voxelCount.z,
+		volumeMin,
+		voxelSize,
+		glm::length(voxelSize),
+		meshMinCorner,
+		meshMaxCorner,
+		cagePositions,
+		cageIndices
+	);
+
+	// renders the undeformed sdf if the file has no animations
+	AnimationObject animationObject;
+	std::vector<char> buffer;
+	size_t bufferIndex = 0;
+	size_t objectCount = 0;
+
+	if (Engine::ReadBinaryFile(animationFilepath, buffer) && buffer.size() >= sizeof(size_t))
+		ReadData<size_t>(buffer, bufferIndex, objectCount);
+
+	if (objectCount > 0)
+	{
+		ReadAnimationObjectFromBuffer(buffer, bufferIndex, animationObject);
+		animationObject.Start(animationObject.animationPlayer.duration, animationObject.animationPlayer.loop);
+		animationObject.Update(animationTime);
+	}
+	else
+		std::printf("no animation in %s, rendering the bind pose\n", animationFilepath.c_str());
+
+	// camera and settings like the defaults of setup_test
+	Engine::Camera camera;
+	camera.Init(50.f, (float)width / (float)height, 0.3f, 500.f);
+	glm::mat4 cameraTransform(1.f);
+	cameraTransform[3] = glm::vec4(0.f, 0.f, -5.f, 1.f);
+
+	Engine::NlstRenderSettings settings;
+	settings.maxDistanceFromSurface = 2.f;
+	settings.maxRadius = 0.2f;
+
+	Engine::ThreadPool threadPool;
+	Engine::NlstRenderer renderer(threadPool);
+	renderer.SetCage(cagePositions, cageIndices);
+
+	Engine::NlstRenderTarget target;
+	target.Resize(width, height);
+
+	Engine::SdfFunction sdf = [](const glm::vec3& point) { return Engine::AnalyticSdf(point); };
+	Engine::PacketSdfFunction packetSdf = [](const Engine::Simd::Vec3Packet& points) { return Engine::AnalyticSdf(points); };
+
+	const bool hasAnimation = objectCount > 0;
+	auto start = std::chrono::steady_clock::now();
+
+	renderer.Render(
+		camera,
+		cameraTransform,
+		hasAnimation ? &animationObject.clip->bindPose : nullptr,
+		hasAnimation ? &animationObject.GetPose() : nullptr,
+		hasAnimation ? animationObject.clip->jointCount : 0,
+		sdf,
+		packetSdf,
+		cagePositions,
+		cageIndices,
+		settings,
+		target
+	);
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::printf("rendered %ux%u in %.3f s\n", (unsigned)width, (unsigned)height, seconds);
+
+	if (!Engine::WriteImagePpm(imageFilepath, target.width, target.height, target.colors.data()))
+	{
+		std::printf("failed to write %s\n", imageFilepath.c_str());
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
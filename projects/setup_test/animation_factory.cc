@@ -55,34 +55,34 @@ AnimationObjectFactory::Builder::~Builder()
 
 
 AnimationObjectFactory::SkeletonBuilder::SkeletonBuilder(AnimationObjectFactory* _p_factory) :
-	Builder(_p_factory)
-{
-	p_currentJoint = &skeleton.root;
-}
+	Builder(_p_factory),
+	currentJointIndex(0)
+{}
 
 AnimationObjectFactory::SkeletonBuilder& 
 AnimationObjectFactory::SkeletonBuilder::SetJointTransform(const AnimationTransform& transform)
 {
-	p_currentJoint->localTransform.position = transform.position;
-	p_currentJoint->localTransform.rotation = transform.eulerAngles;
-	p_currentJoint->localTransform.scale = transform.scale;
-	p_currentJoint->eulerAngles = transform.eulerAngles;
+	Engine::Transform& localTransform = skeleton.skeleton.localTransforms[currentJointIndex];
+	localTransform.position = transform.position;
+	localTransform.rotation = transform.eulerAngles;
+	localTransform.scale = transform.scale;
+	skeleton.skeleton.eulerAngles[currentJointIndex] = transform.eulerAngles;
 	return *this;
 }
 
 AnimationObjectFactory::SkeletonBuilder& 
 AnimationObjectFactory::SkeletonBuilder::SetJointWeightVolume(const Engine::JointWeightVolume& weightVolume)
 {
-	p_currentJoint->weightVolume = weightVolume;
+	skeleton.weightVolumes[currentJointIndex] = weightVolume;
 	return *this;
 }
 
 AnimationObjectFactory::SkeletonBuilder& 
 AnimationObjectFactory::SkeletonBuilder::AddChild()
 {
-	p_currentJoint->AddChild();
-	p_currentJoint->children.back()->localTransform.position = 
-		p_currentJoint->weightVolume.startPoint + p_currentJoint->weightVolume.startToEnd;
+	size_t childIndex = skeleton.AddChild(currentJointIndex);
+	const Engine::JointWeightVolume& weightVolume = skeleton.weightVolumes[currentJointIndex];
+	skeleton.skeleton.localTransforms[childIndex].position = weightVolume.startPoint + weightVolume.startToEnd;
 
 	return *this;
 }
@@ -90,19 +90,12 @@ AnimationObjectFactory::SkeletonBuilder::AddChild()
 AnimationObjectFactory::SkeletonBuilder& 
 AnimationObjectFactory::SkeletonBuilder::RemoveJointAndGoToParent()
 {
-	assert(p_currentJoint->p_parent != nullptr);
-
-	Engine::BuildingJoint* p_parent = p_currentJoint->p_parent;
+	assert(HasParent());
 
-	for (size_t i = 0; i < p_parent->children.size(); i++)
-	{
-		if (p_parent->children[i] == p_currentJoint)
-		{
-			p_parent->RemoveChild(i);
-			p_currentJoint = p_parent;
-			break;
-		}
-	}
+	// the parent comes before the removed joints, so its index stays valid
+	size_t parentIndex = (size_t)skeleton.skeleton.parentIndices[currentJointIndex];
+	skeleton.RemoveJoint(currentJointIndex);
+	currentJointIndex = parentIndex;
 	
 	return *this;
 }
@@ -110,103 +103,90 @@ AnimationObjectFactory::SkeletonBuilder::RemoveJointAndGoToParent()
 AnimationObjectFactory::SkeletonBuilder& 
 AnimationObjectFactory::SkeletonBuilder::GoToChild(size_t index)
 {
-	p_currentJoint = p_currentJoint->children[index];
+	currentJointIndex = skeleton.skeleton.ChildIndex(currentJointIndex, index);
 	return *this;
 }
 
 AnimationObjectFactory::SkeletonBuilder& 
 AnimationObjectFactory::SkeletonBuilder::GoToParent()
 {
-	p_currentJoint = p_currentJoint->p_parent;
+	currentJointIndex = (size_t)skeleton.skeleton.parentIndices[currentJointIndex];
 	return *this;
 }
 
 AnimationTransform AnimationObjectFactory::SkeletonBuilder::GetJointTransform() const
 {
 	return AnimationTransform(
-		p_currentJoint->localTransform.position,
-		p_currentJoint->eulerAngles,
-		p_currentJoint->localTransform.scale
+		skeleton.skeleton.localTransforms[currentJointIndex].position,
+		skeleton.skeleton.eulerAngles[currentJointIndex],
+		skeleton.skeleton.localTransforms[currentJointIndex].scale
 	);
 }
 
 Engine::JointWeightVolume AnimationObjectFactory::SkeletonBuilder::GetJointWeightVolume() const
 {
-	return p_currentJoint->weightVolume;
+	return skeleton.weightVolumes[currentJointIndex];
 }
 
 size_t AnimationObjectFactory::SkeletonBuilder::GetChildCount() const
 {
-	return p_currentJoint->children.size();
+	return skeleton.skeleton.ChildCount(currentJointIndex);
 }
 
 bool AnimationObjectFactory::SkeletonBuilder::HasParent() const
 {
-	return p_currentJoint->p_parent != nullptr;
-}
-
-void BuildBuildingJointNodes(
-	const Engine::BuildingJoint& startBuildingJoint,
-	const glm::mat4& parentWorldTransform,
-	const Engine::BuildingJoint* p_currentJoint,
-	std::vector<BuildingJointNode>& nodes
-)
-{
-	glm::mat4 worldTransform = parentWorldTransform * startBuildingJoint.localTransform.Matrix();
-	bool isCurrentJoint = &startBuildingJoint == p_currentJoint;
-
-	nodes.emplace_back(
-		isCurrentJoint,
-		glm::vec3(worldTransform[3]),
-		glm::vec3(worldTransform * glm::vec4(startBuildingJoint.weightVolume.startPoint, 1.f)),
-		glm::vec3(parentWorldTransform * glm::vec4(startBuildingJoint.weightVolume.startToEnd, 0.f))
-	);
-
-	for (Engine::BuildingJoint* p_child : startBuildingJoint.children)
-		BuildBuildingJointNodes(*p_child, worldTransform, p_currentJoint, nodes);
+	return skeleton.skeleton.parentIndices[currentJointIndex] != -1;
 }
 
 void AnimationObjectFactory::SkeletonBuilder::GetBuildingJointNodes(
 	std::vector<BuildingJointNode>& nodes
 ) const
 {
+	std::vector<glm::mat4> worldTransforms;
+	skeleton.skeleton.CalcWorldMatrices(worldTransforms);
 	nodes.clear();
-	BuildBuildingJointNodes(skeleton.root, glm::mat4(1.f), p_currentJoint, nodes);
-}
 
-void BuildWeightVolumes(
-	const Engine::BuildingJoint& startBuildingJoint,
-	const glm::mat4& parentWorldTransform,
-	std::vector<Engine::JointWeightVolume>& weightVolumes
-)
-{
-	glm::mat4 worldTransform = parentWorldTransform * startBuildingJoint.localTransform.Matrix();
-	weightVolumes.emplace_back();
-	auto& weightVolume = weightVolumes.back();
-	weightVolume.startPoint = glm::vec3(worldTransform * glm::vec4(startBuildingJoint.weightVolume.startPoint, 1.f));
-	weightVolume.startToEnd = glm::vec3(parentWorldTransform * glm::vec4(startBuildingJoint.weightVolume.startToEnd, 0.f));
-	weightVolume.falloffRate = startBuildingJoint.weightVolume.falloffRate;
-
-	for (size_t i = 0; i < startBuildingJoint.children.size(); i++)
-		BuildWeightVolumes(*startBuildingJoint.children[i], worldTransform, weightVolumes);
+	for (size_t i = 0; i < worldTransforms.size(); i++)
+	{
+		int parentIndex = skeleton.skeleton.parentIndices[i];
+		glm::mat4 parentWorldTransform = parentIndex == -1 ? glm::mat4(1.f) : worldTransforms[parentIndex];
+
+		nodes.emplace_back(
+			i == currentJointIndex,
+			glm::vec3(worldTransforms[i][3]),
+			glm::vec3(worldTransforms[i] * glm::vec4(skeleton.weightVolumes[i].startPoint, 1.f)),
+			glm::vec3(parentWorldTransform * glm::vec4(skeleton.weightVolumes[i].startToEnd, 0.f))
+		);
+	}
 }
 
 void AnimationObjectFactory::SkeletonBuilder::GetWorldJointWeightVolumes(
 	std::vector<Engine::JointWeightVolume>& weightVolumes
 ) const
 {
-	weightVolumes.clear();
-	BuildWeightVolumes(skeleton.root, glm::mat4(1.f), weightVolumes);
+	std::vector<glm::mat4> worldTransforms;
+	skeleton.skeleton.CalcWorldMatrices(worldTransforms);
+	weightVolumes.resize(worldTransforms.size());
+
+	for (size_t i = 0; i < worldTransforms.size(); i++)
+	{
+		int parentIndex = skeleton.skeleton.parentIndices[i];
+		glm::mat4 parentWorldTransform = parentIndex == -1 ? glm::mat4(1.f) : worldTransforms[parentIndex];
+		Engine::JointWeightVolume& weightVolume = weightVolumes[i];
+		weightVolume.startPoint = glm::vec3(worldTransforms[i] * glm::vec4(skeleton.weightVolumes[i].startPoint, 1.f));
+		weightVolume.startToEnd = glm::vec3(parentWorldTransform * glm::vec4(skeleton.weightVolumes[i].startToEnd, 0.f));
+		weightVolume.falloffRate = skeleton.weightVolumes[i].falloffRate;
+	}
 }
 
 AnimationObjectFactory& AnimationObjectFactory::SkeletonBuilder::Complete()
 {
 	skeleton.BuildSkeletonAndBindPose(
 		p_factory->p_state->skeleton, 
-		p_factory->p_state->animationObject->bindPose
+		p_factory->p_state->clip->bindPose
 	);
-	p_factory->p_state->animationObject->jointCount = skeleton.jointCount;
-	p_factory->p_state->animationObject->animationPose.Allocate(skeleton.jointCount);
+	p_factory->p_state->clip->jointCount = skeleton.skeleton.JointCount();
+	p_factory->p_state->animationObject->SetClip(p_factory->p_state->clip);
 
 	p_factory->p_state->stage = AnimationObjectFactory::Stage::SkeletonCompleted;
 
@@ -216,17 +196,17 @@ AnimationObjectFactory& AnimationObjectFactory::SkeletonBuilder::Complete()
 
 AnimationObjectFactory::AnimationBuilder::AnimationBuilder(AnimationObjectFactory* _p_factory) :
 	Builder(_p_factory),
-	currentKeyframeIndex(0)
+	currentKeyframeIndex(0),
+	currentJointIndex(0)
 {
 	animation.InitBorderKeyframes(p_factory->p_state->skeleton);
-	p_currentJoint = &animation.keyframes[0]->skeleton.root;
 }
 
 AnimationObjectFactory::AnimationBuilder& 
 AnimationObjectFactory::AnimationBuilder::AddAndGoToKeyframe(float time)
 {
 	animation.AddKeyframe(time, currentKeyframeIndex);
-	p_currentJoint = &animation.keyframes[currentKeyframeIndex]->skeleton.root;
+	currentJointIndex = 0;
 	return *this;
 }
 
@@ -237,7 +217,7 @@ AnimationObjectFactory::AnimationBuilder::RemoveKeyframeAndGoLeft()
 
 	animation.RemoveKeyframe(currentKeyframeIndex);
 	currentKeyframeIndex--;
-	p_currentJoint = &animation.keyframes[currentKeyframeIndex]->skeleton.root;
+	currentJointIndex = 0;
 
 	return *this;
 }
@@ -246,7 +226,7 @@ AnimationObjectFactory::AnimationBuilder&
 AnimationObjectFactory::AnimationBuilder::GoToKeyframe(size_t index)
 {
 	currentKeyframeIndex = index;
-	p_currentJoint = &animation.keyframes[currentKeyframeIndex]->skeleton.root;
+	currentJointIndex = 0;
 	return *this;
 }
 
@@ -273,71 +253,68 @@ bool AnimationObjectFactory::AnimationBuilder::CanKeyframeBeRemoved()
 AnimationObjectFactory::AnimationBuilder& 
 AnimationObjectFactory::AnimationBuilder::SetJointTransform(const AnimationTransform& transform)
 {
-	p_currentJoint->localTransform.position = transform.position;
-	p_currentJoint->localTransform.rotation = transform.eulerAngles;
-	p_currentJoint->localTransform.scale = transform.scale;
-	p_currentJoint->eulerAngles = transform.eulerAngles;
+	Engine::Skeleton& skeleton = animation.keyframes[currentKeyframeIndex]->skeleton;
+	Engine::Transform& localTransform = skeleton.localTransforms[currentJointIndex];
+	localTransform.position = transform.position;
+	localTransform.rotation = transform.eulerAngles;
+	localTransform.scale = transform.scale;
+	skeleton.eulerAngles[currentJointIndex] = transform.eulerAngles;
 	return *this;
 }
 
 AnimationObjectFactory::AnimationBuilder& 
 AnimationObjectFactory::AnimationBuilder::GoToChild(size_t index)
 {
-	p_currentJoint = &p_currentJoint->p_children[index];
+	currentJointIndex = animation.keyframes[currentKeyframeIndex]->skeleton.ChildIndex(currentJointIndex, index);
 	return *this;
 }
 
 AnimationObjectFactory::AnimationBuilder& 
 AnimationObjectFactory::AnimationBuilder::GoToParent()
 {
-	p_currentJoint = p_currentJoint->p_parent;
+	currentJointIndex = (size_t)animation.keyframes[currentKeyframeIndex]->skeleton.parentIndices[currentJointIndex];
 	return *this;
 }
 
 AnimationTransform AnimationObjectFactory::AnimationBuilder::GetJointTransform() const
 {
+	const Engine::Skeleton& skeleton = animation.keyframes[currentKeyframeIndex]->skeleton;
+
 	return AnimationTransform(
-		p_currentJoint->localTransform.position,
-		p_currentJoint->eulerAngles,
-		p_currentJoint->localTransform.scale
+		skeleton.localTransforms[currentJointIndex].position,
+		skeleton.eulerAngles[currentJointIndex],
+		skeleton.localTransforms[currentJointIndex].scale
 	);
 }
 
 size_t AnimationObjectFactory::AnimationBuilder::GetChildCount() const
 {
-	return p_currentJoint->childCount;
+	return animation.keyframes[currentKeyframeIndex]->skeleton.ChildCount(currentJointIndex);
 }
 
 bool AnimationObjectFactory::AnimationBuilder::HasParent() const
 {
-	return p_currentJoint->p_parent != nullptr;
+	return animation.keyframes[currentKeyframeIndex]->skeleton.parentIndices[currentJointIndex] != -1;
 }
 
 void BuildJointNodes(
-	const Engine::Joint& starLeftJoint,
-	const Engine::Joint& startRightJoint,
-	const glm::mat4& parentWorldTransform,
-	const Engine::Joint* p_currentJoint,
+	const Engine::Skeleton& leftSkeleton,
+	const Engine::Skeleton& rightSkeleton,
+	size_t currentJointIndex,
 	float alpha,
-	std::vector<JointNode>& positions
+	std::vector<JointNode>& nodes
 )
 {
-	glm::mat4 worldTransform = parentWorldTransform *
-		Lerp(starLeftJoint.localTransform, startRightJoint.localTransform, alpha).Matrix();
-	bool isCurrentJoint = &starLeftJoint == p_currentJoint;
+	std::vector<glm::mat4> worldTransforms(leftSkeleton.JointCount());
 
-	positions.emplace_back(isCurrentJoint, glm::vec3(worldTransform[3]));
-
-	for (size_t i = 0; i < starLeftJoint.childCount; i++)
+	for (size_t i = 0; i < worldTransforms.size(); i++)
 	{
-		BuildJointNodes(
-			starLeftJoint.p_children[i],
-			startRightJoint.p_children[i],
-			worldTransform,
-			p_currentJoint,
-			alpha,
-			positions
-		);
+		int parentIndex = leftSkeleton.parentIndices[i];
+		glm::mat4 parentWorldTransform = parentIndex == -1 ? glm::mat4(1.f) : worldTransforms[parentIndex];
+		worldTransforms[i] = parentWorldTransform *
+			Lerp(leftSkeleton.localTransforms[i], rightSkeleton.localTransforms[i], alpha).Matrix();
+
+		nodes.emplace_back(i == currentJointIndex, glm::vec3(worldTransforms[i][3]));
 	}
 }
 
@@ -351,10 +328,9 @@ void AnimationObjectFactory::AnimationBuilder::GetJointNodes(
 	if (time == 1.f)
 	{
 		BuildJointNodes(
-			animation.keyframes.back()->skeleton.root,
-			animation.keyframes.back()->skeleton.root,
-			glm::mat4(1.f),
-			p_currentJoint,
+			animation.keyframes.back()->skeleton,
+			animation.keyframes.back()->skeleton,
+			currentJointIndex,
 			1.f,
 			nodes
 		);
@@ -369,10 +345,9 @@ void AnimationObjectFactory::AnimationBuilder::GetJointNodes(
 				(animation.keyframes[i]->timestamp - animation.keyframes[i - 1]->timestamp);
 
 			BuildJointNodes(
-				animation.keyframes[i - 1]->skeleton.root,
-				animation.keyframes[i]->skeleton.root,
-				glm::mat4(1.f),
-				p_currentJoint,
+				animation.keyframes[i - 1]->skeleton,
+				animation.keyframes[i]->skeleton,
+				currentJointIndex,
 				alpha,
 				nodes
 			);
@@ -383,28 +358,33 @@ void AnimationObjectFactory::AnimationBuilder::GetJointNodes(
 
 size_t AnimationObjectFactory::AnimationBuilder::GetJointCount() const
 {
-	return p_factory->p_state->skeleton.jointCount;
+	return p_factory->p_state->skeleton.JointCount();
 }
 
 const Engine::BindPose& AnimationObjectFactory::AnimationBuilder::GetBindPose() const
 {
-	return p_factory->p_state->animationObject->bindPose;
+	return p_factory->p_state->clip->bindPose;
 }
 
-const Engine::AnimationPose& AnimationObjectFactory::AnimationBuilder::GetAnimationPose(float time) const
+void AnimationObjectFactory::AnimationBuilder::UpdateAnimationPose(float time, Engine::SkinningMode skinningMode)
 {
+	p_factory->p_state->animationObject->animationPose.skinningMode = skinningMode;
 	animation.GetAnimationPose(
 		time, 
-		p_factory->p_state->animationObject->bindPose, 
+		p_factory->p_state->clip->bindPose, 
 		p_factory->p_state->animationObject->animationPose
 	);
+	p_factory->p_state->animationObject->animationPose.MarkChanged();
+}
 
+const Engine::AnimationPose& AnimationObjectFactory::AnimationBuilder::GetAnimationPose() const
+{
 	return p_factory->p_state->animationObject->animationPose;
 }
 
 AnimationObjectFactory& AnimationObjectFactory::AnimationBuilder::Complete()
 {
-	animation.BuildAnimation(p_factory->p_state->animationObject->animation);
+	animation.BuildAnimation(p_factory->p_state->clip->animation);
 
 	p_factory->p_state->stage = AnimationObjectFactory::Stage::AnimationCompleted;
 
@@ -444,6 +424,7 @@ AnimationObjectFactory::SkeletonBuilder& AnimationObjectFactory::StartBuildingSk
 
 	p_state = new State();
 	p_state->stage = Stage::BuildingSkeleton;
+	p_state->clip = std::make_shared<AnimationClip>();
 	p_state->animationObject = std::make_shared<AnimationObject>();
 
 	SkeletonBuilder* p_builder = new SkeletonBuilder(this);
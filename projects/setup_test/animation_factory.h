@@ -65,7 +65,7 @@ public:
 	private:
 		Engine::BuildingAnimation animation;
 		size_t currentKeyframeIndex;
-		Engine::Joint* p_currentJoint;
+		size_t currentJointIndex;
 
 	public:
 		AnimationBuilder(AnimationObjectFactory* _p_factory);
@@ -89,7 +89,9 @@ public:
 		void GetJointNodes(float time, std::vector<JointNode>& nodes) const;
 		size_t GetJointCount() const;
 		const Engine::BindPose& GetBindPose() const;
-		const Engine::AnimationPose& GetAnimationPose(float time) const;
+		// poses the object being built at the time, which GetAnimationPose then returns
+		void UpdateAnimationPose(float time, Engine::SkinningMode skinningMode);
+		const Engine::AnimationPose& GetAnimationPose() const;
 
 		AnimationObjectFactory& Complete();
 	};
@@ -98,7 +100,7 @@ public:
 	{
 	private:
 		Engine::BuildingSkeleton skeleton;
-		Engine::BuildingJoint* p_currentJoint;
+		size_t currentJointIndex;
 
 	public:
 		SkeletonBuilder(AnimationObjectFactory* _p_factory);
@@ -127,6 +129,7 @@ private:
 		Stage stage;
 		Builder* p_builder;
 		Engine::Skeleton skeleton;
+		std::shared_ptr<AnimationClip> clip;// written while building, the object only sees it as const
 		std::shared_ptr<AnimationObject> animationObject;
 
 		State();
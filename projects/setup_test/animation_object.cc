@@ -1,21 +1,159 @@
 #include "animation_object.h"
 
-AnimationObject::AnimationObject() :
+AnimationClip::AnimationClip() :
 	jointCount(0)
 {}
 
+size_t AnimationClip::ByteSize() const
+{
+	return sizeof(AnimationClip) + bindPose.allocator.Capacity() + animation.allocator.Capacity();
+}
+
+
+AnimationObject::AnimationObject() :
+	useCompressedAnimation(false),
+	poseDirty(true)
+{}
+
+void AnimationObject::SetClip(const std::shared_ptr<const AnimationClip>& _clip)
+{
+	clip = _clip;
+	animationPose.Allocate(clip->jointCount);
+	poseDirty = true;
+}
+
+std::shared_ptr<AnimationObject> AnimationObject::CreateInstance() const
+{
+	std::shared_ptr<AnimationObject> instance = std::make_shared<AnimationObject>();
+	instance->SetClip(clip);
+	instance->animationPose.skinningMode = animationPose.skinningMode;
+	instance->Start(animationPlayer.duration, animationPlayer.loop);
+	instance->compressedAnimation = compressedAnimation;
+	instance->useCompressedAnimation = useCompressedAnimation;
+	instance->bakedPoses = bakedPoses;
+
+	return instance;
+}
+
 void AnimationObject::Start(float duration, bool loop)
 {
 	animationPlayer.Start(duration, loop);
+	poseDirty = true;
 }
 
 void AnimationObject::Restart()
 {
-	animationPlayer.currentKeyframeIndex = 0;
-	animationPlayer.currentTime = 0.f;
+	animationPlayer.Seek(0.f);
+	poseDirty = true;
 }
 
 void AnimationObject::Update(float deltaTime)
 {
-	animationPlayer.Update(deltaTime, jointCount, bindPose, animation, animationPose);
+	if (layerStack.LayerCount() > 0)
+	{
+		poseDirty |= layerStack.Advance(deltaTime);
+		return;
+	}
+
+	float previousTime = animationPlayer.currentTime;
+	animationPlayer.Seek(animationPlayer.currentTime + deltaTime);
+	poseDirty |= animationPlayer.currentTime != previousTime;
+}
+
+const Engine::AnimationPose& AnimationObject::GetPose()
+{
+	if (!poseDirty)
+		return animationPose;
+
+	poseDirty = false;
+	animationPose.MarkChanged();
+	float normalizedTime = animationPlayer.currentTime / animationPlayer.duration;
+
+	if (layerStack.LayerCount() > 0)
+		layerStack.Evaluate(clip->bindPose, animationPose);
+	else if (bakedPoses != nullptr && bakedPoses->GetSkinningMode() == animationPose.skinningMode)
+		bakedPoses->SampleAt(normalizedTime, animationPose);
+	else if (useCompressedAnimation && compressedAnimation != nullptr)
+	{
+		// only instances playing the compressed animation allocate the scratch memory
+		if (decompressedKeyframe.transforms.p_data == nullptr)
+			decompressedKeyframe.Allocate(clip->jointCount);
+
+		compressedAnimation->SampleAt(normalizedTime, clip->bindPose, decompressedKeyframe, compressedKeyCursors, animationPose);
+	}
+	else
+	{
+		clip->animation.SampleAt(
+			normalizedTime, 
+			clip->jointCount, 
+			clip->bindPose, 
+			animationPose, 
+			animationPlayer.currentKeyframeIndex
+		);
+	}
+
+	return animationPose;
+}
+
+void AnimationObject::MarkPoseDirty()
+{
+	poseDirty = true;
+}
+
+void AnimationObject::SetSkinningMode(Engine::SkinningMode skinningMode)
+{
+	if (animationPose.skinningMode == skinningMode)
+		return;
+
+	animationPose.skinningMode = skinningMode;
+	poseDirty = true;
+}
+
+void AnimationObject::Compress(const Engine::AnimationCompressionSettings& settings)
+{
+	std::shared_ptr<Engine::CompressedAnimation> newCompressedAnimation = std::make_shared<Engine::CompressedAnimation>();
+	newCompressedAnimation->Compress(clip->animation, clip->jointCount, settings);
+	compressedAnimation = newCompressedAnimation;
+	poseDirty = true;
+}
+
+void AnimationObject::Bake(Engine::SkinningMode skinningMode, float posesPerSecond, bool interpolate)
+{
+	size_t poseCount = glm::max((size_t)(animationPlayer.duration * posesPerSecond + 0.5f), (size_t)1) + 1;
+	std::shared_ptr<Engine::BakedPoseCache> newBakedPoses = std::make_shared<Engine::BakedPoseCache>();
+	newBakedPoses->Bake(clip->animation, clip->jointCount, clip->bindPose, skinningMode, poseCount, interpolate);
+	bakedPoses = newBakedPoses;
+	poseDirty = true;
+}
+
+void AnimationObject::CrossFade(const Engine::Animation& otherAnimation, float duration, bool loop, float fadeDuration)
+{
+	if (layerStack.JointCount() == 0)
+		layerStack.Init(clip->jointCount);
+
+	// the object animation becomes the layer faded out from
+	if (layerStack.LayerCount() == 0)
+		layerStack.AddLayer(clip->animation, animationPlayer.duration, animationPlayer.loop, animationPlayer.currentTime, 1.f);
+
+	layerStack.CrossFade(otherAnimation, duration, loop, fadeDuration);
+	poseDirty = true;
+}
+
+void AnimationObject::ClearLayers()
+{
+	layerStack.Clear();
+	poseDirty = true;
+}
+
+size_t AnimationObject::InstanceByteSize() const
+{
+	size_t scratchByteCount = 0;
+
+	if (decompressedKeyframe.transforms.p_data != nullptr)
+		scratchByteCount += Engine::TransformChannels::ByteSize(clip->jointCount) + compressedKeyCursors.capacity() * sizeof(uint32_t);
+
+	if (layerStack.JointCount() > 0)
+		scratchByteCount += Engine::TransformChannels::ByteSize(clip->jointCount);
+
+	return sizeof(AnimationObject) + animationPose.allocator.Capacity() + scratchByteCount;
 }
\ No newline at end of file
@@ -1,17 +1,60 @@
 #pragma once
 #include "animation.h"
+#include "animation_layers.h"
+#include "compressed_animation.h"
+#include "baked_pose_cache.h"
+#include <memory>
 
-struct AnimationObject
+// immutable once built, shared by every object playing it
+struct AnimationClip
 {
 	size_t jointCount;
 	Engine::BindPose bindPose;
 	Engine::Animation animation;
+
+	AnimationClip();
+
+	size_t ByteSize() const;
+};
+
+// one instance of a clip, only the player state and the output pose are its own
+struct AnimationObject
+{
+	std::shared_ptr<const AnimationClip> clip;
 	Engine::AnimationPose animationPose;
 	Engine::AnimationPlayer animationPlayer;
+	// shared like the clip, played instead of it when set and enabled
+	std::shared_ptr<const Engine::CompressedAnimation> compressedAnimation;
+	Engine::Keyframe decompressedKeyframe;// scratch memory when sampling the compressed animation
+	std::vector<uint32_t> compressedKeyCursors;// key interval of every compressed track at the last sample
+	bool useCompressedAnimation;
+	// played instead of sampling the animation when set and baked with the skinning mode of the pose
+	std::shared_ptr<const Engine::BakedPoseCache> bakedPoses;
+	// plays instead of the object animation while it has layers
+	Engine::AnimationLayerStack layerStack;
+	bool poseDirty;// the pose is only computed when requested and something changed since
 
 	AnimationObject();
 
+	// allocates the pose for the clip
+	void SetClip(const std::shared_ptr<const AnimationClip>& _clip);
+	// new object sharing the clip and its compressed and baked versions, playing from the start
+	std::shared_ptr<AnimationObject> CreateInstance() const;
 	void Start(float duration, bool loop);
 	void Restart();
+	// advances the time and marks the pose dirty if it moved, a paused or finished object costs nothing
 	void Update(float deltaTime);
+	// computes the pose if it is dirty, only consumers that use the pose should request it
+	const Engine::AnimationPose& GetPose();
+	// for changes to the public state that affect the pose
+	void MarkPoseDirty();
+	void SetSkinningMode(Engine::SkinningMode skinningMode);
+	void Compress(const Engine::AnimationCompressionSettings& settings);
+	// the baked poses are only played while the animation pose uses the same skinning mode
+	void Bake(Engine::SkinningMode skinningMode, float posesPerSecond, bool interpolate);
+	// fades from what is playing to an animation of the same skeleton, which has to outlive the fade
+	void CrossFade(const Engine::Animation& otherAnimation, float duration, bool loop, float fadeDuration);
+	void ClearLayers();
+	// memory not shared with other instances
+	size_t InstanceByteSize() const;
 };
\ No newline at end of file
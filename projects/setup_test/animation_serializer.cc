@@ -2,49 +2,59 @@
 
 void AppendAnimationObjectToBuffer(const AnimationObject& object, std::vector<char>& buffer)
 {
-	AppendData<size_t>(object.jointCount, buffer);
-	AppendData<size_t>(object.animation.keyframeCount, buffer);
+	const AnimationClip& clip = *object.clip;
+	AppendData<size_t>(clip.jointCount, buffer);
+	AppendData<size_t>(clip.animation.keyframeCount, buffer);
 	AppendData<float>(object.animationPlayer.duration, buffer);
 	AppendData<bool>(object.animationPlayer.loop, buffer);
 
-	for (size_t i = 0; i < object.jointCount; i++)
-		AppendData<glm::mat4>(object.bindPose.p_inverseWorldMatrices[i], buffer);
+	for (size_t i = 0; i < clip.jointCount; i++)
+		AppendData<glm::mat4>(clip.bindPose.p_inverseWorldMatrices[i], buffer);
 
-	for (size_t i = 0; i < object.jointCount; i++)
-		AppendData<Engine::JointWeightVolume>(object.bindPose.p_worldWeightVolumes[i], buffer);
+	for (size_t i = 0; i < clip.jointCount; i++)
+		AppendData<Engine::JointWeightVolume>(clip.bindPose.p_worldWeightVolumes[i], buffer);
 
-	for (size_t i = 0; i < object.animation.keyframeCount; i++)
+	for (size_t i = 0; i < clip.animation.keyframeCount; i++)
 	{
-		AppendData<float>(object.animation.p_keyframes[i].timestamp, buffer);
+		AppendData<float>(clip.animation.p_keyframes[i].timestamp, buffer);
 
-		for (size_t j = 0; j < object.jointCount; j++)
-			AppendData<Engine::Transform>(object.animation.p_keyframes[i].p_transformBuffer[j], buffer);
+		for (size_t j = 0; j < clip.jointCount; j++)
+			AppendData<Engine::Transform>(clip.animation.p_keyframes[i].transforms.Get(j), buffer);
 	}
 }
 
 void ReadAnimationObjectFromBuffer(const std::vector<char>& buffer, size_t& inoutBufferIndex, AnimationObject& outObject)
 {
-	ReadData<size_t>(buffer, inoutBufferIndex, outObject.jointCount);
-	ReadData<size_t>(buffer, inoutBufferIndex, outObject.animation.keyframeCount);
+	std::shared_ptr<AnimationClip> clip = std::make_shared<AnimationClip>();
+	size_t keyframeCount = 0;
+	ReadData<size_t>(buffer, inoutBufferIndex, clip->jointCount);
+	ReadData<size_t>(buffer, inoutBufferIndex, keyframeCount);
 	ReadData<float>(buffer, inoutBufferIndex, outObject.animationPlayer.duration);
 	ReadData<bool>(buffer, inoutBufferIndex, outObject.animationPlayer.loop);
 
-	outObject.animation.Allocate(outObject.animation.keyframeCount);
-	outObject.bindPose.Allocate(outObject.jointCount);
-	outObject.animationPose.Allocate(outObject.jointCount);
+	clip->animation.Allocate(keyframeCount, clip->jointCount);
+	clip->bindPose.Allocate(clip->jointCount);
 
-	for (size_t i = 0; i < outObject.jointCount; i++)
-		ReadData<glm::mat4>(buffer, inoutBufferIndex, outObject.bindPose.p_inverseWorldMatrices[i]);
+	for (size_t i = 0; i < clip->jointCount; i++)
+	{
+		ReadData<glm::mat4>(buffer, inoutBufferIndex, clip->bindPose.p_inverseWorldMatrices[i]);
+		clip->bindPose.inverseWorldTransforms.Set(i, Engine::TransformFromMatrix(clip->bindPose.p_inverseWorldMatrices[i]));
+	}
 
-	for (size_t i = 0; i < outObject.jointCount; i++)
-		ReadData<Engine::JointWeightVolume>(buffer, inoutBufferIndex, outObject.bindPose.p_worldWeightVolumes[i]);
+	for (size_t i = 0; i < clip->jointCount; i++)
+		ReadData<Engine::JointWeightVolume>(buffer, inoutBufferIndex, clip->bindPose.p_worldWeightVolumes[i]);
 
-	for (size_t i = 0; i < outObject.animation.keyframeCount; i++)
+	for (size_t i = 0; i < keyframeCount; i++)
 	{
-		outObject.animation.p_keyframes[i].Allocate(outObject.jointCount);
-		ReadData<float>(buffer, inoutBufferIndex, outObject.animation.p_keyframes[i].timestamp);
-
-		for (size_t j = 0; j < outObject.jointCount; j++)
-			ReadData<Engine::Transform>(buffer, inoutBufferIndex, outObject.animation.p_keyframes[i].p_transformBuffer[j]);
+		ReadData<float>(buffer, inoutBufferIndex, clip->animation.p_keyframes[i].timestamp);
+
+		for (size_t j = 0; j < clip->jointCount; j++)
+		{
+			Engine::Transform transform;
+			ReadData<Engine::Transform>(buffer, inoutBufferIndex, transform);
+			clip->animation.p_keyframes[i].transforms.Set(j, transform);
+		}
 	}
+
+	outObject.SetClip(clip);
 }
\ No newline at end of file
@@ -8,6 +8,8 @@
 #include "marching_cubes.h"
 #include "animation_serializer.h"
 #include "file_io.h"
+#include "image.h"
+#include "analytic_sdf.h"
 
 
 FlyCam::FlyCam() :
@@ -28,13 +30,59 @@ AnimationBuildingState::AnimationBuildingState() :
 {}
 
 
+SdfDrawData::SdfDrawData() :
+	VP(1.f),
+	invVP(1.f),
+	cameraPos(0.f),
+	pixelRadius(0.f),
+	screenSize(0.f),
+	maxDistanceFromSurface(0.f),
+	maxRadius(0.f),
+	jointCount(0),
+	p_bindPose(nullptr),
+	p_animationPose(nullptr),
+	p_uploadedPoseVersions(nullptr),
+	dualQuaternionSkinning(false),
+	jointIndex(-1),
+	p_buildingWeightVolumes(nullptr),
+	useDeformationField(false),
+	deformationFieldMin(0.f),
+	deformationFieldInvSize(0.f),
+	usePrecomputedTessellation(false),
+	odeTolerance(0.f),
+	countSteps(false),
+	isConePrepass(false),
+	useConeSeeds(false),
+	useTemporalWarmStart(false),
+	temporalBackOff(0.f),
+	temporalCageTolerance(0.f),
+	depthMode(SdfDepthMode::SinglePass),
+	isCageDepthPrepass(false),
+	deferredShading(false),
+	broydenMaxSteps(0),
+	broydenTolerance(0.f)
+{}
+
+
 PerformanceTestParameters::PerformanceTestParameters() :
 	samplesCount(0),
 	meshCellSize(0.f),
 	animationObjectIndex(0),
 	cameraZPos(0.f),
 	maxDistanceFromSurface(0.f),
-	maxRadius(0.f)
+	maxRadius(0.f),
+	skinningMode(Engine::SkinningMode::LinearBlend),
+	useDeformationField(false),
+	deformationFieldResolution(0),
+	usePrecomputedTessellation(false),
+	cacheTessellation(false),
+	odeTolerance(0.f),
+	conePrepassDivisor(0),
+	useTemporalWarmStart(false),
+	depthMode(SdfDepthMode::SinglePass),
+	useDeferredShading(false),
+	traceResolutionDivisor(1),
+	broydenMaxSteps(0)
 {}
 
 PerformanceTestParameters::PerformanceTestParameters(
@@ -43,14 +91,38 @@ PerformanceTestParameters::PerformanceTestParameters(
 	size_t _animationObjectIndex,
 	float _cameraZPos,
 	float _maxDistanceFromSurface,
-	float _maxRadius
+	float _maxRadius,
+	Engine::SkinningMode _skinningMode,
+	bool _useDeformationField,
+	int _deformationFieldResolution,
+	bool _usePrecomputedTessellation,
+	bool _cacheTessellation,
+	float _odeTolerance,
+	int _conePrepassDivisor,
+	bool _useTemporalWarmStart,
+	SdfDepthMode _depthMode,
+	bool _useDeferredShading,
+	int _traceResolutionDivisor,
+	int _broydenMaxSteps
 ) :
 	samplesCount(_samplesCount),
 	meshCellSize(_meshCellSize),
 	animationObjectIndex(_animationObjectIndex),
 	cameraZPos(_cameraZPos),
 	maxDistanceFromSurface(_maxDistanceFromSurface),
-	maxRadius(_maxRadius)
+	maxRadius(_maxRadius),
+	skinningMode(_skinningMode),
+	useDeformationField(_useDeformationField),
+	deformationFieldResolution(_deformationFieldResolution),
+	usePrecomputedTessellation(_usePrecomputedTessellation),
+	cacheTessellation(_cacheTessellation),
+	odeTolerance(_odeTolerance),
+	conePrepassDivisor(_conePrepassDivisor),
+	useTemporalWarmStart(_useTemporalWarmStart),
+	depthMode(_depthMode),
+	useDeferredShading(_useDeferredShading),
+	traceResolutionDivisor(_traceResolutionDivisor),
+	broydenMaxSteps(_broydenMaxSteps)
 {}
 
 
@@ -59,7 +131,12 @@ PerformanceTest::PerformanceTest() :
 	totalTime(0.f),
 	minDeltaTime(FLT_MAX),
 	maxDeltaTime(-FLT_MAX),
-	samplesCollected(0)
+	samplesCollected(0),
+	averageStepsPerPixel(0.f),
+	totalConePrepassTime(0.f),
+	totalTracePassTime(0.f),
+	totalShadingPassTime(0.f),
+	imageDifference({ 0.f, 0.f })
 {}
 
 PerformanceTest::PerformanceTest(const PerformanceTestParameters& _parameters) :
@@ -68,7 +145,12 @@ PerformanceTest::PerformanceTest(const PerformanceTestParameters& _parameters) :
 	totalTime(0.f),
 	minDeltaTime(FLT_MAX),
 	maxDeltaTime(-FLT_MAX),
-	samplesCollected(0)
+	samplesCollected(0),
+	averageStepsPerPixel(0.f),
+	totalConePrepassTime(0.f),
+	totalTracePassTime(0.f),
+	totalShadingPassTime(0.f),
+	imageDifference({ 0.f, 0.f })
 {}
 
 
@@ -76,13 +158,58 @@ App_SetupTest::App_SetupTest() :
 	maxDistanceFromSurface(0.f),
 	maxRadius(0.f),
 	meshBoundingBoxSize(0.f),
+	meshMinCorner(0.f),
+	meshMaxCorner(0.f),
+	useDeformationField(false),
+	deformationFieldResolution(32),
+	bakedFieldPoseVersion(0),
+	bakedFieldMin(0.f),
+	bakedFieldMax(0.f),
+	bakedFieldResolution(0),
+	usePrecomputedTessellation(false),
+	cacheTessellation(false),
+	tessellationCacheTolerance(0.0001f),
+	useAdaptiveOdeStep(false),
+	odeTolerance(0.0001f),
+	countSteps(false),
+	useConePrepass(false),
+	conePrepassDivisor(4),
+	useTemporalWarmStart(false),
+	temporalBackOff(0.05f),
+	temporalCageTolerance(0.1f),
+	currentTemporalBuffer(0),
+	hasPreviousHits(false),
+	depthMode(SdfDepthMode::SinglePass),
+	useDeferredShading(false),
+	traceResolutionDivisor(1),
+	upsampleTolerance(0.02f),
+	useBroydenUpdates(false),
+	broydenMaxSteps(16),
+	broydenTolerance(0.05f),
+	cpuRenderer(threadPool),
+	renderCpuReference(false),
+	useCpuCageBvh(false),
+	hasCpuReferenceDifference(false),
+	cpuReferenceDifference({ 0.f, 0.f }),
+	hasCpuBroydenDifference(false),
+	cpuBroydenDifference({ 0.f, 0.f }),
+	cpuBroydenMaxHitDistance(0.f),
+	cpuBroydenHitMismatches(0),
 	volumeMin(-1.f),
 	volumeMax(1.f),
 	voxelCount(0),
 	voxelSize(0.f),
 	showDebugMesh(false),
+	skinningMode(Engine::SkinningMode::LinearBlend),
 	p_buildingState(nullptr),
 	animationObjectIndex(0),
+	animationSystem(threadPool),
+	crowdInstanceCount(0),
+	crowdUpdateMs(0.f),
+	p_crowdBakedPoses(nullptr),
+	bakedPosesPerSecond(30.f),
+	interpolateBakedPoses(true),
+	crossFadeDuration(0.3f),
 	currentTestIndex(0),
 	isRunningTests(false),
 	showUI(true)
@@ -137,16 +264,17 @@ void App_SetupTest::HandleInput(float deltaTime)
 
 void App_SetupTest::ReloadSdf()
 {
+	// permutations are recompiled when they are requested
+	sdfShaders.Clear();
+	deferredShadingShaders.Clear();
+	// reloaded shaders start with empty uniforms, and cleared ones can be reallocated at the same address
+	uploadedPoseVersions.clear();
+	bakedFieldResolution = 0;
+
 	Engine::Voxelizer voxelizer;
 	if (!voxelizer.Reload("assets/shaders/voxelization_compute.glsl") || 
-		!sdfShader.Reload(
-			"assets/shaders/deform_vert.glsl",
-			"assets/shaders/deform_frag.glsl",
-			{
-				"assets/shaders/deform_tess_control.glsl",
-				"assets/shaders/deform_tess_eval.glsl"
-			}
-		))
+		!deformationField.Reload("assets/shaders/deformation_field_compute.glsl") ||
+		!tessellationPrepass.Reload("assets/shaders/tessellation_prepass_compute.glsl"))
 	{
 		return;
 	}
@@ -163,9 +291,6 @@ void App_SetupTest::ReloadSdf()
 		sdf
 	);
 
-	glm::vec3 minCorner(0.f);
-	glm::vec3 maxCorner(0.f);
-
 	Engine::TriangulateScalarField(
 		sdf.data(),
 		voxelCount.x,
@@ -174,12 +299,16 @@ void App_SetupTest::ReloadSdf()
 		volumeMin,
 		voxelSize,
 		glm::length(voxelSize),
-		minCorner,
-		maxCorner,
-		sdfMesh
+		meshMinCorner,
+		meshMaxCorner,
+		cagePositions,
+		cageIndices
 	);
+	Engine::GenerateTriangleMesh(cagePositions, cageIndices, sdfMesh);
+	tessellationPrepass.SetMesh(cagePositions, cageIndices);
+	cpuRenderer.SetCage(cagePositions, cageIndices);
 
-	meshBoundingBoxSize = maxCorner - minCorner;
+	meshBoundingBoxSize = meshMaxCorner - meshMinCorner;
 }
 
 void SetShaderBuildingWeightVolumes
@@ -208,16 +337,37 @@ void SetShaderSkeletonData(
 	Engine::Shader& shader,
 	size_t jointCount,
 	const Engine::BindPose* p_bindPose,
-	const Engine::AnimationPose* p_animationPose
+	const Engine::AnimationPose* p_animationPose,
+	std::map<const Engine::Shader*, uint64_t>& uploadedPoseVersions
 )
 {
 	shader.SetInt("u_jointCount", (GLint)jointCount);
 
+	if (jointCount == 0)
+		return;
+
+	bool useDualQuaternions = p_animationPose->skinningMode == Engine::SkinningMode::DualQuaternion;
+	shader.SetInt("u_skinningMode", useDualQuaternions ? 1 : 0);
+
+	// the version is unique over all poses, so an equal version is the same pose of the same bind pose
+	uint64_t& uploadedVersion = uploadedPoseVersions[&shader];
+
+	if (uploadedVersion == p_animationPose->version)
+		return;
+
+	uploadedVersion = p_animationPose->version;
+
+	if (useDualQuaternions)
+	{
+		// 8 floats per joint (real and dual part) instead of a 4x4 matrix
+		shader.SetVec4("u_dualQuaternions", &p_animationPose->p_dualQuaternions[0].real[0], (GLsizei)jointCount * 2);
+		shader.SetFloats("u_jointScales", p_animationPose->p_scales, (GLsizei)jointCount);
+	}
+
 	for (size_t i = 0; i < jointCount; i++)
 	{
 		std::string indexStr(std::to_string(i));
 		std::string jointWeightName("u_jointWeightVolumes[" + indexStr + "]");
-		std::string defMatricesName("u_deformationMatrices[" + indexStr + "]");
 
 		const Engine::JointWeightVolume& weightVolume = p_bindPose->p_worldWeightVolumes[i];
 
@@ -228,84 +378,575 @@ void SetShaderSkeletonData(
 		shader.SetVec3(jointWeightName + ".direction", &direction[0]);
 		shader.SetFloat(jointWeightName + ".length", length);
 		shader.SetFloat(jointWeightName + ".falloffRate", weightVolume.falloffRate);
-		shader.SetMat4(defMatricesName, &p_animationPose->p_deformationMatrices[i][0][0]);
+
+		if (!useDualQuaternions)
+			shader.SetMat4("u_deformationMatrices[" + indexStr + "]", &p_animationPose->p_deformationMatrices[i][0][0]);
 	}
 }
 
+size_t JointCountBucket(size_t jointCount)
+{
+	if (jointCount == 0)
+		return 0;
+
+	// round up to a power of two, so that few permutations are needed
+	size_t bucket = 1;
+	while (bucket < jointCount)
+		bucket *= 2;
+
+	return bucket;
+}
+
+void GetSdfShaderDefines(const SdfDrawData& drawData, bool renderMesh, std::vector<std::string>& outDefines)
+{
+	outDefines.clear();
+	outDefines.push_back("JOINT_COUNT " + std::to_string(JointCountBucket(drawData.jointCount)));
+	outDefines.push_back("SKINNING_MODE " + std::to_string(drawData.dualQuaternionSkinning ? 1 : 0));
+
+	if (renderMesh)
+		outDefines.push_back("RENDER_MODE_MESH");
+
+	if (drawData.jointIndex != -1)
+		outDefines.push_back("JOINT_WEIGHT_COLOR");
+
+	if (drawData.useDeformationField)
+		outDefines.push_back("USE_DEFORMATION_FIELD");
+
+	if (drawData.usePrecomputedTessellation)
+		outDefines.push_back("PRECOMPUTED_TESSELLATION");
+
+	if (drawData.odeTolerance > 0.f)
+		outDefines.push_back("ADAPTIVE_ODE_STEP");
+
+	if (drawData.countSteps)
+		outDefines.push_back("COUNT_STEPS");
+
+	if (drawData.isConePrepass && !renderMesh)
+		outDefines.push_back("CONE_PREPASS");
+
+	if (drawData.useConeSeeds && !renderMesh)
+		outDefines.push_back("CONE_SEEDED_START");
+
+	if (drawData.useTemporalWarmStart && !renderMesh)
+		outDefines.push_back("TEMPORAL_WARM_START");
+
+	if (drawData.isCageDepthPrepass)
+		outDefines.push_back("CAGE_DEPTH_PREPASS");
+	else if (drawData.depthMode == SdfDepthMode::ConservativeDepth && !renderMesh)
+		outDefines.push_back("CONSERVATIVE_DEPTH");
+	else if (drawData.depthMode == SdfDepthMode::FrontCagePrepass && !renderMesh)
+		outDefines.push_back("FRONT_CAGE_ONLY");
+
+	if (drawData.deferredShading && !renderMesh)
+		outDefines.push_back("G_BUFFER");
+
+	// sampling the baked field is cheaper than the Deform call of an update
+	if (drawData.broydenMaxSteps > 0 && !drawData.useDeformationField && !renderMesh)
+		outDefines.push_back("BROYDEN_UPDATES");
+}
+
+void SetSdfShaderUniforms(Engine::Shader& shader, const SdfDrawData& drawData)
+{
+	shader.SetMat4("u_VP", &drawData.VP[0][0]);
+	shader.SetMat4("u_invVP", &drawData.invVP[0][0]);
+	shader.SetVec3("u_cameraPos", &drawData.cameraPos[0]);
+	shader.SetFloat("u_pixelRadius", drawData.pixelRadius);
+	shader.SetVec2("u_screenSize", &drawData.screenSize[0]);
+	shader.SetFloat("u_maxDistanceFromSurface", drawData.maxDistanceFromSurface);
+	shader.SetFloat("u_maxRadius", drawData.maxRadius);
+
+	if (drawData.odeTolerance > 0.f)
+		shader.SetFloat("u_odeTolerance", drawData.odeTolerance);
+
+	if (drawData.useConeSeeds)
+		shader.SetInt("u_coneSeeds", 3);
+
+	if (drawData.broydenMaxSteps > 0)
+	{
+		shader.SetInt("u_broydenMaxSteps", drawData.broydenMaxSteps);
+		shader.SetFloat("u_broydenTolerance", drawData.broydenTolerance);
+	}
+
+	if (drawData.useTemporalWarmStart)
+	{
+		shader.SetInt("u_previousHits", 4);
+		shader.SetInt("u_previousCagePoints", 7);
+		shader.SetFloat("u_temporalBackOff", drawData.temporalBackOff);
+		shader.SetFloat("u_temporalCageTolerance", drawData.temporalCageTolerance);
+	}
+
+	if (drawData.useDeformationField)
+	{
+		GLint textureUnits[3] = { 0, 1, 2 };
+		shader.SetInts("u_inverseJacobianColumns", textureUnits, 3);
+		shader.SetVec3("u_deformationFieldMin", &drawData.deformationFieldMin[0]);
+		shader.SetVec3("u_deformationFieldInvSize", &drawData.deformationFieldInvSize[0]);
+	}
+
+	if (drawData.jointIndex != -1)
+	{
+		// no deformation while building the skeleton, only visualize the weights
+		shader.SetInt("u_jointCount", 0);
+		SetShaderBuildingWeightVolumes(shader, *drawData.p_buildingWeightVolumes);
+		// the weight volumes of the uploaded pose were overwritten
+		drawData.p_uploadedPoseVersions->erase(&shader);
+	}
+	else
+	{
+		SetShaderSkeletonData(
+			shader, 
+			drawData.jointCount, 
+			drawData.p_bindPose, 
+			drawData.p_animationPose, 
+			*drawData.p_uploadedPoseVersions
+		);
+	}
+
+	shader.SetInt("u_jointIndex", drawData.jointIndex);
+}
+
 void App_SetupTest::DrawSDf()
 {
+	SdfDrawData drawData;
+
 	glm::mat4 P = flyCam.camera.CalcP();
 	glm::mat4 invP = glm::inverse(P);
-	glm::mat4 VP = P * flyCam.camera.CalcV(flyCam.transform);
-	glm::mat4 invVP = glm::inverse(VP);
-	glm::vec3 cameraPos = flyCam.transform[3];
+	drawData.VP = P * flyCam.camera.CalcV(flyCam.transform);
+	drawData.invVP = glm::inverse(drawData.VP);
+	drawData.cameraPos = flyCam.transform[3];
 	glm::vec4 nearPlaneBottomLeft = invP * glm::vec4(-1.f, -1.f, -1.f, 1.f);
 	glm::vec4 nearPlaneTopRight = invP * glm::vec4(1.f, 1.f, -1.f, 1.f);
 	glm::vec2 nearPlaneWorldSize = glm::vec2(
 		nearPlaneTopRight.x - nearPlaneBottomLeft.x, 
 		nearPlaneTopRight.y - nearPlaneBottomLeft.y
 	);
-	glm::vec2 screenSize(window.Width(), window.Height());
-	glm::vec2 pixelWorldSize = nearPlaneWorldSize / screenSize;
-	float pixelRadius = glm::length(pixelWorldSize) * 0.5f;
-
-	size_t jointCount = 0;
-	const Engine::BindPose* p_bindPose = nullptr;
-	const Engine::AnimationPose* p_animationPose = nullptr;
+	drawData.screenSize = glm::vec2(window.Width(), window.Height());
+	glm::vec2 pixelWorldSize = nearPlaneWorldSize / drawData.screenSize;
+	drawData.pixelRadius = glm::length(pixelWorldSize) * 0.5f;
+	drawData.maxDistanceFromSurface = maxDistanceFromSurface;
+	drawData.maxRadius = maxRadius;
+	drawData.odeTolerance = useAdaptiveOdeStep ? odeTolerance : 0.f;
+	drawData.countSteps = countSteps;
+	drawData.broydenMaxSteps = useBroydenUpdates ? broydenMaxSteps : 0;
+	drawData.broydenTolerance = broydenTolerance;
 
 	if (animationFactory.CurrentStage() == AnimationObjectFactory::Stage::Animating)
 	{
 		auto& builder = animationFactory.GetAnimationBuilder();
-		jointCount = builder.GetJointCount();
-		p_bindPose = &builder.GetBindPose();
-		p_animationPose = &builder.GetAnimationPose(p_buildingState->currentKeyframeTime);
+		drawData.jointCount = builder.GetJointCount();
+		drawData.p_bindPose = &builder.GetBindPose();
+		builder.UpdateAnimationPose(p_buildingState->currentKeyframeTime, skinningMode);
+		drawData.p_animationPose = &builder.GetAnimationPose();
 	}
 	else if(animationFactory.CurrentStage() == AnimationObjectFactory::Stage::None && createdAnimationObjects.size() > 0)
 	{
 		auto& animationObject = createdAnimationObjects[animationObjectIndex];
-		jointCount = animationObject->jointCount;
-		p_bindPose = &animationObject->bindPose;
-		p_animationPose = &animationObject->animationPose;
+		drawData.jointCount = animationObject->clip->jointCount;
+		drawData.p_bindPose = &animationObject->clip->bindPose;
+		drawData.p_animationPose = &animationObject->GetPose();
 	}
 
-	// draw sdf
-	sdfMesh.Bind();
-	sdfShader.Use();
-	sdfShader.SetInt("u_renderMode", 0);
-	sdfShader.SetMat4("u_VP", &VP[0][0]);
-	sdfShader.SetMat4("u_invVP", &invVP[0][0]);
-	sdfShader.SetVec3("u_cameraPos", &cameraPos[0]);
-	sdfShader.SetFloat("u_pixelRadius", pixelRadius);
-	sdfShader.SetVec2("u_screenSize", &screenSize[0]);
-	sdfShader.SetFloat("u_maxDistanceFromSurface", maxDistanceFromSurface);
-	sdfShader.SetFloat("u_maxRadius", maxRadius);
-
-	int jointIndex = -1;
+	drawData.p_uploadedPoseVersions = &uploadedPoseVersions;
 
 	if (animationFactory.CurrentStage() == AnimationObjectFactory::Stage::BuildingSkeleton && p_buildingState->buildingJointNodes.size() > 0)
 	{
-		jointIndex = (int)p_buildingState->currentJointIndex;
+		drawData.jointIndex = (int)p_buildingState->currentJointIndex;
 		animationFactory.GetSkeletonBuilder().GetWorldJointWeightVolumes(p_buildingState->buildingWorldWeightVolumes);
-		SetShaderBuildingWeightVolumes(sdfShader, p_buildingState->buildingWorldWeightVolumes);
+		drawData.p_buildingWeightVolumes = &p_buildingState->buildingWorldWeightVolumes;
 	}
-	else
+
+	drawData.dualQuaternionSkinning = 
+		drawData.p_animationPose != nullptr && 
+		drawData.p_animationPose->skinningMode == Engine::SkinningMode::DualQuaternion;
+
+	// bake the inverse deformation Jacobian over the cage, padded by the max tracing radius
+	// since the tracing may leave the cage by that much
+	drawData.useDeformationField = useDeformationField && drawData.jointCount > 0 && drawData.jointIndex == -1;
+	drawData.deformationFieldMin = meshMinCorner - maxRadius;
+	drawData.deformationFieldInvSize = 1.f / (meshMaxCorner + maxRadius - drawData.deformationFieldMin);
+
+	if (drawData.useDeformationField)
 	{
-		SetShaderSkeletonData(sdfShader, jointCount, p_bindPose, p_animationPose);
+		// a paused, finished or static pose keeps the field of the last bake
+		glm::vec3 fieldMax = meshMaxCorner + maxRadius;
+		bool isFieldBaked = 
+			bakedFieldPoseVersion == drawData.p_animationPose->version &&
+			bakedFieldMin == drawData.deformationFieldMin &&
+			bakedFieldMax == fieldMax &&
+			bakedFieldResolution == deformationFieldResolution;
+
+		if (!isFieldBaked)
+		{
+			Engine::Shader& bakeShader = deformationField.GetBakeShader();
+			bakeShader.Use();
+			SetShaderSkeletonData(bakeShader, drawData.jointCount, drawData.p_bindPose, drawData.p_animationPose, uploadedPoseVersions);
+			deformationField.Bake(
+				drawData.deformationFieldMin, 
+				fieldMax, 
+				glm::ivec3(deformationFieldResolution)
+			);
+
+			bakedFieldPoseVersion = drawData.p_animationPose->version;
+			bakedFieldMin = drawData.deformationFieldMin;
+			bakedFieldMax = fieldMax;
+			bakedFieldResolution = deformationFieldResolution;
+		}
+
+		deformationField.BindTextures(0);
 	}
-	sdfShader.SetInt("u_jointIndex", jointIndex);
 
-	sdfMesh.Draw(0, GL_PATCHES);
+	// deform the cage vertices and evaluate the edge tessellation levels once, 
+	// instead of per vertex and patch in the tessellation control shader
+	drawData.usePrecomputedTessellation = usePrecomputedTessellation && drawData.jointIndex == -1;
+
+	if (drawData.usePrecomputedTessellation)
+	{
+		// only update what is influenced by joints that moved since they were last used
+		GLuint changedJointMask = Engine::TessellationPrepass::AllJoints;
+
+		if (cacheTessellation && drawData.jointCount > 0)
+		{
+			tessellationPrepass.SetJointInfluences(drawData.p_bindPose->p_worldWeightVolumes, drawData.jointCount);
+			changedJointMask = tessellationPrepass.UpdateChangedJoints(
+				*drawData.p_animationPose, 
+				drawData.jointCount, 
+				tessellationCacheTolerance
+			);
+		}
+		else
+		{
+			tessellationPrepass.Invalidate();
+		}
+
+		if (changedJointMask != 0)
+		{
+			for (Engine::Shader* p_shader : { &tessellationPrepass.GetVertexPassShader(), &tessellationPrepass.GetEdgePassShader() })
+			{
+				p_shader->Use();
+				SetShaderSkeletonData(*p_shader, drawData.jointCount, drawData.p_bindPose, drawData.p_animationPose, uploadedPoseVersions);
+			}
+		}
+
+		tessellationPrepass.Run(changedJointMask);
+		tessellationPrepass.BindBuffers();
+	}
+
+	// trace the cones of low resolution pixels first, the full resolution rays inside a cone
+	// start where it got close to the surface
+	drawData.useConeSeeds = useConePrepass && drawData.jointIndex == -1;
+
+	if (drawData.useConeSeeds)
+	{
+		SdfDrawData prepassData = drawData;
+		prepassData.isConePrepass = true;
+		prepassData.useConeSeeds = false;
+		prepassData.countSteps = false;
+		prepassData.useTemporalWarmStart = false;
+		prepassData.depthMode = SdfDepthMode::SinglePass;
+		prepassData.deferredShading = false;
+		prepassData.screenSize = glm::ceil(drawData.screenSize / float(conePrepassDivisor));
+		prepassData.pixelRadius = glm::length(nearPlaneWorldSize / prepassData.screenSize) * 0.5f;
+
+		GetSdfShaderDefines(prepassData, false, sdfShaderDefines);
+		Engine::Shader* p_prepassShader = sdfShaders.Get(sdfShaderDefines);
+
+		coneSeedBuffer.Resize((GLsizei)prepassData.screenSize.x, (GLsizei)prepassData.screenSize.y, { GL_RGBA32F }, true);
+		conePrepassTimer.Begin();
+
+		// w = 0 marks pixels without a seed
+		coneSeedBuffer.Clear();
+		coneSeedBuffer.Bind();
+
+		if (p_prepassShader != nullptr)
+		{
+			p_prepassShader->Use();
+			SetSdfShaderUniforms(*p_prepassShader, prepassData);
+			sdfMesh.Bind();
+			sdfMesh.Draw(0, GL_PATCHES);
+			sdfMesh.Unbind();
+			p_prepassShader->StopUsing();
+		}
+
+		coneSeedBuffer.Unbind(window.Width(), window.Height());
+		conePrepassTimer.End();
+		coneSeedBuffer.BindColorTexture(0, 3);
+	}
+
+	// trace into the current temporal buffer while reading the hit points of the previous one
+	// the previous hits would be of another resolution with a reduced resolution trace
+	bool reduceResolution = traceResolutionDivisor > 1;
+	drawData.useTemporalWarmStart = useTemporalWarmStart && drawData.jointIndex == -1 && !reduceResolution;
+	drawData.temporalBackOff = temporalBackOff;
+	drawData.temporalCageTolerance = temporalCageTolerance;
+
+	if (drawData.useTemporalWarmStart)
+	{
+		const Engine::FrameBuffer& previousBuffer = temporalBuffers[currentTemporalBuffer];
+		currentTemporalBuffer = 1 - currentTemporalBuffer;
+
+		for (Engine::FrameBuffer& buffer : temporalBuffers)
+		{
+			if (buffer.Resize(window.Width(), window.Height(), { GL_RGBA8, GL_RGBA32F, GL_RGBA32F }, true))
+				hasPreviousHits = false;
+		}
+
+		// no hits to start from after a resize or a frame without warm starting
+		if (!hasPreviousHits)
+			previousBuffer.Clear();
+
+		temporalBuffers[currentTemporalBuffer].Clear();
+		temporalBuffers[currentTemporalBuffer].Bind();
+		previousBuffer.BindColorTexture(1, 4);
+		previousBuffer.BindColorTexture(2, 7);
+	}
+
+	hasPreviousHits = drawData.useTemporalWarmStart;
+	drawData.depthMode = depthMode;
+
+	// the hit points go to location 1 like for the warm start, so a temporal buffer can be the g-buffer
+	drawData.deferredShading = useDeferredShading || reduceResolution;
+	const Engine::FrameBuffer* p_gBuffer = nullptr;
+	SdfDrawData traceData = drawData;
+
+	if (reduceResolution)
+	{
+		traceData.screenSize = glm::ceil(drawData.screenSize / float(traceResolutionDivisor));
+		traceData.pixelRadius = glm::length(nearPlaneWorldSize / traceData.screenSize) * 0.5f;
+
+		lowResolutionBuffer.Resize((GLsizei)traceData.screenSize.x, (GLsizei)traceData.screenSize.y, { GL_RGBA8, GL_RGBA32F }, true);
+		lowResolutionBuffer.Clear();
+		lowResolutionBuffer.Bind();
+		p_gBuffer = &lowResolutionBuffer;
+	}
+	else if (drawData.deferredShading && drawData.useTemporalWarmStart)
+	{
+		p_gBuffer = &temporalBuffers[currentTemporalBuffer];
+	}
+	else if (drawData.deferredShading)
+	{
+		gBuffer.Resize(window.Width(), window.Height(), { GL_RGBA8, GL_RGBA32F }, true);
+		gBuffer.Clear();
+		gBuffer.Bind();
+		p_gBuffer = &gBuffer;
+	}
+
+	// pick the permutations specialized for this frame's joint count and settings
+	GetSdfShaderDefines(drawData, false, sdfShaderDefines);
+	Engine::Shader* p_traceShader = sdfShaders.Get(sdfShaderDefines);
+	Engine::Shader* p_cageDepthShader = nullptr;
+	Engine::Shader* p_meshShader = nullptr;
+
+	if (drawData.depthMode == SdfDepthMode::FrontCagePrepass)
+	{
+		SdfDrawData prepassData = drawData;
+		prepassData.isCageDepthPrepass = true;
+		GetSdfShaderDefines(prepassData, false, sdfShaderDefines);
+		p_cageDepthShader = sdfShaders.Get(sdfShaderDefines);
+	}
 
 	if (showDebugMesh)
 	{
-		sdfShader.SetInt("u_renderMode", 1);
+		GetSdfShaderDefines(drawData, true, sdfShaderDefines);
+		p_meshShader = sdfShaders.Get(sdfShaderDefines);
+	}
+
+	// the step counters must be bound for the COUNT_STEPS permutation, see deform_frag.glsl
+	const GLuint stepCountersBinding = 7;
+
+	if (drawData.countSteps)
+	{
+		stepCounters.Reset();
+		stepCounters.Bind(stepCountersBinding);
+	}
+
+	// draw sdf
+	sdfMesh.Bind();
+	tracePassTimer.Begin();
+
+	if (p_cageDepthShader != nullptr)
+	{
+		// the trace pass then only passes the early depth test where it matches the front cage depth
+		p_cageDepthShader->Use();
+		SetSdfShaderUniforms(*p_cageDepthShader, traceData);
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		sdfMesh.Draw(0, GL_PATCHES);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		p_cageDepthShader->StopUsing();
+
+		glDepthFunc(GL_LEQUAL);
+		glDepthMask(GL_FALSE);
+	}
+
+	if (p_traceShader != nullptr)
+	{
+		p_traceShader->Use();
+		SetSdfShaderUniforms(*p_traceShader, traceData);
+		sdfMesh.Draw(0, GL_PATCHES);
+		p_traceShader->StopUsing();
+	}
+
+	if (p_cageDepthShader != nullptr)
+	{
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
+	}
+
+	tracePassTimer.End();
+
+	if (p_gBuffer != nullptr)
+	{
+		GetSdfShaderDefines(drawData, false, sdfShaderDefines);
+		if (reduceResolution)
+			sdfShaderDefines.push_back("BILATERAL_UPSAMPLE");
+
+		Engine::Shader* p_shadingShader = deferredShadingShaders.Get(sdfShaderDefines);
+
+		p_gBuffer->Unbind(window.Width(), window.Height());
+		shadingPassTimer.Begin();
+
+		if (p_shadingShader != nullptr)
+		{
+			p_gBuffer->BindColorTexture(1, 5);
+			p_gBuffer->BindDepthTexture(6);
+			p_shadingShader->Use();
+			SetSdfShaderUniforms(*p_shadingShader, drawData);
+			p_shadingShader->SetInt("u_gBufferHits", 5);
+			p_shadingShader->SetInt("u_gBufferDepth", 6);
+
+			if (reduceResolution)
+			{
+				p_shadingShader->SetFloat("u_upsampleDivisor", float(traceResolutionDivisor));
+				p_shadingShader->SetFloat("u_upsampleTolerance", upsampleTolerance);
+			}
+
+			// the fragment depth comes from the g-buffer
+			glDepthFunc(GL_ALWAYS);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			glDepthFunc(GL_LESS);
+			p_shadingShader->StopUsing();
+		}
+
+		shadingPassTimer.End();
+	}
+
+	if (p_meshShader != nullptr)
+	{
+		p_meshShader->Use();
+		SetSdfShaderUniforms(*p_meshShader, drawData);
+		// keep the hit points and cage points of the trace pass
+		glColorMaski(1, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		glColorMaski(2, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 		sdfMesh.Draw(0, GL_PATCHES);
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glColorMaski(1, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glColorMaski(2, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		p_meshShader->StopUsing();
 	}
 
-	sdfShader.StopUsing();
 	sdfMesh.Unbind();
+
+	if (drawData.usePrecomputedTessellation)
+		tessellationPrepass.UnbindBuffers();
+
+	if (drawData.countSteps)
+		stepCounters.Unbind(stepCountersBinding);
+
+	if (drawData.useTemporalWarmStart && p_gBuffer == nullptr)
+	{
+		const Engine::FrameBuffer& currentBuffer = temporalBuffers[currentTemporalBuffer];
+		currentBuffer.Unbind(window.Width(), window.Height());
+		currentBuffer.BlitColorToScreen(0, window.Width(), window.Height());
+	}
+
+	if (renderCpuReference)
+	{
+		renderCpuReference = false;
+		RenderCpuReference(drawData);
+	}
+}
+
+void ReadScreenColors(GLsizei width, GLsizei height, std::vector<glm::vec3>& outColors)
+{
+	outColors.resize((size_t)width * (size_t)height);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_FLOAT, outColors.data());
+}
+
+void App_SetupTest::RenderCpuReference(const SdfDrawData& drawData)
+{
+	// traces the same analytic sdf as deform_frag.glsl, so the difference to the gpu output
+	// of this frame only comes from the tracing
+	Engine::NlstRenderSettings settings;
+	settings.maxDistanceFromSurface = drawData.maxDistanceFromSurface;
+	settings.maxRadius = drawData.maxRadius;
+	settings.odeTolerance = drawData.odeTolerance;
+	settings.deferredShading = drawData.deferredShading;
+	settings.broydenMaxSteps = drawData.broydenMaxSteps;
+	settings.broydenTolerance = drawData.broydenTolerance;
+	settings.useCageBvh = useCpuCageBvh;
+
+	Engine::NlstRenderTarget target;
+	target.Resize((size_t)window.Width(), (size_t)window.Height());
+
+	Engine::SdfFunction sdf = [](const glm::vec3& point) { return Engine::AnalyticSdf(point); };
+	Engine::PacketSdfFunction packetSdf = [](const Engine::Simd::Vec3Packet& points) { return Engine::AnalyticSdf(points); };
+
+	cpuRenderer.Render(
+		flyCam.camera,
+		flyCam.transform,
+		drawData.p_bindPose,
+		drawData.p_animationPose,
+		drawData.jointIndex == -1 ? drawData.jointCount : 0,
+		sdf,
+		packetSdf,
+		cagePositions,
+		cageIndices,
+		settings,
+		target
+	);
+
+	Engine::WriteImagePpm("cpu_reference.ppm", target.width, target.height, target.colors.data());
+
+	// the sdf of this frame is still in the back buffer
+	std::vector<glm::vec3> screenColors;
+	ReadScreenColors(window.Width(), window.Height(), screenColors);
+	cpuReferenceDifference = Engine::CompareImages(screenColors.size(), screenColors.data(), target.colors.data());
+	hasCpuReferenceDifference = true;
+	hasCpuBroydenDifference = settings.broydenMaxSteps > 0;
+
+	if (!hasCpuBroydenDifference)
+		return;
+
+	// check the accuracy of the Broyden updates against evaluating every inverse Jacobian
+	Engine::NlstRenderTarget exactTarget;
+	exactTarget.Resize(target.width, target.height);
+	settings.broydenMaxSteps = 0;
+
+	cpuRenderer.Render(
+		flyCam.camera,
+		flyCam.transform,
+		drawData.p_bindPose,
+		drawData.p_animationPose,
+		drawData.jointIndex == -1 ? drawData.jointCount : 0,
+		sdf,
+		packetSdf,
+		cagePositions,
+		cageIndices,
+		settings,
+		exactTarget
+	);
+
+	cpuBroydenDifference = Engine::CompareImages(target.colors.size(), target.colors.data(), exactTarget.colors.data());
+	cpuBroydenMaxHitDistance = 0.f;
+	cpuBroydenHitMismatches = 0;
+
+	for (size_t i = 0; i < target.hits.size(); i++)
+	{
+		if (target.hits[i] != exactTarget.hits[i])
+			cpuBroydenHitMismatches++;
+		else if (target.hits[i] != 0)
+			cpuBroydenMaxHitDistance = glm::max(glm::distance(target.hitPoints[i], exactTarget.hitPoints[i]), cpuBroydenMaxHitDistance);
+	}
 }
 
 glm::mat4 AlignMatrix(const glm::vec3& up)
@@ -468,6 +1109,114 @@ void App_SetupTest::DrawUI(float deltaTime)
 	if (ImGui::RadioButton("Show debug mesh", showDebugMesh))
 		showDebugMesh = !showDebugMesh;
 
+	if (ImGui::RadioButton("Dual quaternion skinning", skinningMode == Engine::SkinningMode::DualQuaternion))
+	{
+		skinningMode = skinningMode == Engine::SkinningMode::DualQuaternion ?
+			Engine::SkinningMode::LinearBlend :
+			Engine::SkinningMode::DualQuaternion;
+	}
+
+	if (ImGui::RadioButton("Baked deformation field", useDeformationField))
+		useDeformationField = !useDeformationField;
+
+	if (useDeformationField)
+		ImGui::DragInt("deformation field resolution", &deformationFieldResolution, 1.f, 4, 128, "%i");
+
+	if (ImGui::RadioButton("Adaptive ODE step", useAdaptiveOdeStep))
+		useAdaptiveOdeStep = !useAdaptiveOdeStep;
+
+	if (useAdaptiveOdeStep)
+		ImGui::DragFloat("ODE tolerance", &odeTolerance, 0.00001f, 0.00001f, 0.01f, "%.5f", 1.f);
+
+	if (ImGui::RadioButton("Cone pre-pass", useConePrepass))
+		useConePrepass = !useConePrepass;
+
+	if (useConePrepass)
+	{
+		ImGui::SameLine();
+		if (ImGui::RadioButton("1/4", conePrepassDivisor == 4))
+			conePrepassDivisor = 4;
+		ImGui::SameLine();
+		if (ImGui::RadioButton("1/8", conePrepassDivisor == 8))
+			conePrepassDivisor = 8;
+		ImGui::Text("cone pre-pass: %.3f ms", conePrepassTimer.GetMilliseconds());
+	}
+
+	if (ImGui::RadioButton("Temporal warm start", useTemporalWarmStart))
+		useTemporalWarmStart = !useTemporalWarmStart;
+
+	if (useTemporalWarmStart)
+	{
+		ImGui::DragFloat("warm start back-off", &temporalBackOff, 0.005f, 0.f, 1.f, "%.3f", 1.f);
+		ImGui::DragFloat("warm start cage tolerance", &temporalCageTolerance, 0.005f, 0.f, 1.f, "%.3f", 1.f);
+	}
+
+	ImGui::Text("Depth mode:");
+	if (ImGui::RadioButton("single pass", depthMode == SdfDepthMode::SinglePass))
+		depthMode = SdfDepthMode::SinglePass;
+	ImGui::SameLine();
+	if (ImGui::RadioButton("conservative depth", depthMode == SdfDepthMode::ConservativeDepth))
+		depthMode = SdfDepthMode::ConservativeDepth;
+	ImGui::SameLine();
+	if (ImGui::RadioButton("front cage pre-pass", depthMode == SdfDepthMode::FrontCagePrepass))
+		depthMode = SdfDepthMode::FrontCagePrepass;
+	ImGui::Text("trace pass: %.3f ms", tracePassTimer.GetMilliseconds());
+
+	if (ImGui::RadioButton("Deferred shading", useDeferredShading))
+		useDeferredShading = !useDeferredShading;
+
+	if (useDeferredShading || traceResolutionDivisor > 1)
+		ImGui::Text("shading pass: %.3f ms", shadingPassTimer.GetMilliseconds());
+
+	ImGui::Text("Trace resolution:");
+	if (ImGui::RadioButton("full", traceResolutionDivisor == 1))
+		traceResolutionDivisor = 1;
+	ImGui::SameLine();
+	if (ImGui::RadioButton("1/2", traceResolutionDivisor == 2))
+		traceResolutionDivisor = 2;
+	ImGui::SameLine();
+	if (ImGui::RadioButton("1/4", traceResolutionDivisor == 4))
+		traceResolutionDivisor = 4;
+
+	if (traceResolutionDivisor > 1)
+		ImGui::DragFloat("upsample tolerance", &upsampleTolerance, 0.001f, 0.001f, 1.f, "%.3f", 1.f);
+
+	if (ImGui::RadioButton("Broyden updates", useBroydenUpdates))
+		useBroydenUpdates = !useBroydenUpdates;
+
+	if (useBroydenUpdates)
+	{
+		ImGui::DragInt("broyden max steps", &broydenMaxSteps, 0.1f, 1, 64);
+		ImGui::DragFloat("broyden tolerance", &broydenTolerance, 0.001f, 0.001f, 1.f, "%.3f", 1.f);
+	}
+
+	if (ImGui::RadioButton("CPU cage bvh", useCpuCageBvh))
+		useCpuCageBvh = !useCpuCageBvh;
+
+	if (ImGui::Button("Render CPU reference"))
+		renderCpuReference = true;
+
+	if (hasCpuReferenceDifference)
+		ImGui::Text("cpu reference rmse: %.4f, psnr: %.2f dB", cpuReferenceDifference.rmse, cpuReferenceDifference.psnr);
+
+	if (hasCpuBroydenDifference)
+	{
+		ImGui::Text("broyden vs exact rmse: %.4f, psnr: %.2f dB", cpuBroydenDifference.rmse, cpuBroydenDifference.psnr);
+		ImGui::Text("max hit distance: %.5f, hit mismatches: %u", cpuBroydenMaxHitDistance, (unsigned)cpuBroydenHitMismatches);
+	}
+
+	if (ImGui::RadioButton("Precomputed tessellation", usePrecomputedTessellation))
+		usePrecomputedTessellation = !usePrecomputedTessellation;
+
+	if (usePrecomputedTessellation)
+	{
+		if (ImGui::RadioButton("Cache tessellation", cacheTessellation))
+			cacheTessellation = !cacheTessellation;
+
+		if (cacheTessellation)
+			ImGui::DragFloat("joint change tolerance", &tessellationCacheTolerance, 0.00001f, 0.f, 0.01f, "%.5f", 1.f);
+	}
+
 	ImGui::NewLine();
 
 	auto stage = animationFactory.CurrentStage();
@@ -483,6 +1232,7 @@ void App_SetupTest::DrawUI(float deltaTime)
 			if (ImGui::Button(label.c_str()))
 			{
 				animationObjectIndex = i;
+				animationSystem.Clear();
 			}
 		}
 
@@ -494,8 +1244,126 @@ void App_SetupTest::DrawUI(float deltaTime)
 		}
 		if (createdAnimationObjects.size() > 0 && ImGui::Button("Remove animation"))
 		{
+			// the layers can play the animation of the removed object
+			for (auto& animationObject : createdAnimationObjects)
+				animationObject->ClearLayers();
+
 			createdAnimationObjects.erase(createdAnimationObjects.begin() + animationObjectIndex);
 			animationObjectIndex = 0;
+			animationSystem.Clear();
+		}
+
+		if (createdAnimationObjects.size() > 0)
+		{
+			AnimationObject& animationObject = *createdAnimationObjects[animationObjectIndex];
+
+			if (ImGui::Button("New instance"))
+				createdAnimationObjects.push_back(animationObject.CreateInstance());
+
+			ImGui::Text(
+				"clip bytes: %u shared by %u instances, instance bytes: %u", 
+				(unsigned)animationObject.clip->ByteSize(), 
+				(unsigned)animationObject.clip.use_count(), 
+				(unsigned)animationObject.InstanceByteSize()
+			);
+
+			if (ImGui::RadioButton("Compressed animation", animationObject.useCompressedAnimation))
+			{
+				animationObject.useCompressedAnimation = !animationObject.useCompressedAnimation;
+				animationObject.MarkPoseDirty();
+			}
+
+			bool recompress = ImGui::DragFloat("position tolerance", &animationCompressionSettings.positionTolerance, 0.0001f, 0.f, 0.1f, "%.4f", 1.f);
+			recompress |= ImGui::DragFloat("rotation tolerance", &animationCompressionSettings.rotationTolerance, 0.0001f, 0.f, 0.1f, "%.4f", 1.f);
+			recompress |= ImGui::DragFloat("scale tolerance", &animationCompressionSettings.scaleTolerance, 0.0001f, 0.f, 0.1f, "%.4f", 1.f);
+
+			if (recompress)
+				animationObject.Compress(animationCompressionSettings);
+
+			if (animationObject.compressedAnimation != nullptr)
+			{
+				size_t keyCount = animationObject.clip->animation.keyframeCount * animationObject.clip->jointCount;
+				ImGui::Text(
+					"keys: %u of %u, bytes: %u of %u", 
+					(unsigned)animationObject.compressedAnimation->KeyCount(), 
+					(unsigned)(keyCount * 3), 
+					(unsigned)animationObject.compressedAnimation->ByteSize(), 
+					(unsigned)(keyCount * sizeof(Engine::Transform))
+				);
+			}
+
+			bool rebake = false;
+			if (ImGui::RadioButton("Baked poses", animationObject.bakedPoses != nullptr))
+			{
+				if (animationObject.bakedPoses != nullptr)
+				{
+					animationObject.bakedPoses = nullptr;
+					animationObject.MarkPoseDirty();
+				}
+				else
+					rebake = true;
+			}
+
+			if (animationObject.bakedPoses != nullptr)
+			{
+				rebake |= ImGui::DragFloat("poses per second", &bakedPosesPerSecond, 1.f, 1.f, 240.f, "%.1f", 1.f);
+				if (ImGui::RadioButton("Interpolate baked poses", interpolateBakedPoses))
+				{
+					interpolateBakedPoses = !interpolateBakedPoses;
+					rebake = true;
+				}
+				// a bake only holds the deformations of one skinning mode
+				rebake |= animationObject.bakedPoses->GetSkinningMode() != skinningMode;
+
+				ImGui::Text(
+					"baked poses: %u, bytes: %u", 
+					(unsigned)animationObject.bakedPoses->PoseCount(), 
+					(unsigned)animationObject.bakedPoses->ByteSize()
+				);
+			}
+
+			if (rebake)
+				animationObject.Bake(skinningMode, bakedPosesPerSecond, interpolateBakedPoses);
+
+			// cross fades between the animations of the same skeleton
+			ImGui::DragFloat("cross fade duration", &crossFadeDuration, 0.01f, 0.f, 5.f, "%.3f", 1.f);
+
+			for (size_t i = 0; i < createdAnimationObjects.size(); i++)
+			{
+				const AnimationObject& otherObject = *createdAnimationObjects[i];
+
+				if (otherObject.clip->jointCount != animationObject.clip->jointCount)
+					continue;
+
+				std::string label = "Cross fade to animation " + std::to_string(i);
+
+				if (ImGui::Button(label.c_str()))
+				{
+					animationObject.CrossFade(
+						otherObject.clip->animation, 
+						otherObject.animationPlayer.duration, 
+						otherObject.animationPlayer.loop, 
+						crossFadeDuration
+					);
+				}
+			}
+
+			if (animationObject.layerStack.LayerCount() > 0)
+			{
+				ImGui::Text(
+					"layers: %u, sampled: %u", 
+					(unsigned)animationObject.layerStack.LayerCount(), 
+					(unsigned)animationObject.layerStack.ActiveLayerCount()
+				);
+
+				if (ImGui::Button("Stop cross fades"))
+					animationObject.ClearLayers();
+			}
+
+			ImGui::DragInt("crowd instances", &crowdInstanceCount, 1.f, 0, 100000);
+
+			if (crowdInstanceCount > 0)
+				ImGui::Text("crowd update: %.3f ms", crowdUpdateMs);
 		}
 	}
 	else if (stage == AnimationObjectFactory::Stage::BuildingSkeleton)
@@ -630,6 +1498,7 @@ void App_SetupTest::DrawUI(float deltaTime)
 			p_buildingState->animationObject = builder.Complete().CompleteObject();
 			p_buildingState->animationObject->animationPlayer.duration = p_buildingState->newAnimationDuration;
 			p_buildingState->animationObject->animationPlayer.loop = p_buildingState->newAnimationLoop;
+			p_buildingState->animationObject->Compress(animationCompressionSettings);
 
 			createdAnimationObjects.push_back(p_buildingState->animationObject);
 			animationObjectIndex = createdAnimationObjects.size() - 1;
@@ -644,6 +1513,54 @@ void App_SetupTest::DrawUI(float deltaTime)
 }
 
 
+void App_SetupTest::UpdateCrowd(float deltaTime)
+{
+	AnimationObject& animationObject = *createdAnimationObjects[animationObjectIndex];
+	const Engine::BakedPoseCache* p_bakedPoses = animationObject.bakedPoses.get();
+
+	if (p_bakedPoses != nullptr && p_bakedPoses->GetSkinningMode() != skinningMode)
+		p_bakedPoses = nullptr;
+
+	if (animationSystem.InstanceCount() != (size_t)crowdInstanceCount || p_crowdBakedPoses != p_bakedPoses)
+	{
+		// spread the instances over the animation so that they sample different keyframes
+		animationSystem.Clear();
+		p_crowdBakedPoses = p_bakedPoses;
+
+		for (int i = 0; i < crowdInstanceCount; i++)
+		{
+			float startTime = animationObject.animationPlayer.duration * (float)i / (float)crowdInstanceCount;
+
+			if (p_bakedPoses != nullptr)
+			{
+				animationSystem.AddBakedInstance(
+					animationObject.bakedPoses,
+					animationObject.clip->jointCount,
+					animationObject.animationPlayer.duration,
+					true,
+					startTime
+				);
+				continue;
+			}
+
+			animationSystem.AddInstance(
+				animationObject.clip->animation,
+				animationObject.clip->bindPose,
+				animationObject.clip->jointCount,
+				animationObject.animationPlayer.duration,
+				true,
+				startTime
+			);
+		}
+	}
+
+	animationSystem.SetSkinningMode(skinningMode);
+
+	double startTime = glfwGetTime();
+	animationSystem.Update(deltaTime);
+	crowdUpdateMs = (float)((glfwGetTime() - startTime) * 1000.0);
+}
+
 void App_SetupTest::WriteAnimationsToFile(const std::string& filepath)
 {
 	std::vector<char> buffer;
@@ -669,6 +1586,7 @@ void App_SetupTest::ReadAnimationsFromFile(const std::string& filepath)
 	{
 		std::shared_ptr<AnimationObject> animationObject = std::make_shared<AnimationObject>();
 		ReadAnimationObjectFromBuffer(buffer, bufferIndex, *animationObject.get());
+		animationObject->Compress(animationCompressionSettings);
 		createdAnimationObjects.push_back(animationObject);
 	}
 }
@@ -678,6 +1596,8 @@ void App_SetupTest::StartTests()
 	currentTestIndex = 0;
 	isRunningTests = true;
 	showDebugMesh = false;
+	// the tests switch between animations
+	animationSystem.Clear();
 
 	for (PerformanceTest* p_test : tests)
 	{
@@ -686,6 +1606,11 @@ void App_SetupTest::StartTests()
 		p_test->samplesCollected = 0;
 		p_test->minDeltaTime = FLT_MAX;
 		p_test->maxDeltaTime = -FLT_MAX;
+		p_test->averageStepsPerPixel = 0.f;
+		p_test->totalConePrepassTime = 0.f;
+		p_test->totalTracePassTime = 0.f;
+		p_test->totalShadingPassTime = 0.f;
+		p_test->imageDifference = { 0.f, 0.f };
 	}
 }
 
@@ -705,12 +1630,27 @@ void App_SetupTest::UpdateTests(float deltaTime)
 		// set rendering parameters
 		maxDistanceFromSurface = p_test->parameters.maxDistanceFromSurface;
 		maxRadius = p_test->parameters.maxRadius;
+		skinningMode = p_test->parameters.skinningMode;
+		useDeformationField = p_test->parameters.useDeformationField;
+		deformationFieldResolution = p_test->parameters.deformationFieldResolution;
+		usePrecomputedTessellation = p_test->parameters.usePrecomputedTessellation;
+		cacheTessellation = p_test->parameters.cacheTessellation;
+		useAdaptiveOdeStep = p_test->parameters.odeTolerance > 0.f;
+		odeTolerance = p_test->parameters.odeTolerance;
+		useConePrepass = p_test->parameters.conePrepassDivisor > 0;
+		conePrepassDivisor = glm::max(p_test->parameters.conePrepassDivisor, 1);
+		useTemporalWarmStart = p_test->parameters.useTemporalWarmStart;
+		depthMode = p_test->parameters.depthMode;
+		useDeferredShading = p_test->parameters.useDeferredShading;
+		traceResolutionDivisor = glm::max(p_test->parameters.traceResolutionDivisor, 1);
+		useBroydenUpdates = p_test->parameters.broydenMaxSteps > 0;
+		broydenMaxSteps = glm::max(p_test->parameters.broydenMaxSteps, 1);
 
 		// set animation pose at t=0
 		animationObjectIndex = p_test->parameters.animationObjectIndex;
 		auto& animationObject = createdAnimationObjects[animationObjectIndex];
+		animationObject->SetSkinningMode(skinningMode);
 		animationObject->Restart();
-		animationObject->Update(0.f);
 
 		// regenerate mesh based on cell size
 		voxelCount = glm::ivec3(glm::ceil((volumeMax - volumeMin) / p_test->parameters.meshCellSize));
@@ -731,12 +1671,62 @@ void App_SetupTest::UpdateTests(float deltaTime)
 		p_test->minDeltaTime = glm::min(deltaTime, p_test->minDeltaTime);
 		p_test->maxDeltaTime = glm::max(deltaTime, p_test->maxDeltaTime);
 		p_test->samplesCollected++;
+
+		// the timer lags a frame behind, which is the previous sampled frame or the skipped one
+		if (useConePrepass)
+			p_test->totalConePrepassTime += conePrepassTimer.GetMilliseconds();
+
+		p_test->totalTracePassTime += tracePassTimer.GetMilliseconds();
+
+		if (useDeferredShading || traceResolutionDivisor > 1)
+			p_test->totalShadingPassTime += shadingPassTimer.GetMilliseconds();
 	}
+	else if (p_test->state == PerformanceTest::State::CountSteps)
+	{
+		// counting stalls the gpu, so it gets a frame of its own after the timed ones
+		countSteps = true;
+		DrawSDf();
+		countSteps = false;
 
-	DrawSDf();
+		std::vector<GLuint> counters;
+		stepCounters.Read(counters);
+		p_test->averageStepsPerPixel = counters[1] > 0 ? float(counters[0]) / float(counters[1]) : 0.f;
 
-	if (p_test->samplesCollected >= p_test->parameters.samplesCount)
+		if (traceResolutionDivisor > 1 || useBroydenUpdates)
+		{
+			p_test->state = PerformanceTest::State::CompareImage;
+			return;
+		}
+
+		currentTestIndex++;
+
+		if (currentTestIndex == tests.size())
+		{
+			isRunningTests = false;
+			SaveTestResults();
+		}
+
+		return;
+	}
+
+	else if (p_test->state == PerformanceTest::State::CompareImage)
 	{
+		// the same pose traced at full resolution with exact inverse Jacobians is the reference
+		std::vector<glm::vec3> referenceColors;
+		std::vector<glm::vec3> colors;
+
+		traceResolutionDivisor = 1;
+		useBroydenUpdates = false;
+		DrawSDf();
+		ReadScreenColors(window.Width(), window.Height(), referenceColors);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		traceResolutionDivisor = glm::max(p_test->parameters.traceResolutionDivisor, 1);
+		useBroydenUpdates = p_test->parameters.broydenMaxSteps > 0;
+		DrawSDf();
+		ReadScreenColors(window.Width(), window.Height(), colors);
+		p_test->imageDifference = Engine::CompareImages(colors.size(), colors.data(), referenceColors.data());
+
 		currentTestIndex++;
 
 		if (currentTestIndex == tests.size())
@@ -744,7 +1734,14 @@ void App_SetupTest::UpdateTests(float deltaTime)
 			isRunningTests = false;
 			SaveTestResults();
 		}
+
+		return;
 	}
+
+	DrawSDf();
+
+	if (p_test->samplesCollected >= p_test->parameters.samplesCount)
+		p_test->state = PerformanceTest::State::CountSteps;
 }
 
 std::string FloatToString(float v)
@@ -754,6 +1751,41 @@ std::string FloatToString(float v)
 	return numStr;
 }
 
+std::string DepthModeName(SdfDepthMode depthMode)
+{
+	switch (depthMode)
+	{
+	case SdfDepthMode::ConservativeDepth:
+		return "conservative depth";
+	case SdfDepthMode::FrontCagePrepass:
+		return "front cage pre-pass";
+	default:
+		return "single pass";
+	}
+}
+
+bool EqualExceptDepthMode(const PerformanceTestParameters& a, const PerformanceTestParameters& b)
+{
+	return
+		a.samplesCount == b.samplesCount &&
+		a.meshCellSize == b.meshCellSize &&
+		a.animationObjectIndex == b.animationObjectIndex &&
+		a.cameraZPos == b.cameraZPos &&
+		a.maxDistanceFromSurface == b.maxDistanceFromSurface &&
+		a.maxRadius == b.maxRadius &&
+		a.skinningMode == b.skinningMode &&
+		a.useDeformationField == b.useDeformationField &&
+		a.deformationFieldResolution == b.deformationFieldResolution &&
+		a.usePrecomputedTessellation == b.usePrecomputedTessellation &&
+		a.cacheTessellation == b.cacheTessellation &&
+		a.odeTolerance == b.odeTolerance &&
+		a.conePrepassDivisor == b.conePrepassDivisor &&
+		a.useTemporalWarmStart == b.useTemporalWarmStart &&
+		a.useDeferredShading == b.useDeferredShading &&
+		a.traceResolutionDivisor == b.traceResolutionDivisor &&
+		a.broydenMaxSteps == b.broydenMaxSteps;
+}
+
 void App_SetupTest::SaveTestResults()
 {
 	constexpr size_t tablesCount = 6;
@@ -762,7 +1794,13 @@ void App_SetupTest::SaveTestResults()
 		"min dt\tmax dt\t"
 		"animation object index\tjoint count\t"
 		"mesh cell size\tcamera z position\t"
-		"max distance from surface\tmax radius\n";
+		"max distance from surface\tmax radius\tskinning mode\t"
+		"deformation field resolution\tprecomputed tessellation\ttessellation cache\t"
+		"ode tolerance\taverage steps per pixel\t"
+		"cone pre-pass\taverage cone pre-pass ms\ttemporal warm start\t"
+		"depth mode\taverage trace pass ms\ttrace pass speedup vs single pass\t"
+		"deferred shading\taverage shading pass ms\t"
+		"trace resolution\tbroyden max steps\trmse vs exact full resolution\tpsnr vs exact full resolution\n";
 
 	std::string metaData =
 		"screen width/height\t" + std::to_string(window.Width()) + "\t" + std::to_string(window.Height()) + "\n" +
@@ -773,6 +1811,19 @@ void App_SetupTest::SaveTestResults()
 	for (PerformanceTest* p_test : tests)
 	{
 		float averageDeltaTime = p_test->totalTime / float(p_test->samplesCollected);
+		float averageTracePassTime = p_test->totalTracePassTime / float(p_test->samplesCollected);
+
+		// the same test in the single pass depth mode, if there is one
+		const PerformanceTest* p_baseline = nullptr;
+		for (const PerformanceTest* p_other : tests)
+		{
+			if (p_other->parameters.depthMode == SdfDepthMode::SinglePass && EqualExceptDepthMode(p_test->parameters, p_other->parameters))
+				p_baseline = p_other;
+		}
+
+		bool reducedResolution = p_test->parameters.traceResolutionDivisor > 1;
+		bool isApproximated = reducedResolution || p_test->parameters.broydenMaxSteps > 0;
+		float baselineTracePassTime = p_baseline != nullptr ? p_baseline->totalTracePassTime / float(p_baseline->samplesCollected) : 0.f;
 
 		size_t i = 0;
 		table +=
@@ -783,11 +1834,29 @@ void App_SetupTest::SaveTestResults()
 			FloatToString(p_test->minDeltaTime) + "\t" +
 			FloatToString(p_test->maxDeltaTime) + "\t" +
 			std::to_string(p_test->parameters.animationObjectIndex) + "\t" +
-			std::to_string(createdAnimationObjects[p_test->parameters.animationObjectIndex]->jointCount) + "\t" +
+			std::to_string(createdAnimationObjects[p_test->parameters.animationObjectIndex]->clip->jointCount) + "\t" +
 			FloatToString(p_test->parameters.meshCellSize) + "\t" +
 			FloatToString(p_test->parameters.cameraZPos) + "\t" +
 			FloatToString(p_test->parameters.maxDistanceFromSurface) + "\t" +
-			FloatToString(p_test->parameters.maxRadius) + "\n";
+			FloatToString(p_test->parameters.maxRadius) + "\t" +
+			(p_test->parameters.skinningMode == Engine::SkinningMode::DualQuaternion ? "dual quaternion" : "linear blend") + "\t" +
+			(p_test->parameters.useDeformationField ? std::to_string(p_test->parameters.deformationFieldResolution) : "off") + "\t" +
+			(p_test->parameters.usePrecomputedTessellation ? "on" : "off") + "\t" +
+			(p_test->parameters.cacheTessellation ? "on" : "off") + "\t" +
+			(p_test->parameters.odeTolerance > 0.f ? FloatToString(p_test->parameters.odeTolerance) : "fixed step") + "\t" +
+			FloatToString(p_test->averageStepsPerPixel) + "\t" +
+			(p_test->parameters.conePrepassDivisor > 0 ? "1/" + std::to_string(p_test->parameters.conePrepassDivisor) : "off") + "\t" +
+			FloatToString(p_test->totalConePrepassTime / float(p_test->samplesCollected)) + "\t" +
+			(p_test->parameters.useTemporalWarmStart ? "on" : "off") + "\t" +
+			DepthModeName(p_test->parameters.depthMode) + "\t" +
+			FloatToString(averageTracePassTime) + "\t" +
+			(p_baseline != nullptr ? FloatToString(baselineTracePassTime / averageTracePassTime) : "-") + "\t" +
+			(p_test->parameters.useDeferredShading ? "on" : "off") + "\t" +
+			FloatToString(p_test->totalShadingPassTime / float(p_test->samplesCollected)) + "\t" +
+			(reducedResolution ? "1/" + std::to_string(p_test->parameters.traceResolutionDivisor) : "full") + "\t" +
+			(p_test->parameters.broydenMaxSteps > 0 ? std::to_string(p_test->parameters.broydenMaxSteps) : "off") + "\t" +
+			(isApproximated ? FloatToString(p_test->imageDifference.rmse) : "-") + "\t" +
+			(isApproximated && !std::isinf(p_test->imageDifference.psnr) ? FloatToString(p_test->imageDifference.psnr) : "-") + "\n";
 	}
 
 	std::string resultStr = metaData + table;
@@ -862,6 +1931,18 @@ void App_SetupTest::Init()
 	params.cameraZPos = -5.f;
 	params.maxDistanceFromSurface = 2.f;
 	params.maxRadius = 0.2f;
+	params.skinningMode = Engine::SkinningMode::LinearBlend;
+	params.useDeformationField = false;
+	params.deformationFieldResolution = 32;
+	params.usePrecomputedTessellation = false;
+	params.cacheTessellation = false;
+	params.odeTolerance = 0.f;
+	params.conePrepassDivisor = 0;
+	params.useTemporalWarmStart = false;
+	params.depthMode = SdfDepthMode::SinglePass;
+	params.useDeferredShading = false;
+	params.traceResolutionDivisor = 1;
+	params.broydenMaxSteps = 0;
 
 	/*for (size_t i = 0; i < 20; i++)
 	{
@@ -880,8 +1961,23 @@ void App_SetupTest::Init()
 	for (size_t i = 0; i < defaultFilepath.size(); i++)
 		filepathBuffer[i] = defaultFilepath[i];
 
+	sdfShaders.Init(
+		"assets/shaders/deform_vert.glsl",
+		"assets/shaders/deform_frag.glsl",
+		{
+			"assets/shaders/deform_tess_control.glsl",
+			"assets/shaders/deform_tess_eval.glsl"
+		}
+	);
+	deferredShadingShaders.Init(
+		"assets/shaders/deferred_shading_vert.glsl",
+		"assets/shaders/deferred_shading_frag.glsl"
+	);
 	ReloadSdf();
 
+	// total steps and traced pixels
+	stepCounters.Init(2);
+
 	Engine::GenerateUnitSphere(jointMesh);
 	Engine::GenerateUnitLine(weightVolumeMesh);
 	flatShader.Reload("assets/shaders/flat_vert.glsl", "assets/shaders/flat_frag.glsl");
@@ -916,8 +2012,14 @@ void App_SetupTest::UpdateLoop()
 			HandleInput(deltaTime);
 
 			if (animationFactory.CurrentStage() == AnimationObjectFactory::Stage::None && createdAnimationObjects.size() > 0)
+			{
+				createdAnimationObjects[animationObjectIndex]->SetSkinningMode(skinningMode);
 				createdAnimationObjects[animationObjectIndex]->Update(deltaTime);
 
+				if (crowdInstanceCount > 0)
+					UpdateCrowd(deltaTime);
+			}
+
 			DrawSDf();
 			DrawAnimationData();
 			DrawUI(deltaTime);
@@ -1,8 +1,17 @@
 #include "window.h"
 #include "camera.h"
 #include "shader.h"
+#include "shader_permutations.h"
 #include "render_mesh.h"
 #include "voxelizer.h"
+#include "deformation_field.h"
+#include "tessellation_prepass.h"
+#include "gpu_counters.h"
+#include "gpu_timer.h"
+#include "frame_buffer.h"
+#include "nlst_renderer.h"
+#include "animation_system.h"
+#include "image.h"
 #include "animation_factory.h"
 
 struct FlyCam
@@ -34,6 +43,70 @@ struct AnimationBuildingState
 	AnimationBuildingState();
 };
 
+// how the trace pass resolves the overlapping layers of the cage
+enum class SdfDepthMode
+{
+	SinglePass,// every cage fragment is traced and writes the depth of its hit
+	ConservativeDepth,// like single pass, but cage fragments behind earlier hits are rejected early
+	// depth-only cage pass first, then only the front cage fragments are traced. the depth buffer keeps
+	// the cage depth, so the g-buffer of deferred shading stores the hit depth in the w of the hit points
+	FrontCagePrepass
+};
+
+// per frame data used for picking and setting up the sdf shader permutations
+struct SdfDrawData
+{
+	glm::mat4 VP;
+	glm::mat4 invVP;
+	glm::vec3 cameraPos;
+	float pixelRadius;
+	glm::vec2 screenSize;
+	float maxDistanceFromSurface;
+	float maxRadius;
+
+	size_t jointCount;
+	const Engine::BindPose* p_bindPose;
+	const Engine::AnimationPose* p_animationPose;
+	// pose version last uploaded to the skeleton uniforms of each shader
+	std::map<const Engine::Shader*, uint64_t>* p_uploadedPoseVersions;
+	bool dualQuaternionSkinning;
+	// joint to visualize the weight of while building the skeleton, -1 otherwise
+	int jointIndex;
+	const std::vector<Engine::JointWeightVolume>* p_buildingWeightVolumes;
+
+	bool useDeformationField;
+	glm::vec3 deformationFieldMin;
+	glm::vec3 deformationFieldInvSize;
+
+	bool usePrecomputedTessellation;
+
+	// adaptive ode step size if above 0, otherwise fixed steps
+	float odeTolerance;
+	// count the tracing steps into the bound step counters
+	bool countSteps;
+
+	// low resolution pass that writes the cone seeds, or the full resolution pass starting from them
+	bool isConePrepass;
+	bool useConeSeeds;
+
+	// start from the previous frame's hit points and write this frame's
+	bool useTemporalWarmStart;
+	float temporalBackOff;
+	float temporalCageTolerance;
+
+	SdfDepthMode depthMode;
+	bool isCageDepthPrepass;
+
+	// write only the hit points, which a full screen pass then shades
+	bool deferredShading;
+
+	// Broyden updates of the inverse Jacobian along a ray if above 0, otherwise it is evaluated for every direction
+	int broydenMaxSteps;
+	float broydenTolerance;
+
+	SdfDrawData();
+};
+
 struct PerformanceTestParameters
 {
 	size_t samplesCount;
@@ -42,6 +115,18 @@ struct PerformanceTestParameters
 	float cameraZPos;
 	float maxDistanceFromSurface;
 	float maxRadius;
+	Engine::SkinningMode skinningMode;
+	bool useDeformationField;
+	int deformationFieldResolution;
+	bool usePrecomputedTessellation;
+	bool cacheTessellation;
+	float odeTolerance;
+	int conePrepassDivisor;// 0 if off
+	bool useTemporalWarmStart;
+	SdfDepthMode depthMode;
+	bool useDeferredShading;
+	int traceResolutionDivisor;// 1 for full resolution
+	int broydenMaxSteps;// 0 if off
 
 	PerformanceTestParameters();
 	PerformanceTestParameters(
@@ -50,7 +135,19 @@ struct PerformanceTestParameters
 		size_t _animationObjectIndex,
 		float _cameraZPos,
 		float _maxDistanceFromSurface,
-		float _maxRadius
+		float _maxRadius,
+		Engine::SkinningMode _skinningMode,
+		bool _useDeformationField,
+		int _deformationFieldResolution,
+		bool _usePrecomputedTessellation,
+		bool _cacheTessellation,
+		float _odeTolerance,
+		int _conePrepassDivisor,
+		bool _useTemporalWarmStart,
+		SdfDepthMode _depthMode,
+		bool _useDeferredShading,
+		int _traceResolutionDivisor,
+		int _broydenMaxSteps
 	);
 };
 
@@ -61,12 +158,20 @@ struct PerformanceTest
 	{
 		Setup,
 		SkipFrame,
-		Sample
+		Sample,
+		CountSteps,
+		CompareImage
 	} state;
 	float totalTime;
 	float minDeltaTime;
 	float maxDeltaTime;
 	size_t samplesCollected;
+	float averageStepsPerPixel;
+	float totalConePrepassTime;
+	float totalTracePassTime;
+	float totalShadingPassTime;
+	// of the frame against a full resolution one with exact inverse Jacobians
+	Engine::ImageDifference imageDifference;
 
 	PerformanceTest();
 	PerformanceTest(const PerformanceTestParameters& _parameters);
@@ -80,10 +185,83 @@ public:
 	FlyCam flyCam;
 
 	Engine::RenderMesh sdfMesh;
-	Engine::Shader sdfShader;
+	std::vector<glm::vec3> cagePositions;
+	std::vector<GLuint> cageIndices;
+	Engine::ShaderPermutations sdfShaders;
+	std::vector<std::string> sdfShaderDefines;
+	// uniforms keep their values between draws, so a pose is only uploaded once to every shader
+	std::map<const Engine::Shader*, uint64_t> uploadedPoseVersions;
 	float maxDistanceFromSurface;
 	float maxRadius;
 	glm::vec3 meshBoundingBoxSize;
+	glm::vec3 meshMinCorner;
+	glm::vec3 meshMaxCorner;
+
+	Engine::DeformationField deformationField;
+	bool useDeformationField;
+	int deformationFieldResolution;
+	// what the field was last baked for, it is only baked again when one of them changed
+	uint64_t bakedFieldPoseVersion;
+	glm::vec3 bakedFieldMin;
+	glm::vec3 bakedFieldMax;
+	int bakedFieldResolution;
+
+	Engine::TessellationPrepass tessellationPrepass;
+	bool usePrecomputedTessellation;
+	bool cacheTessellation;
+	float tessellationCacheTolerance;
+
+	bool useAdaptiveOdeStep;
+	float odeTolerance;
+	Engine::GpuCounters stepCounters;
+	bool countSteps;
+
+	bool useConePrepass;
+	int conePrepassDivisor;
+	Engine::FrameBuffer coneSeedBuffer;
+	Engine::GpuTimer conePrepassTimer;
+
+	// the frame is traced into one while the other holds the previous frame's hit points and their cage points
+	bool useTemporalWarmStart;
+	float temporalBackOff;
+	float temporalCageTolerance;
+	Engine::FrameBuffer temporalBuffers[2];
+	size_t currentTemporalBuffer;
+	bool hasPreviousHits;
+
+	SdfDepthMode depthMode;
+	// the cage depth pre-pass (if any) and the trace pass
+	Engine::GpuTimer tracePassTimer;
+
+	// the trace pass writes the hit points into the g-buffer, or the current temporal buffer
+	// which has the same layout, and a full screen pass shades them
+	bool useDeferredShading;
+	Engine::ShaderPermutations deferredShadingShaders;
+	Engine::FrameBuffer gBuffer;
+	Engine::GpuTimer shadingPassTimer;
+
+	// trace into a g-buffer of 1 / traceResolutionDivisor of the screen size and upsample it in the shading pass
+	int traceResolutionDivisor;
+	float upsampleTolerance;
+	Engine::FrameBuffer lowResolutionBuffer;
+
+	bool useBroydenUpdates;
+	int broydenMaxSteps;
+	float broydenTolerance;
+
+	Engine::ThreadPool threadPool;
+	Engine::NlstRenderer cpuRenderer;
+	bool renderCpuReference;
+	// trace the refit cage bvh for the cpu reference's ray start points instead of rasterizing the cage
+	bool useCpuCageBvh;
+	bool hasCpuReferenceDifference;
+	// of the gpu frame against the cpu reference
+	Engine::ImageDifference cpuReferenceDifference;
+	// of the cpu reference with Broyden updates against the one with exact inverse Jacobians
+	bool hasCpuBroydenDifference;
+	Engine::ImageDifference cpuBroydenDifference;
+	float cpuBroydenMaxHitDistance;
+	size_t cpuBroydenHitMismatches;
 
 	Engine::Voxelizer voxelizer;
 	glm::vec3 volumeMin;
@@ -92,6 +270,7 @@ public:
 	glm::vec3 voxelSize;
 
 	bool showDebugMesh;
+	Engine::SkinningMode skinningMode;
 	Engine::RenderMesh jointMesh;
 	Engine::RenderMesh weightVolumeMesh;
 	Engine::Shader flatShader;
@@ -99,7 +278,17 @@ public:
 	AnimationObjectFactory animationFactory;
 	AnimationBuildingState* p_buildingState;
 	std::vector<std::shared_ptr<AnimationObject>> createdAnimationObjects;
+	Engine::AnimationCompressionSettings animationCompressionSettings;
 	size_t animationObjectIndex;
+	// instances of the current animation updated in parallel beside it, to measure crowds
+	Engine::AnimationSystem animationSystem;
+	int crowdInstanceCount;
+	float crowdUpdateMs;
+	// the baked poses the crowd was built with, null when it samples the animation
+	const Engine::BakedPoseCache* p_crowdBakedPoses;
+	float bakedPosesPerSecond;
+	bool interpolateBakedPoses;
+	float crossFadeDuration;
 	char filepathBuffer[32];
 
 	std::vector<PerformanceTest*> tests;
@@ -113,8 +302,10 @@ public:
 	void HandleInput(float deltaTime);
 	void ReloadSdf();
 	void DrawSDf();
+	void RenderCpuReference(const SdfDrawData& drawData);
 	void DrawAnimationData();
 	void DrawUI(float deltaTime);
+	void UpdateCrowd(float deltaTime);
 
 	void WriteAnimationsToFile(const std::string& filepath);
 	void ReadAnimationsFromFile(const std::string& filepath);